@@ -0,0 +1,149 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/ass/dialogue_line.h"
+
+#include "libaegisub/util.h"
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+
+namespace {
+typedef std::string::const_iterator iterator;
+
+bool is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+bool is_digit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+agi::StringRange trim(iterator begin, iterator end) {
+	while (begin != end && is_space(*begin)) ++begin;
+	while (end != begin && is_space(*(end - 1))) --end;
+	return agi::StringRange(begin, end);
+}
+
+/// Parse an integer in the format accepted by lexical_cast: an optional sign
+/// followed by at least one digit, and nothing else
+bool parse_int(iterator begin, iterator end, int& out) {
+	bool negative = false;
+	if (begin != end && (*begin == '-' || *begin == '+'))
+		negative = *begin++ == '-';
+	if (begin == end) return false;
+
+	// Accumulate as a negative number so that INT_MIN fits
+	int value = 0;
+	const int min = std::numeric_limits<int>::min();
+	for (; begin != end; ++begin) {
+		if (!is_digit(*begin)) return false;
+		int digit = *begin - '0';
+		if (value < (min + digit) / 10) return false;
+		value = value * 10 - digit;
+	}
+
+	if (!negative) {
+		if (value == min) return false;
+		value = -value;
+	}
+	out = value;
+	return true;
+}
+
+/// Parse the block of extradata ids matching ^\{(=\d+)+\} at the start of
+/// the text, if there is one
+/// @return Was the text either valid or not an extradata block?
+bool parse_extradata(agi::ass::DialogueFields& fields) {
+	iterator pos = fields.text.begin(), end = fields.text.end();
+	if (end - pos < 2 || pos[0] != '{' || pos[1] != '=') return true;
+	++pos;
+
+	fields.extradata_ids.clear();
+	while (pos != end && *pos == '=') {
+		if (++pos == end || !is_digit(*pos)) return true;
+
+		uint64_t id = 0;
+		for (; pos != end && is_digit(*pos); ++pos) {
+			id = id * 10 + (*pos - '0');
+			if (id > std::numeric_limits<uint32_t>::max()) return false;
+		}
+		fields.extradata_ids.push_back(static_cast<uint32_t>(id));
+	}
+	if (pos == end || *pos != '}') return true;
+
+	fields.has_extradata = true;
+	fields.text = agi::StringRange(pos + 1, end);
+	return true;
+}
+}
+
+namespace agi { namespace ass {
+bool ParseDialogueFields(std::string const& line, DialogueFields& fields) {
+	iterator pos, end = line.end();
+	if (line.size() >= 10 && line.compare(0, 9, "Dialogue:") == 0) {
+		fields.comment = false;
+		pos = line.begin() + 10;
+	}
+	else if (line.size() >= 9 && line.compare(0, 8, "Comment:") == 0) {
+		fields.comment = true;
+		pos = line.begin() + 9;
+	}
+	else
+		return false;
+
+	// Get the next comma-separated field, failing if it's the last one in the
+	// line as the text must come after all of them
+	iterator field_begin, field_end;
+	auto next = [&]() -> bool {
+		field_begin = pos;
+		while (pos != end && *pos != ',') ++pos;
+		if (pos == end) return false;
+		field_end = pos++;
+		return true;
+	};
+
+	// SSA has "Marked=n" instead of the layer
+	if (!next()) return false;
+	auto layer = trim(field_begin, field_end);
+	if (layer.size() >= 7 && std::equal(layer.begin(), layer.begin() + 7, "marked=", [](char a, char b) { return tolower(static_cast<unsigned char>(a)) == b; }))
+		fields.layer = 0;
+	else if (!parse_int(layer.begin(), layer.end(), fields.layer))
+		return false;
+
+	if (!next()) return false;
+	fields.start = trim(field_begin, field_end);
+	if (!next()) return false;
+	fields.end = trim(field_begin, field_end);
+	if (!next()) return false;
+	fields.style = trim(field_begin, field_end);
+	if (!next()) return false;
+	fields.actor = trim(field_begin, field_end);
+
+	for (int& margin : fields.margin) {
+		if (!next() || !parse_int(field_begin, field_end, margin)) return false;
+		margin = util::mid(-9999, margin, 99999);
+	}
+
+	if (!next()) return false;
+	fields.effect = trim(field_begin, field_end);
+
+	fields.text = StringRange(pos, end);
+	fields.has_extradata = false;
+	return parse_extradata(fields);
+}
+} }
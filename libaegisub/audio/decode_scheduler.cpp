@@ -0,0 +1,120 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "decode_scheduler.h"
+
+#include "libaegisub/util.h"
+
+#include <algorithm>
+
+namespace {
+/// Most decoding threads to use for a single stream. Beyond this the source
+/// is usually limited by I/O rather than CPU.
+const int max_workers = 4;
+}
+
+namespace agi { namespace audio {
+DecodeScheduler::DecodeScheduler(int64_t num_samples, int64_t chunk_size, bool concurrent, DecodeFunc decode, PrefixFunc prefix_advanced)
+: num_samples(num_samples)
+, chunk_size(chunk_size)
+, num_chunks(static_cast<size_t>((num_samples + chunk_size - 1) / chunk_size))
+, concurrent(concurrent)
+, decode(std::move(decode))
+, prefix_advanced(std::move(prefix_advanced))
+, decoded(new std::atomic<uint64_t>[(num_chunks + 63) / 64])
+, claimed(num_chunks)
+, unclaimed(num_chunks)
+{
+	for (size_t i = 0; i < (num_chunks + 63) / 64; ++i)
+		decoded[i] = 0;
+
+	int threads = concurrent ? util::mid<int>(1, std::thread::hardware_concurrency(), max_workers) : 1;
+	for (int i = 0; i < threads; ++i)
+		workers.emplace_back([=] { Work(); });
+}
+
+DecodeScheduler::~DecodeScheduler() {
+	cancelled = true;
+	for (auto& worker : workers)
+		worker.join();
+}
+
+bool DecodeScheduler::IsChunkDecoded(size_t i) const {
+	return (decoded[i / 64].load(std::memory_order_acquire) >> (i % 64)) & 1;
+}
+
+void DecodeScheduler::Prioritize(int64_t sample) {
+	if (!concurrent || sample < 0 || sample >= num_samples) return;
+	std::lock_guard<std::mutex> lock(claim_lock);
+	cursor = static_cast<size_t>(sample / chunk_size);
+}
+
+bool DecodeScheduler::Claim(size_t& chunk) {
+	std::lock_guard<std::mutex> lock(claim_lock);
+	if (!unclaimed) return false;
+
+	// Everything before the cursor is picked up after wrapping around once
+	// the rest is done
+	while (claimed[cursor])
+		cursor = cursor + 1 == num_chunks ? 0 : cursor + 1;
+
+	chunk = cursor;
+	claimed[chunk] = true;
+	--unclaimed;
+	return true;
+}
+
+void DecodeScheduler::Finish(size_t chunk) {
+	decoded[chunk / 64].fetch_or(uint64_t(1) << (chunk % 64), std::memory_order_release);
+
+	std::lock_guard<std::mutex> lock(prefix_lock);
+	size_t first = prefix_chunks;
+	while (prefix_chunks < num_chunks && IsChunkDecoded(prefix_chunks))
+		++prefix_chunks;
+	if (prefix_chunks == first) return;
+
+	int64_t start = first * chunk_size;
+	int64_t end = std::min<int64_t>(prefix_chunks * chunk_size, num_samples);
+	if (prefix_advanced)
+		prefix_advanced(start, end);
+	prefix_samples = end;
+}
+
+void DecodeScheduler::Work() {
+	size_t chunk;
+	while (!cancelled && Claim(chunk)) {
+		int64_t start = chunk * chunk_size;
+		decode(start, std::min(chunk_size, num_samples - start));
+		Finish(chunk);
+	}
+}
+
+int64_t DecodeScheduler::Run(int64_t start, int64_t count, bool want_decoded) const {
+	if (start < 0 || count <= 0 || start >= num_samples) return 0;
+	count = std::min(count, num_samples - start);
+
+	// Fast path for the common case of everything wanted already being in
+	// the contiguous prefix
+	if (want_decoded && start + count <= prefix_samples) return count;
+
+	int64_t pos = start;
+	for (size_t i = static_cast<size_t>(start / chunk_size); pos < start + count; ++i) {
+		if (IsChunkDecoded(i) != want_decoded) break;
+		pos = (i + 1) * chunk_size;
+	}
+	return std::min(pos, start + count) - start;
+}
+} }
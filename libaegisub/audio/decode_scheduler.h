@@ -0,0 +1,113 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file decode_scheduler.h
+/// @brief Background decoding for the cache audio providers
+/// @ingroup libaegisub
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace agi { namespace audio {
+/// @class DecodeScheduler
+/// @brief Decodes an audio stream in fixed-size chunks on background threads
+///
+/// When the source can be read from several threads at once, the chunks are
+/// decoded concurrently and in any order: each worker claims the first
+/// undecoded chunk at or after a cursor, which Prioritize moves to wherever
+/// the audio is about to be needed. Otherwise a single worker decodes the
+/// chunks in order and Prioritize does nothing.
+///
+/// Which chunks are done is tracked with a bitmap, so cache providers can serve
+/// any decoded range rather than only the start of the stream.
+class DecodeScheduler {
+public:
+	/// Decode samples [start, start + count) into the cache
+	typedef std::function<void (int64_t start, int64_t count)> DecodeFunc;
+	/// Samples [start, end) have joined the contiguous run of decoded samples
+	/// at the beginning of the stream. Calls are made in order and never
+	/// overlap, so this is where anything which has to see the audio
+	/// sequentially (such as building peaks) goes.
+	typedef std::function<void (int64_t start, int64_t end)> PrefixFunc;
+
+private:
+	int64_t num_samples;
+	int64_t chunk_size;
+	size_t num_chunks;
+	bool concurrent;
+	DecodeFunc decode;
+	PrefixFunc prefix_advanced;
+
+	/// One bit per chunk which is set once the chunk has been decoded
+	std::unique_ptr<std::atomic<uint64_t>[]> decoded;
+	/// Length of the contiguous decoded run at the start, in samples
+	std::atomic<int64_t> prefix_samples{0};
+	/// Guards prefix_chunks and serializes prefix_advanced
+	std::mutex prefix_lock;
+	size_t prefix_chunks = 0;
+
+	/// Guards claimed and cursor
+	std::mutex claim_lock;
+	std::vector<bool> claimed;
+	size_t cursor = 0;
+	size_t unclaimed;
+
+	std::atomic<bool> cancelled{false};
+	std::vector<std::thread> workers;
+
+	bool IsChunkDecoded(size_t i) const;
+	bool Claim(size_t& chunk);
+	void Finish(size_t chunk);
+	void Work();
+	/// Length of the run starting at start whose chunks are all decoded (or
+	/// all undecoded), capped at count
+	int64_t Run(int64_t start, int64_t count, bool want_decoded) const;
+
+public:
+	/// Constructor
+	/// @param num_samples Length of the stream
+	/// @param chunk_size Samples per chunk
+	/// @param concurrent Can decode be called from several threads at once for different chunks?
+	/// @param decode Function which decodes a chunk
+	/// @param prefix_advanced Function notified of decoding progress
+	///
+	/// Decoding starts immediately.
+	DecodeScheduler(int64_t num_samples, int64_t chunk_size, bool concurrent, DecodeFunc decode, PrefixFunc prefix_advanced);
+	/// Stops decoding and waits for the workers to finish their current chunks
+	~DecodeScheduler();
+
+	/// Decode the chunks from the one containing sample onwards next
+	void Prioritize(int64_t sample);
+
+	/// Number of samples starting at start which have been decoded, capped at count
+	int64_t Decoded(int64_t start, int64_t count) const { return Run(start, count, true); }
+	/// Number of samples starting at start which have not been decoded, capped at count
+	int64_t Missing(int64_t start, int64_t count) const { return Run(start, count, false); }
+
+	/// Length of the contiguous decoded run at the start of the stream
+	int64_t Prefix() const { return prefix_samples; }
+
+	/// Has the scheduler been told to stop?
+	bool IsCancelled() const { return cancelled; }
+};
+} }
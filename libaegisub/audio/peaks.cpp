@@ -0,0 +1,157 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/audio/peaks.h"
+
+#include "libaegisub/audio/provider.h"
+#include "libaegisub/file_mapping.h"
+#include "libaegisub/io.h"
+#include "libaegisub/log.h"
+
+#include <boost/filesystem/path.hpp>
+#include <cstring>
+
+namespace {
+// Each level summarises 256, 4096 and 65536 samples per entry respectively
+const int level_shift[agi::AudioPeakPyramid::levels] = {8, 12, 16};
+const int64_t base_block_size = 1LL << 8;
+
+const char file_magic[8] = {'A', 'G', 'I', 'P', 'E', 'A', 'K', '1'};
+}
+
+namespace agi {
+AudioPeakPyramid::AudioPeakPyramid(int64_t num_samples)
+: num_samples(num_samples)
+{
+	for (size_t i = 0; i < levels; ++i)
+		data[i].resize((num_samples + (1LL << level_shift[i]) - 1) >> level_shift[i]);
+}
+
+void AudioPeakPyramid::Append(const int16_t *buf, int64_t count) {
+	count = std::min(count, num_samples - added_samples);
+	while (count > 0) {
+		auto n = std::min(count, base_block_size - (added_samples & (base_block_size - 1)));
+		for (int64_t i = 0; i < n; ++i)
+			partial[0].Add(buf[i]);
+		buf += n;
+		count -= n;
+		added_samples += n;
+
+		// Close every block which ends at the current position, pushing the
+		// finished summary up into the next coarser level
+		for (size_t level = 0; level < levels; ++level) {
+			int64_t size = 1LL << level_shift[level];
+			if ((added_samples & (size - 1)) && added_samples != num_samples)
+				break;
+			data[level][(added_samples - 1) >> level_shift[level]] = partial[level];
+			if (level + 1 < levels)
+				partial[level + 1].Add(partial[level]);
+			partial[level] = AudioPeak();
+		}
+	}
+	Publish();
+}
+
+void AudioPeakPyramid::Publish() {
+	available_samples = added_samples;
+}
+
+AudioPeak AudioPeakPyramid::Query(AudioProvider const& provider, int64_t start, int64_t count) const {
+	AudioPeak ret;
+
+	// Samples outside of the stream are silence, which does not contribute
+	// anything to the summary
+	int64_t end = std::min(start + count, num_samples);
+	start = std::max<int64_t>(start, 0);
+	const int64_t available = available_samples;
+
+	while (start < end) {
+		bool found = false;
+		for (size_t level = levels; level-- > 0; ) {
+			int64_t size = 1LL << level_shift[level];
+			int64_t block_end = std::min(start + size, num_samples);
+			if ((start & (size - 1)) || block_end > end || block_end > available)
+				continue;
+			ret.Add(data[level][start >> level_shift[level]]);
+			start = block_end;
+			found = true;
+			break;
+		}
+		if (found) continue;
+
+		// Range edge or not yet summarised, so read up to the next block
+		// boundary from the provider
+		int16_t buf[base_block_size];
+		auto n = std::min(end, (start | (base_block_size - 1)) + 1) - start;
+		provider.GetInt16MonoAudio(buf, start, n);
+		for (int64_t i = 0; i < n; ++i)
+			ret.Add(buf[i]);
+		start += n;
+	}
+
+	return ret;
+}
+
+bool AudioPeakPyramid::Load(fs::path const& filename) {
+	try {
+		read_file_mapping file(filename);
+
+		uint64_t expected_size = sizeof(file_magic) + sizeof(num_samples);
+		for (auto const& level : data)
+			expected_size += level.size() * sizeof(AudioPeak);
+		if (file.size() != expected_size)
+			return false;
+
+		const char *src = file.read();
+		if (memcmp(src, file_magic, sizeof(file_magic)))
+			return false;
+		src += sizeof(file_magic);
+
+		int64_t file_samples;
+		memcpy(&file_samples, src, sizeof(file_samples));
+		if (file_samples != num_samples)
+			return false;
+		src += sizeof(file_samples);
+
+		for (auto& level : data) {
+			memcpy(level.data(), src, level.size() * sizeof(AudioPeak));
+			src += level.size() * sizeof(AudioPeak);
+		}
+	}
+	catch (agi::Exception const& e) {
+		LOG_D("audio/peaks") << "Not using peak cache " << filename << ": " << e.GetMessage();
+		return false;
+	}
+	catch (...) {
+		return false;
+	}
+
+	added_samples = num_samples;
+	Publish();
+	return true;
+}
+
+void AudioPeakPyramid::Save(fs::path const& filename) const {
+	if (!IsComplete()) return;
+
+	io::Save file(filename, true);
+	auto& out = file.Get();
+	out.write(file_magic, sizeof(file_magic));
+	out.write(reinterpret_cast<const char *>(&num_samples), sizeof(num_samples));
+	for (auto const& level : data)
+		out.write(reinterpret_cast<const char *>(level.data()), level.size() * sizeof(AudioPeak));
+}
+}
@@ -16,150 +16,128 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include "sample_convert.h"
+
 #include "libaegisub/fs.h"
 #include "libaegisub/io.h"
 #include "libaegisub/log.h"
 #include "libaegisub/util.h"
 
 namespace {
-
-template<typename Source>
-class ConvertFloatToInt16 {
-	Source* src;
-public:
-	ConvertFloatToInt16(Source* src) :src(src) {}
-	int16_t operator[](size_t idx) const {
-		Source expanded = src[idx] * 32768;
-		return expanded < -32768 ? -32768 :
-			expanded > 32767 ? 32767 :
-			static_cast<int16_t>(expanded);
-	}
-};
-
-// 8 bits per sample is assumed to be unsigned with a bias of 128,
-// while everything else is assumed to be signed with zero bias
-class ConvertIntToInt16 {
-	void* src;
-	int bytes_per_sample;
-public:
-	ConvertIntToInt16(void* src, int bytes_per_sample) :src(src), bytes_per_sample(bytes_per_sample) {}
-	const int16_t& operator[](size_t idx) const {
-		return *reinterpret_cast<int16_t*>(reinterpret_cast<char*>(src) + (idx + 1) * bytes_per_sample - sizeof(int16_t));
-	}
-};
-class ConvertUInt8ToInt16 {
-	uint8_t* src;
-public:
-	ConvertUInt8ToInt16(uint8_t* src) :src(src) {}
-	int16_t operator[](size_t idx) const {
-		return int16_t(src[idx]-128) << 8;
-	}
-};
-
-template<typename Source>
-class DownmixToMono {
-	Source src;
-	int channels;
-public:
-	DownmixToMono(Source src, int channels) :src(src), channels(channels) {}
-	int16_t operator[](size_t idx) const {
-		int ret = 0;
-		// Just average the channels together
-		for (int i = 0; i < channels; ++i)
-			ret += src[idx * channels + i];
-		return ret / channels;
-	}
-};
+/// Size of the scratch space conversions are done in, to keep it in cache
+/// and bound how much memory each thread holds on to
+const int64_t scratch_size = 1 << 18;
 }
 
 namespace agi {
 void AudioProvider::FillBufferInt16Mono(int16_t* buf, int64_t start, int64_t count) const {
+	// Convert straight out of the cache where possible
+	const void *span;
+	while (int64_t n = GetSpan(start, count, &span)) {
+		ConvertToInt16Mono(span, buf, n);
+		buf += n;
+		start += n;
+		count -= n;
+	}
+	if (count == 0) return;
+
 	if (!float_samples && bytes_per_sample == 2 && channels == 1) {
 		FillBuffer(buf, start, count);
 		return;
 	}
-	void* buff = malloc(bytes_per_sample * count * channels);
-	FillBuffer(buff, start, count);
+
+	const int64_t frame_size = bytes_per_sample * channels;
+	const int64_t chunk = std::max<int64_t>(1, scratch_size / frame_size);
+	audio::ScratchBuffer scratch(std::min(count, chunk) * frame_size);
+	for (int64_t i = 0; i < count; i += chunk) {
+		auto n = std::min(chunk, count - i);
+		FillBuffer(scratch.get<char>(), start + i, n);
+		ConvertToInt16Mono(scratch.get<char>(), buf + i, n);
+	}
+}
+
+void AudioProvider::ConvertToInt16Mono(const void *src, int16_t *buf, int64_t count) const {
 	if (channels == 1) {
-		if (float_samples) {
-			if (bytes_per_sample == sizeof(float))
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = ConvertFloatToInt16<float>(reinterpret_cast<float*>(buff))[i];
-			else if (bytes_per_sample == sizeof(double))
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = ConvertFloatToInt16<double>(reinterpret_cast<double*>(buff))[i];
-		}
-		else {
-			if (bytes_per_sample == sizeof(uint8_t))
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = ConvertUInt8ToInt16(reinterpret_cast<uint8_t*>(buff))[i];
-			else
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = ConvertIntToInt16(buff, bytes_per_sample)[i];
-		}
+		audio::ConvertToInt16(src, buf, count, bytes_per_sample, float_samples);
+		return;
 	}
-	else {
-		if (float_samples) {
-			if (bytes_per_sample == sizeof(float))
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = DownmixToMono<ConvertFloatToInt16<float> >(ConvertFloatToInt16<float>(reinterpret_cast<float*>(buff)), channels)[i];
-			else if (bytes_per_sample == sizeof(double))
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = DownmixToMono<ConvertFloatToInt16<double> >(ConvertFloatToInt16<double>(reinterpret_cast<double*>(buff)), channels)[i];
-		}
-		else {
-			if (bytes_per_sample == sizeof(uint8_t))
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = DownmixToMono<ConvertUInt8ToInt16>(ConvertUInt8ToInt16(reinterpret_cast<uint8_t*>(buff)), channels)[i];
-			else
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = DownmixToMono<ConvertIntToInt16>(ConvertIntToInt16(buff, bytes_per_sample), channels)[i];
-		}
+
+	// Convert a chunk of interleaved samples at a time, then downmix that
+	auto in = static_cast<const char *>(src);
+	const int64_t chunk = std::max<int64_t>(1, scratch_size / sizeof(int16_t) / channels);
+	audio::ScratchBuffer interleaved(std::min(count, chunk) * channels * sizeof(int16_t));
+	for (int64_t i = 0; i < count; i += chunk) {
+		auto n = std::min(chunk, count - i);
+		audio::ConvertToInt16(in + i * bytes_per_sample * channels, interleaved.get<int16_t>(), n * channels, bytes_per_sample, float_samples);
+		audio::DownmixToMono(interleaved.get<int16_t>(), buf + i, n, channels);
 	}
-	free(buff);
 }
 
-// This entire file has turned into a mess. For now I'm just following the pattern of the wangqr code, but
-// this should really be restructured entirely again. The original type constructor-based system worked very well - it could
-// just give downmix/conversion control to the players instead.
-void AudioProvider::GetAudioWithVolume(void *buf, int64_t start, int64_t count, double volume) const {
-	GetAudio(buf, start, count);
-	if (volume == 1.0) return;
-
+void AudioProvider::ScaleSamples(const void *src, void *dst, int64_t count, double volume) const {
 	int64_t n = count * GetChannels();
 
 	if (float_samples) {
 		if (bytes_per_sample == sizeof(float)) {
-			float *buff = reinterpret_cast<float *>(buf);
+			auto in = static_cast<const float *>(src);
+			auto out = static_cast<float *>(dst);
 			for (int64_t i = 0; i < n; ++i)
-				buff[i] = static_cast<float>(buff[i] * volume);
+				out[i] = static_cast<float>(in[i] * volume);
 		} else if (bytes_per_sample == sizeof(double)) {
-			double *buff = reinterpret_cast<double *>(buf);
+			auto in = static_cast<const double *>(src);
+			auto out = static_cast<double *>(dst);
 			for (int64_t i = 0; i < n; ++i)
-				buff[i] = buff[i] * volume;
+				out[i] = in[i] * volume;
 		}
 	}
 	else {
 		if (bytes_per_sample == sizeof(uint8_t)) {
-			uint8_t *buff = reinterpret_cast<uint8_t *>(buf);
+			auto in = static_cast<const uint8_t *>(src);
+			auto out = static_cast<uint8_t *>(dst);
 			for (int64_t i = 0; i < n; ++i)
-				buff[i] = util::mid(0, static_cast<int>(((int) buff[i] - 128) * volume + 128), 0xFF);
+				out[i] = util::mid(0, static_cast<int>(((int) in[i] - 128) * volume + 128), 0xFF);
 		} else if (bytes_per_sample == sizeof(int16_t)) {
-			int16_t *buff = reinterpret_cast<int16_t *>(buf);
+			auto in = static_cast<const int16_t *>(src);
+			auto out = static_cast<int16_t *>(dst);
 			for (int64_t i = 0; i < n; ++i)
-				buff[i] = util::mid(-0x8000, static_cast<int>(buff[i] * volume), 0x7FFF);
+				out[i] = util::mid(-0x8000, static_cast<int>(in[i] * volume), 0x7FFF);
 		} else if (bytes_per_sample == sizeof(int32_t)) {
-			int32_t *buff = reinterpret_cast<int32_t *>(buf);
+			auto in = static_cast<const int32_t *>(src);
+			auto out = static_cast<int32_t *>(dst);
 			for (int64_t i = 0; i < n; ++i)
-				buff[i] = static_cast<int32_t>(buff[i] * volume);
+				out[i] = static_cast<int32_t>(in[i] * volume);
 		} else if (bytes_per_sample == sizeof(int64_t)) {
-			int64_t *buff = reinterpret_cast<int64_t *>(buf);
+			auto in = static_cast<const int64_t *>(src);
+			auto out = static_cast<int64_t *>(dst);
 			for (int64_t i = 0; i < n; ++i)
-				buff[i] = static_cast<int64_t>(buff[i] * volume);
+				out[i] = static_cast<int64_t>(in[i] * volume);
 		}
 	}
 }
 
+// This entire file has turned into a mess. For now I'm just following the pattern of the wangqr code, but
+// this should really be restructured entirely again. The original type constructor-based system worked very well - it could
+// just give downmix/conversion control to the players instead.
+void AudioProvider::GetAudioWithVolume(void *buf, int64_t start, int64_t count, double volume) const {
+	if (volume != 1.0 && start >= 0) {
+		// Scale straight out of the cache where possible rather than copying
+		// and then scaling in place
+		auto out = static_cast<char *>(buf);
+		const void *span;
+		while (int64_t n = GetSpan(start, count, &span)) {
+			ScaleSamples(span, out, n, volume);
+			out += n * bytes_per_sample * channels;
+			start += n;
+			count -= n;
+		}
+		buf = out;
+		if (count == 0) return;
+	}
+
+	GetAudio(buf, start, count);
+	if (volume == 1.0) return;
+	ScaleSamples(buf, buf, count, volume);
+}
+
 void AudioProvider::GetInt16MonoAudioWithVolume(int16_t *buf, int64_t start, int64_t count, double volume) const {
 	GetInt16MonoAudio(buf, start, count);
 	if (volume == 1.0) return;
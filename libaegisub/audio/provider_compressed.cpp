@@ -0,0 +1,171 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/audio/provider.h"
+
+#include "sample_codec.h"
+
+#include "libaegisub/audio/peaks.h"
+#include "libaegisub/log.h"
+#include "libaegisub/make_unique.h"
+
+#include <algorithm>
+#include <boost/filesystem/path.hpp>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+using namespace agi;
+
+/// Size of each block of decoded audio before compression. Smaller than the
+/// plain RAM cache's blocks so that a cache miss doesn't take long to fill.
+const int64_t raw_block_size = 1 << 20;
+/// Number of decompressed blocks to keep around
+const size_t hot_block_count = 16;
+
+/// RAM cache which stores each block losslessly compressed, for audio which
+/// would not fit in memory uncompressed
+class CompressedRAMAudioProvider final : public AudioProviderWrapper {
+	/// Samples per channel in each block
+	int64_t samples_per_block;
+	/// Compressed blocks. Only those before decoded_samples may be read.
+	std::vector<std::vector<uint8_t>> blocks;
+
+	typedef std::shared_ptr<const std::vector<char>> HotBlock;
+	/// Recently used blocks in decompressed form, most recently used first
+	mutable std::vector<std::pair<size_t, HotBlock>> hot;
+	mutable std::mutex hot_lock;
+
+	AudioPeakPyramid peaks;
+	std::atomic<bool> cancelled = {false};
+	std::thread decoder;
+
+	int64_t BlockFrames(size_t i) const {
+		return std::min<int64_t>(samples_per_block, num_samples - i * samples_per_block);
+	}
+
+	HotBlock GetBlock(size_t i) const;
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override;
+
+public:
+	CompressedRAMAudioProvider(std::unique_ptr<AudioProvider> src, fs::path const& peak_cache)
+	: AudioProviderWrapper(std::move(src))
+	, samples_per_block(std::max<int64_t>(1, raw_block_size / bytes_per_sample / channels))
+	, blocks((num_samples + samples_per_block - 1) / samples_per_block)
+	, peaks(num_samples)
+	{
+		decoded_samples = 0;
+		bool build_peaks = peak_cache.empty() || !peaks.Load(peak_cache);
+
+		decoder = std::thread([=] {
+			std::vector<char> raw(samples_per_block * bytes_per_sample * channels);
+			std::vector<int16_t> mono(build_peaks ? samples_per_block : 0);
+			try {
+				for (size_t i = 0; i < blocks.size(); i++) {
+					if (cancelled) break;
+					auto actual_read = BlockFrames(i);
+					source->GetAudio(raw.data(), i * samples_per_block, actual_read);
+					if (build_peaks) {
+						ConvertToInt16Mono(raw.data(), mono.data(), actual_read);
+						peaks.Append(mono.data(), actual_read);
+					}
+					audio::CompressSamples(raw.data(), actual_read, channels, bytes_per_sample, float_samples, blocks[i]);
+					decoded_samples += actual_read;
+				}
+			}
+			catch (std::bad_alloc const&) {
+				LOG_E("audio_provider/compressed_ram") << "Ran out of memory after caching " << decoded_samples << " samples";
+				return;
+			}
+
+			if (build_peaks && !peak_cache.empty() && peaks.IsComplete()) {
+				try {
+					peaks.Save(peak_cache);
+				}
+				catch (agi::Exception const& e) {
+					LOG_E("audio_provider/compressed_ram") << "Failed to save peak cache: " << e.GetMessage();
+				}
+			}
+		});
+	}
+
+	AudioPeakPyramid const* GetPeaks() const override { return &peaks; }
+
+	~CompressedRAMAudioProvider() {
+		cancelled = true;
+		decoder.join();
+	}
+};
+
+CompressedRAMAudioProvider::HotBlock CompressedRAMAudioProvider::GetBlock(size_t i) const {
+	{
+		std::lock_guard<std::mutex> lock(hot_lock);
+		for (size_t j = 0; j < hot.size(); ++j) {
+			if (hot[j].first == i) {
+				std::rotate(hot.begin(), hot.begin() + j, hot.begin() + j + 1);
+				return hot.front().second;
+			}
+		}
+	}
+
+	// Decompress without holding the lock so that other threads reading
+	// blocks which are already hot aren't held up. The decompressed block
+	// is shared so that evicting it doesn't pull it out from under a reader.
+	auto frames = BlockFrames(i);
+	auto block = std::make_shared<std::vector<char>>(frames * bytes_per_sample * channels);
+	audio::DecompressSamples(blocks[i].data(), blocks[i].size(), block->data(), frames, channels, bytes_per_sample, float_samples);
+
+	std::lock_guard<std::mutex> lock(hot_lock);
+	hot.emplace(hot.begin(), i, block);
+	if (hot.size() > hot_block_count)
+		hot.pop_back();
+	return block;
+}
+
+void CompressedRAMAudioProvider::FillBuffer(void *buf, int64_t start, int64_t count) const {
+	auto out = static_cast<char *>(buf);
+	const int64_t frame_size = bytes_per_sample * channels;
+	while (count > 0) {
+		// decoded_samples only ever covers whole blocks (or the end of the
+		// audio), so everything before it can be read
+		if (start >= decoded_samples) {
+			memset(out, 0, count * frame_size);
+			break;
+		}
+
+		const size_t i = start / samples_per_block;
+		const int64_t offset = start % samples_per_block;
+		const int64_t n = std::min(count, BlockFrames(i) - offset);
+
+		auto block = GetBlock(i);
+		memcpy(out, block->data() + offset * frame_size, n * frame_size);
+		out += n * frame_size;
+		start += n;
+		count -= n;
+	}
+}
+}
+
+namespace agi {
+std::unique_ptr<AudioProvider> CreateCompressedRAMAudioProvider(std::unique_ptr<AudioProvider> src) {
+	return agi::make_unique<CompressedRAMAudioProvider>(std::move(src), fs::path());
+}
+
+std::unique_ptr<AudioProvider> CreateCompressedRAMAudioProvider(std::unique_ptr<AudioProvider> src, fs::path const& peak_cache) {
+	return agi::make_unique<CompressedRAMAudioProvider>(std::move(src), peak_cache);
+}
+}
@@ -34,6 +34,8 @@ public:
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
 		source->GetInt16MonoAudio(reinterpret_cast<int16_t*>(buf), start, count);
 	}
+
+	bool SupportsConcurrentReads() const override { return source->SupportsConcurrentReads(); }
 };
 /// Sample doubler with linear interpolation for the samples provider
 /// Requires 16-bit mono input
@@ -45,6 +47,8 @@ public:
 		decoded_samples = decoded_samples * 2;
 	}
 
+	bool SupportsConcurrentReads() const override { return source->SupportsConcurrentReads(); }
+
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
 		int16_t *src, *dst = static_cast<int16_t *>(buf);
 
@@ -16,37 +16,88 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include "decode_scheduler.h"
+
+#include <libaegisub/audio/peaks.h>
 #include <libaegisub/file_mapping.h>
 #include <libaegisub/format.h>
 #include <libaegisub/fs.h>
+#include <libaegisub/io.h>
+#include <libaegisub/log.h>
 #include <libaegisub/path.h>
 #include <libaegisub/make_unique.h>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/interprocess/detail/os_thread_functions.hpp>
 #include <ctime>
+#include <mutex>
 #include <thread>
 
 namespace {
 using namespace agi;
 
+/// Header of a persisted cache file, which is followed by the samples
+struct PersistentHeader {
+	char magic[8];
+	int64_t num_samples;
+	int32_t sample_rate;
+	int32_t channels;
+	int32_t bytes_per_sample;
+	int32_t float_samples;
+};
+static_assert(sizeof(PersistentHeader) == 32, "PersistentHeader must not be padded");
+
+const char persistent_magic[8] = {'A', 'G', 'I', 'P', 'C', 'M', '0', '1'};
+
 class HDAudioProvider final : public AudioProviderWrapper {
-	mutable temp_file_mapping file;
+	/// Temporary file the audio is decoded into, unless it was already cached
+	mutable std::unique_ptr<temp_file_mapping> file;
+	/// Persisted cache file from an earlier session being reused
+	std::unique_ptr<read_file_mapping> persistent;
+	/// The entire file mapped for reading, if there's enough address space
+	/// for that. Otherwise reads have to go through file->read, which remaps
+	/// as needed.
+	const char *mapped_file = nullptr;
+	/// The entire temporary file mapped for writing, under the same conditions
+	char *mapped_write = nullptr;
+	/// Serializes reads through file->read, so that audio can be read from
+	/// several threads at once either way
+	mutable std::mutex read_lock;
+	AudioPeakPyramid peaks;
+	/// Set when closing to cut short saving the audio and building peaks
 	std::atomic<bool> cancelled = {false};
-	std::thread decoder;
+	/// Builds the peaks when reusing a persisted file without a peak cache
+	std::thread peak_builder;
+	std::unique_ptr<audio::DecodeScheduler> decoder;
 
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
-		auto missing = std::min(count, start + count - decoded_samples);
-		if (missing > 0) {
-			memset(static_cast<int16_t*>(buf) + count - missing, 0, missing * bytes_per_sample * channels);
-			count -= missing;
+		auto out = static_cast<char *>(buf);
+		const int64_t frame_size = bytes_per_sample * channels;
+		while (count > 0) {
+			int64_t n = decoder ? decoder->Decoded(start, count) : count;
+			if (n && mapped_file)
+				memcpy(out, mapped_file + start * frame_size, n * frame_size);
+			else if (n) {
+				std::lock_guard<std::mutex> lock(read_lock);
+				memcpy(out, file->read(start * frame_size, n * frame_size), n * frame_size);
+			}
+			else {
+				n = std::max<int64_t>(1, decoder->Missing(start, count));
+				memset(out, 0, n * frame_size);
+			}
+			out += n * frame_size;
+			start += n;
+			count -= n;
 		}
+	}
 
-		if (count > 0) {
-			start *= bytes_per_sample * channels;
-			count *= bytes_per_sample * channels;
-			memcpy(buf, file.read(start, count), count);
-		}
+	/// Get a pointer to the decoded audio for the decoder threads. Without a
+	/// mapping of the whole file this remaps, which is only safe because
+	/// there's then just the one decoder thread.
+	char *Storage(int64_t start, int64_t count) const {
+		if (mapped_write)
+			return mapped_write + start * bytes_per_sample * channels;
+		return file->write(start * bytes_per_sample * channels, count * bytes_per_sample * channels);
 	}
 
 	fs::path CacheFilename(fs::path const& dir) {
@@ -58,32 +109,185 @@ class HDAudioProvider final : public AudioProviderWrapper {
 		              boost::interprocess::ipcdetail::get_current_process_id());
 	}
 
+	PersistentHeader MakeHeader() const {
+		PersistentHeader header;
+		memcpy(header.magic, persistent_magic, sizeof(persistent_magic));
+		header.num_samples = num_samples;
+		header.sample_rate = sample_rate;
+		header.channels = channels;
+		header.bytes_per_sample = bytes_per_sample;
+		header.float_samples = float_samples;
+		return header;
+	}
+
+	/// Try to use audio decoded in an earlier session
+	bool LoadPersistent(fs::path const& filename) {
+		try {
+			auto mapping = agi::make_unique<read_file_mapping>(filename);
+			if (mapping->size() != sizeof(PersistentHeader) + (uint64_t)num_samples * bytes_per_sample * channels)
+				return false;
+
+			auto expected = MakeHeader();
+			if (memcmp(mapping->read(0, sizeof(PersistentHeader)), &expected, sizeof(PersistentHeader)))
+				return false;
+
+			mapped_file = mapping->read() + sizeof(PersistentHeader);
+			persistent = std::move(mapping);
+		}
+		catch (agi::Exception const& e) {
+			LOG_D("audio_provider/hd") << "Not using cached audio " << filename << ": " << e.GetMessage();
+			return false;
+		}
+		catch (std::bad_alloc const&) {
+			return false;
+		}
+
+		return true;
+	}
+
+	/// Save the fully decoded audio for use in later sessions
+	void SavePersistent(fs::path const& filename) const {
+		try {
+			auto header = MakeHeader();
+			io::Save file(filename, true);
+			auto& out = file.Get();
+			out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+			// Written in chunks so that closing the audio doesn't have to
+			// wait for all of it
+			const int64_t size = num_samples * bytes_per_sample * channels;
+			const int64_t chunk = 1 << 24;
+			int64_t written = 0;
+			for (; written < size && !cancelled && out.good(); written += chunk)
+				out.write(mapped_file + written, std::min(chunk, size - written));
+
+			// Only a complete file may replace the cache entry
+			if (written < size || !out.good()) {
+				LOG_D("audio_provider/hd") << "Not saving incomplete audio cache " << filename;
+				file.Discard();
+			}
+		}
+		catch (agi::Exception const& e) {
+			LOG_E("audio_provider/hd") << "Failed to save audio cache: " << e.GetMessage();
+		}
+	}
+
+	void SavePeaks(fs::path const& peak_cache) {
+		if (peak_cache.empty() || !peaks.IsComplete()) return;
+		try {
+			peaks.Save(peak_cache);
+		}
+		catch (agi::Exception const& e) {
+			LOG_E("audio_provider/hd") << "Failed to save peak cache: " << e.GetMessage();
+		}
+	}
+
 public:
-	HDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir)
+	HDAudioProvider(std::unique_ptr<AudioProvider> src, fs::path const& dir, fs::path const& peak_cache, fs::path const& persistent_file)
 	: AudioProviderWrapper(std::move(src))
-	, file(dir / CacheFilename(dir), num_samples * bytes_per_sample * channels)
+	, peaks(num_samples)
 	{
 		decoded_samples = 0;
-		decoder = std::thread([&] {
-			int64_t block = 65536;
-			for (int64_t i = 0; i < num_samples; i += block) {
-				if (cancelled) break;
-				block = std::min(block, num_samples - i);
-				source->GetAudio(file.write(i * bytes_per_sample * channels, block * bytes_per_sample * channels), i, block);
-				decoded_samples += block;
+		bool build_peaks = peak_cache.empty() || !peaks.Load(peak_cache);
+
+		if (!persistent_file.empty() && LoadPersistent(persistent_file)) {
+			decoded_samples = num_samples;
+			if (!build_peaks) return;
+
+			peak_builder = std::thread([=] {
+				const int64_t block = 65536;
+				std::vector<int16_t> mono(block);
+				for (int64_t i = 0; i < num_samples; i += block) {
+					if (cancelled) return;
+					auto n = std::min(block, num_samples - i);
+					ConvertToInt16Mono(mapped_file + i * bytes_per_sample * channels, mono.data(), n);
+					peaks.Append(mono.data(), n);
+				}
+				SavePeaks(peak_cache);
+			});
+			return;
+		}
+
+		file = agi::make_unique<temp_file_mapping>(dir / CacheFilename(dir), num_samples * bytes_per_sample * channels);
+		if (sizeof(size_t) >= 8) {
+			mapped_file = file->read(0, num_samples * bytes_per_sample * channels);
+			mapped_write = file->write(0, num_samples * bytes_per_sample * channels);
+		}
+
+		const int64_t block = 65536;
+		auto decode = [=](int64_t start, int64_t count) {
+			source->GetAudio(Storage(start, count), start, count);
+		};
+
+		auto prefix_advanced = [=](int64_t start, int64_t end) {
+			if (build_peaks) {
+				std::vector<int16_t> mono(block);
+				for (; start < end; start += block) {
+					auto n = std::min(block, end - start);
+					ConvertToInt16Mono(Storage(start, n), mono.data(), n);
+					peaks.Append(mono.data(), n);
+				}
 			}
-		});
+			decoded_samples = end;
+			if (end < num_samples) return;
+
+			if (build_peaks)
+				SavePeaks(peak_cache);
+
+			// Only done when the whole file is mapped, as remapping would
+			// interfere with reads on other threads
+			if (!persistent_file.empty() && mapped_file)
+				SavePersistent(persistent_file);
+		};
+
+		// Without a mapping of the whole file, writes remap and so can only
+		// be done from one thread
+		decoder = agi::make_unique<audio::DecodeScheduler>(num_samples, block,
+			mapped_file && source->SupportsConcurrentReads(), decode, prefix_advanced);
+	}
+
+	AudioPeakPyramid const* GetPeaks() const override { return &peaks; }
+
+	bool IsRangeDecoded(int64_t start, int64_t count) const override {
+		if (!decoder) return AudioProvider::IsRangeDecoded(start, count);
+		return decoder->Decoded(start, count) == count;
+	}
+
+	void PrioritizeDecoding(int64_t sample) const override {
+		if (decoder) decoder->Prioritize(sample);
+	}
+
+	int64_t GetSpan(int64_t start, int64_t count, const void **data) const override {
+		if (!mapped_file || start < 0) return 0;
+		if (decoder)
+			count = decoder->Decoded(start, count);
+		else
+			count = std::min(count, num_samples - start);
+		if (count <= 0) return 0;
+
+		*data = mapped_file + start * bytes_per_sample * channels;
+		return count;
 	}
 
 	~HDAudioProvider() {
 		cancelled = true;
-		decoder.join();
+		if (peak_builder.joinable())
+			peak_builder.join();
+		decoder.reset();
 	}
 };
 }
 
 namespace agi {
 std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir) {
-	return agi::make_unique<HDAudioProvider>(std::move(src), dir);
+	return agi::make_unique<HDAudioProvider>(std::move(src), dir, agi::fs::path(), agi::fs::path());
+}
+
+std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir, agi::fs::path const& peak_cache) {
+	return agi::make_unique<HDAudioProvider>(std::move(src), dir, peak_cache, agi::fs::path());
+}
+
+std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir, agi::fs::path const& peak_cache, agi::fs::path const& persistent_file) {
+	return agi::make_unique<HDAudioProvider>(std::move(src), dir, peak_cache, persistent_file);
 }
 }
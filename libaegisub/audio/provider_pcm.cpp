@@ -59,6 +59,13 @@ class PCMAudioProvider : public AudioProvider {
 		ZeroFill(write_buf, count);
 	}
 
+public:
+	// FillBuffer isn't synchronized. It's only safe to call from several
+	// threads because on 64-bit builds reading the header maps the whole
+	// file, so later reads only look at that mapping and never replace it.
+	// On 32-bit builds reads remap a window of the file, which would race.
+	bool SupportsConcurrentReads() const override { return sizeof(size_t) >= 8; }
+
 protected:
 	mutable read_file_mapping file;
 	uint64_t file_pos = 0;
@@ -16,11 +16,15 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include "decode_scheduler.h"
+
+#include "libaegisub/audio/peaks.h"
+#include "libaegisub/log.h"
 #include "libaegisub/make_unique.h"
 
 #include <array>
 #include <boost/container/stable_vector.hpp>
-#include <thread>
+#include <boost/filesystem/path.hpp>
 
 namespace {
 using namespace agi;
@@ -34,65 +38,111 @@ class RAMAudioProvider final : public AudioProviderWrapper {
 #else
 	boost::container::stable_vector<std::array<char, CacheBlockSize>> blockcache;
 #endif
-	std::atomic<bool> cancelled = {false};
-	std::thread decoder;
+	/// Number of samples in each cache block, which is also the size of the
+	/// chunks they're decoded in
+	int64_t samples_per_block;
+	AudioPeakPyramid peaks;
+	std::unique_ptr<audio::DecodeScheduler> decoder;
 
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override;
 
 public:
-	RAMAudioProvider(std::unique_ptr<AudioProvider> src)
+	RAMAudioProvider(std::unique_ptr<AudioProvider> src, fs::path const& peak_cache)
 	: AudioProviderWrapper(std::move(src))
+	, samples_per_block(CacheBlockSize / bytes_per_sample / channels)
+	, peaks(num_samples)
 	{
 		decoded_samples = 0;
+		bool build_peaks = peak_cache.empty() || !peaks.Load(peak_cache);
 
 		try {
-			blockcache.resize((num_samples * bytes_per_sample * channels + CacheBlockSize - 1) >> CacheBits);
+			blockcache.resize((num_samples + samples_per_block - 1) / samples_per_block);
 		}
 		catch (std::bad_alloc const&) {
 			throw AudioProviderError("Not enough memory available to cache in RAM");
 		}
 
-		decoder = std::thread([&] {
-			int64_t readsize = CacheBlockSize / bytes_per_sample / channels;
-			for (size_t i = 0; i < blockcache.size(); i++) {
-				if (cancelled) break;
-				auto actual_read = std::min<int64_t>(readsize, num_samples - i * readsize);
-				source->GetAudio(&blockcache[i][0], i * readsize, actual_read);
-				decoded_samples += actual_read;
+		// Each cache block is decoded as a single chunk
+		auto decode = [=](int64_t start, int64_t count) {
+			source->GetAudio(&blockcache[start / samples_per_block][0], start, count);
+		};
+
+		auto prefix_advanced = [=](int64_t start, int64_t end) {
+			if (build_peaks) {
+				std::vector<int16_t> mono(samples_per_block);
+				for (; start < end; start += samples_per_block) {
+					auto n = std::min(samples_per_block, end - start);
+					ConvertToInt16Mono(&blockcache[start / samples_per_block][0], mono.data(), n);
+					peaks.Append(mono.data(), n);
+				}
+			}
+			decoded_samples = end;
+
+			if (build_peaks && !peak_cache.empty() && peaks.IsComplete()) {
+				try {
+					peaks.Save(peak_cache);
+				}
+				catch (agi::Exception const& e) {
+					LOG_E("audio_provider/ram") << "Failed to save peak cache: " << e.GetMessage();
+				}
 			}
-		});
+		};
+
+		decoder = agi::make_unique<audio::DecodeScheduler>(num_samples, samples_per_block,
+			source->SupportsConcurrentReads(), decode, prefix_advanced);
+	}
+
+	AudioPeakPyramid const* GetPeaks() const override { return &peaks; }
+
+	bool IsRangeDecoded(int64_t start, int64_t count) const override {
+		return decoder->Decoded(start, count) == count;
+	}
+
+	void PrioritizeDecoding(int64_t sample) const override {
+		decoder->Prioritize(sample);
+	}
+
+	int64_t GetSpan(int64_t start, int64_t count, const void **data) const override {
+		const int64_t offset = start % samples_per_block;
+		count = std::min(decoder->Decoded(start, count), samples_per_block - offset);
+		if (count <= 0) return 0;
+
+		*data = &blockcache[start / samples_per_block][offset * bytes_per_sample * channels];
+		return count;
 	}
 
 	~RAMAudioProvider() {
-		cancelled = true;
-		decoder.join();
+		decoder.reset();
 	}
 };
 
 void RAMAudioProvider::FillBuffer(void *buf, int64_t start, int64_t count) const {
 	auto charbuf = static_cast<char *>(buf);
-	for (int64_t bytes_remaining = count * bytes_per_sample * channels; bytes_remaining; ) {
-		if (start >= decoded_samples) {
-			memset(charbuf, 0, bytes_remaining);
-			break;
+	const int frame_size = bytes_per_sample * channels;
+	while (count > 0) {
+		const void *span;
+		int64_t n = GetSpan(start, count, &span);
+		if (n)
+			memcpy(charbuf, span, n * frame_size);
+		else {
+			// Not decoded yet, so fill with silence up to the next chunk
+			// which has been
+			n = std::max<int64_t>(1, decoder->Missing(start, count));
+			memset(charbuf, 0, n * frame_size);
 		}
-
-		const int64_t samples_per_block = CacheBlockSize / bytes_per_sample / channels;
-
-		const size_t i = start / samples_per_block;
-		const int start_offset = (start % samples_per_block) * bytes_per_sample * channels;
-		const int read_size = std::min<int>(bytes_remaining, samples_per_block * bytes_per_sample * channels - start_offset);
-
-		memcpy(charbuf, &blockcache[i][start_offset], read_size);
-		charbuf += read_size;
-		bytes_remaining -= read_size;
-		start += read_size / bytes_per_sample / channels;
+		charbuf += n * frame_size;
+		start += n;
+		count -= n;
 	}
 }
 }
 
 namespace agi {
 std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> src) {
-	return agi::make_unique<RAMAudioProvider>(std::move(src));
+	return agi::make_unique<RAMAudioProvider>(std::move(src), fs::path());
+}
+
+std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> src, fs::path const& peak_cache) {
+	return agi::make_unique<RAMAudioProvider>(std::move(src), peak_cache);
 }
 }
\ No newline at end of file
@@ -0,0 +1,212 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/audio/read_ahead.h"
+
+#include "libaegisub/audio/provider.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace agi {
+AudioReadAhead::AudioReadAhead(AudioProvider const& provider, bool mono16, int buffer_ms)
+: provider(provider)
+, mono16(mono16)
+, frame_size(mono16 ? sizeof(int16_t) : provider.GetBytesPerSample() * provider.GetChannels())
+, capacity(std::max<int64_t>(1, (int64_t)provider.GetSampleRate() * buffer_ms / 1000))
+// Small enough that a single read doesn't leave the ring short for long
+, chunk(std::max<int64_t>(1, capacity / 8))
+, ring(capacity * frame_size)
+, decoder([=] { DecodeThread(); })
+{
+}
+
+AudioReadAhead::~AudioReadAhead() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		closing = true;
+	}
+	WakeDecoder();
+	decoder.join();
+}
+
+void AudioReadAhead::SleepDecoder(uint32_t seen) {
+#ifdef __linux__
+	static_assert(sizeof(wake_count) == sizeof(uint32_t), "futex needs a plain 32-bit word");
+	// Returns straight away if wake_count has already changed
+	syscall(SYS_futex, reinterpret_cast<uint32_t *>(&wake_count), FUTEX_WAIT_PRIVATE, seen, nullptr, nullptr, 0);
+#else
+	std::unique_lock<std::mutex> guard(wake_lock);
+	wake_cv.wait(guard, [&] { return wake_count != seen; });
+#endif
+}
+
+void AudioReadAhead::WakeDecoder() {
+	++wake_count;
+#ifdef __linux__
+	syscall(SYS_futex, reinterpret_cast<uint32_t *>(&wake_count), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+	{ std::lock_guard<std::mutex> guard(wake_lock); }
+	wake_cv.notify_one();
+#endif
+}
+
+void AudioReadAhead::DecodeThread() {
+	uint64_t epoch = 0;
+	int64_t pos = 0;
+
+	std::unique_lock<std::mutex> guard(lock);
+	while (!closing) {
+		// Anything which changes what there is to do after this point also
+		// changes wake_count, so sleeping on it can't miss that
+		const uint32_t seen = wake_count;
+
+		if (seek_epoch != epoch) {
+			epoch = seek_epoch;
+			pos = seek_target;
+			write_pos.store(pos, std::memory_order_release);
+			ack_epoch.store(epoch, std::memory_order_release);
+		}
+
+		// Don't decode audio which the consumer has skipped past
+		const int64_t skipped_to = read_pos;
+		if (skipped_to > pos) {
+			pos = skipped_to;
+			write_pos.store(pos, std::memory_order_release);
+		}
+
+		// Nothing to do until there's a seek or a new end position
+		if (pos >= end) {
+			wants_space.store(false, std::memory_order_relaxed);
+			guard.unlock();
+			SleepDecoder(seen);
+			guard.lock();
+			continue;
+		}
+
+		// Either this sees the consumer's latest read position or the
+		// consumer sees this flag and wakes us once we're waiting, as both
+		// sides store before loading the other's variable
+		wants_space = true;
+		const int64_t space = std::min(capacity, read_pos.load() + capacity - pos);
+		const int64_t count = std::min({chunk, space, end - pos});
+		if (count <= 0 || (count < chunk && space < chunk)) {
+			guard.unlock();
+			SleepDecoder(seen);
+			guard.lock();
+			continue;
+		}
+		wants_space.store(false, std::memory_order_relaxed);
+		const double vol = volume;
+
+		// Decode straight into the ring without holding the lock, which the
+		// consumer won't read from until write_pos has been moved past it
+		guard.unlock();
+		for (int64_t done = 0; done < count; ) {
+			const int64_t offset = (pos + done) % capacity;
+			const int64_t n = std::min(count - done, capacity - offset);
+			char *dst = &ring[offset * frame_size];
+			if (mono16)
+				provider.GetInt16MonoAudioWithVolume(reinterpret_cast<int16_t *>(dst), pos + done, n, vol);
+			else
+				provider.GetAudioWithVolume(dst, pos + done, n, vol);
+			done += n;
+		}
+		guard.lock();
+
+		// If there was a seek while decoding the audio is discarded
+		if (seek_epoch != epoch) continue;
+		pos += count;
+		write_pos.store(pos, std::memory_order_release);
+		data_ready.notify_all();
+	}
+}
+
+int64_t AudioReadAhead::Available() const {
+	if (ack_epoch.load(std::memory_order_acquire) != consumer_epoch)
+		return 0;
+	// Negative if the consumer has skipped past the decoded audio
+	return std::max<int64_t>(0, write_pos.load(std::memory_order_acquire) - read_pos.load(std::memory_order_relaxed));
+}
+
+void AudioReadAhead::SetEnd(int64_t end) {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		this->end = end;
+	}
+	WakeDecoder();
+}
+
+void AudioReadAhead::Seek(int64_t start) {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		consumer_epoch = ++seek_epoch;
+		seek_target = start;
+		read_pos.store(start, std::memory_order_release);
+	}
+	WakeDecoder();
+}
+
+int64_t AudioReadAhead::Peek(const void **data) const {
+	const int64_t pos = read_pos.load(std::memory_order_relaxed);
+	const int64_t offset = pos % capacity;
+	*data = &ring[offset * frame_size];
+	return std::min(Available(), capacity - offset);
+}
+
+void AudioReadAhead::Consume(int64_t count) {
+	Skip(std::min(count, Available()));
+}
+
+void AudioReadAhead::Skip(int64_t count) {
+	if (count <= 0) return;
+	read_pos.store(read_pos.load(std::memory_order_relaxed) + count);
+
+	// The decoder read wake_count before setting the flag, so waking it here
+	// can't be missed. Clearing the flag keeps later reads from making more
+	// syscalls until the decoder has looked at the read position again.
+	if (wants_space.exchange(false))
+		WakeDecoder();
+}
+
+int64_t AudioReadAhead::Read(void *dst, int64_t count) {
+	auto out = static_cast<char *>(dst);
+	int64_t total = 0;
+	const void *data;
+	while (total < count) {
+		const int64_t n = std::min(count - total, Peek(&data));
+		if (n <= 0) break;
+		memcpy(out, data, n * frame_size);
+		Consume(n);
+		out += n * frame_size;
+		total += n;
+	}
+	return total;
+}
+
+int64_t AudioReadAhead::Wait(int64_t count, std::chrono::milliseconds timeout) {
+	count = std::min({count, capacity, end - read_pos});
+	std::unique_lock<std::mutex> guard(lock);
+	data_ready.wait_for(guard, timeout, [&] { return closing || Available() >= count; });
+	return Available();
+}
+}
@@ -0,0 +1,312 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file sample_codec.cpp
+/// @brief Lossless compression of blocks of PCM samples
+/// @ingroup libaegisub
+
+#include "sample_codec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+/// Number of residuals sharing a Rice parameter
+const size_t partition_size = 4096;
+/// Quotients this large are written as an escape code followed by the
+/// residual in full
+const int escape_quotient = 32;
+
+enum BlockType : uint8_t {
+	Block_Raw = 0,
+	Block_Rice = 1
+};
+
+inline uint64_t mask(int bits) {
+	return bits >= 64 ? ~0ULL : (1ULL << bits) - 1;
+}
+
+inline int CountTrailingZeros(uint64_t v) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, v);
+	return (int)index;
+#else
+	return __builtin_ctzll(v);
+#endif
+}
+
+/// Bitstream writer, least significant bit first
+class BitWriter {
+	std::vector<uint8_t>& out;
+	uint64_t acc = 0;
+	int fill = 0;
+
+public:
+	BitWriter(std::vector<uint8_t>& out) : out(out) { }
+
+	void Write(uint64_t bits, int count) {
+		if (count > 32) {
+			Write(bits, 32);
+			Write(bits >> 32, count - 32);
+			return;
+		}
+		acc |= (bits & mask(count)) << fill;
+		fill += count;
+		if (fill >= 32) {
+			size_t pos = out.size();
+			out.resize(pos + 4);
+			for (int i = 0; i < 4; ++i)
+				out[pos + i] = static_cast<uint8_t>(acc >> (i * 8));
+			acc >>= 32;
+			fill -= 32;
+		}
+	}
+
+	void Flush() {
+		for (; fill > 0; fill -= 8) {
+			out.push_back(static_cast<uint8_t>(acc));
+			acc >>= 8;
+		}
+		acc = 0;
+		fill = 0;
+	}
+};
+
+/// Bitstream reader matching BitWriter. Reads past the end return zeros.
+class BitReader {
+	const uint8_t *pos;
+	const uint8_t *end;
+	uint64_t acc = 0;
+	int fill = 0;
+
+	void Refill() {
+		while (fill <= 56) {
+			acc |= static_cast<uint64_t>(pos < end ? *pos++ : 0) << fill;
+			fill += 8;
+		}
+	}
+
+public:
+	BitReader(const uint8_t *data, size_t size) : pos(data), end(data + size) { }
+
+	uint64_t Read(int count) {
+		if (count > 32) {
+			uint64_t low = Read(32);
+			return low | (Read(count - 32) << 32);
+		}
+		if (fill < count) Refill();
+		uint64_t value = acc & mask(count);
+		acc >>= count;
+		fill -= count;
+		return value;
+	}
+
+	/// Read a unary-coded value, or escape_quotient for an escape code
+	int ReadUnary() {
+		Refill();
+		int zeros = acc ? CountTrailingZeros(acc) : 64;
+		if (zeros >= escape_quotient) {
+			acc >>= escape_quotient;
+			fill -= escape_quotient;
+			return escape_quotient;
+		}
+		acc >>= zeros + 1;
+		fill -= zeros + 1;
+		return zeros;
+	}
+};
+
+/// Reads and writes the samples of one channel as unsigned integers which
+/// order the same way as the sample values
+struct SampleFormat {
+	const int bytes;
+	const int bits;
+	const int stride;
+	const bool is_float;
+
+	SampleFormat(int channels, int bytes_per_sample, bool float_samples)
+	: bytes(bytes_per_sample)
+	, bits(bytes_per_sample * 8)
+	, stride(channels * bytes_per_sample)
+	, is_float(float_samples)
+	{
+	}
+
+	uint64_t Load(const char *src) const {
+		uint64_t v = 0;
+		memcpy(&v, src, bytes);
+		// Negative floats count down from the sign bit, so map them below
+		// zero with their magnitude reversed. This is a bijection, and keeps
+		// -0 and +0 apart.
+		if (is_float && (v >> (bits - 1)))
+			v = ~(v & mask(bits - 1));
+		return v & mask(bits);
+	}
+
+	void Store(uint64_t v, char *dst) const {
+		v &= mask(bits);
+		if (is_float && (v >> (bits - 1)))
+			v = (~v & mask(bits - 1)) | (1ULL << (bits - 1));
+		memcpy(dst, &v, bytes);
+	}
+
+	/// Sign-extend a value of this width
+	int64_t Signed(uint64_t v) const {
+		return static_cast<int64_t>(v << (64 - bits)) >> (64 - bits);
+	}
+};
+
+inline uint64_t Predict(int order, uint64_t prev1, uint64_t prev2) {
+	switch (order) {
+		case 1: return prev1;
+		case 2: return 2 * prev1 - prev2;
+		default: return 0;
+	}
+}
+
+inline uint64_t ZigZag(int64_t v) {
+	return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+inline int64_t UnZigZag(uint64_t v) {
+	return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+/// Choose the predictor order giving the smallest residuals for a channel
+int ChooseOrder(SampleFormat const& fmt, const char *src, size_t frames) {
+	// Summed as doubles since a block of 64-bit residuals would overflow
+	double cost[3] = {0, 0, 0};
+	uint64_t prev1 = 0, prev2 = 0;
+	for (size_t i = 0; i < frames; ++i, src += fmt.stride) {
+		uint64_t x = fmt.Load(src);
+		for (int order = 0; order < 3; ++order)
+			cost[order] += std::abs(static_cast<double>(fmt.Signed(x - Predict(order, prev1, prev2))));
+		prev2 = prev1;
+		prev1 = x;
+	}
+	return static_cast<int>(std::min_element(cost, cost + 3) - cost);
+}
+
+void CompressChannel(SampleFormat const& fmt, const char *src, size_t frames, BitWriter& out, std::vector<uint64_t>& residuals) {
+	const int order = ChooseOrder(fmt, src, frames);
+	out.Write(order, 2);
+
+	residuals.resize(frames);
+	uint64_t prev1 = 0, prev2 = 0;
+	for (size_t i = 0; i < frames; ++i, src += fmt.stride) {
+		uint64_t x = fmt.Load(src);
+		residuals[i] = ZigZag(fmt.Signed(x - Predict(order, prev1, prev2)));
+		prev2 = prev1;
+		prev1 = x;
+	}
+
+	for (size_t start = 0; start < frames; start += partition_size) {
+		const size_t count = std::min(partition_size, frames - start);
+		const uint64_t *r = &residuals[start];
+
+		// Pick the parameter from the mean residual, as FLAC does
+		double sum = 0;
+		for (size_t i = 0; i < count; ++i)
+			sum += static_cast<double>(r[i]);
+		const double mean = sum / count;
+		int k = 0;
+		while (k < fmt.bits - 1 && std::ldexp(1.0, k + 1) <= mean)
+			++k;
+		out.Write(k, 7);
+
+		for (size_t i = 0; i < count; ++i) {
+			uint64_t q = r[i] >> k;
+			if (q + 1 + k <= 32)
+				out.Write(((r[i] & mask(k)) << (q + 1)) | (1ULL << q), (int)q + 1 + k);
+			else if (q < escape_quotient) {
+				out.Write(1ULL << q, (int)q + 1);
+				out.Write(r[i], k);
+			}
+			else {
+				out.Write(0, escape_quotient);
+				out.Write(r[i], fmt.bits);
+			}
+		}
+	}
+}
+
+void DecompressChannel(SampleFormat const& fmt, BitReader& in, char *dst, size_t frames) {
+	const int order = static_cast<int>(in.Read(2));
+
+	uint64_t prev1 = 0, prev2 = 0;
+	for (size_t start = 0; start < frames; start += partition_size) {
+		const size_t count = std::min(partition_size, frames - start);
+		const int k = static_cast<int>(in.Read(7));
+
+		for (size_t i = 0; i < count; ++i, dst += fmt.stride) {
+			uint64_t r;
+			int q = in.ReadUnary();
+			if (q < escape_quotient)
+				r = (static_cast<uint64_t>(q) << k) | in.Read(k);
+			else
+				r = in.Read(fmt.bits);
+
+			uint64_t x = (Predict(order, prev1, prev2) + UnZigZag(r)) & mask(fmt.bits);
+			fmt.Store(x, dst);
+			prev2 = prev1;
+			prev1 = x;
+		}
+	}
+}
+}
+
+namespace agi { namespace audio {
+void CompressSamples(const void *src, size_t frames, int channels, int bytes_per_sample, bool float_samples, std::vector<uint8_t>& out) {
+	const size_t raw_size = frames * channels * bytes_per_sample;
+	out.clear();
+	out.reserve(raw_size / 2);
+	out.push_back(Block_Rice);
+
+	SampleFormat fmt(channels, bytes_per_sample, float_samples);
+	BitWriter writer(out);
+	std::vector<uint64_t> residuals;
+	for (int c = 0; c < channels; ++c)
+		CompressChannel(fmt, static_cast<const char *>(src) + c * bytes_per_sample, frames, writer, residuals);
+	writer.Flush();
+
+	if (out.size() > raw_size) {
+		out.resize(raw_size + 1);
+		out[0] = Block_Raw;
+		memcpy(&out[1], src, raw_size);
+	}
+	out.shrink_to_fit();
+}
+
+void DecompressSamples(const uint8_t *src, size_t size, void *dst, size_t frames, int channels, int bytes_per_sample, bool float_samples) {
+	if (!size) return;
+
+	if (src[0] == Block_Raw) {
+		memcpy(dst, src + 1, std::min(size - 1, frames * channels * bytes_per_sample));
+		return;
+	}
+
+	SampleFormat fmt(channels, bytes_per_sample, float_samples);
+	BitReader reader(src + 1, size - 1);
+	for (int c = 0; c < channels; ++c)
+		DecompressChannel(fmt, reader, static_cast<char *>(dst) + c * bytes_per_sample, frames);
+}
+} }
@@ -0,0 +1,51 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file sample_codec.h
+/// @brief Lossless compression of blocks of PCM samples
+/// @ingroup libaegisub
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace agi { namespace audio {
+/// Losslessly compress a block of interleaved samples
+/// @param src Source samples
+/// @param frames Number of frames in src
+/// @param channels Number of channels in src
+/// @param bytes_per_sample Size of each sample
+/// @param float_samples Are the samples floating point?
+/// @param[out] out Compressed data, replacing whatever was there
+///
+/// Each channel is run through a fixed linear predictor of order zero to
+/// two, whichever fits the block best, and the residuals are Rice coded
+/// FLAC-style. Float samples are predicted from their bit patterns mapped
+/// to integers which order the same way as the values. Blocks which do not
+/// compress are stored as is, so the output is at most one byte larger
+/// than the input.
+void CompressSamples(const void *src, size_t frames, int channels, int bytes_per_sample, bool float_samples, std::vector<uint8_t>& out);
+
+/// Decompress a block compressed with CompressSamples
+/// @param src Compressed data
+/// @param size Size of the compressed data
+/// @param dst Destination buffer, which must hold frames frames
+///
+/// The remaining parameters must be the same as the ones passed to CompressSamples.
+void DecompressSamples(const uint8_t *src, size_t size, void *dst, size_t frames, int channels, int bytes_per_sample, bool float_samples);
+} }
@@ -0,0 +1,359 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file sample_convert.cpp
+/// @brief Sample format conversion kernels used by AudioProvider
+/// @ingroup libaegisub
+
+#include "sample_convert.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AGI_AUDIO_SSE2
+#include <emmintrin.h>
+
+// AVX2 kernels are compiled for every x86 target and only used if the CPU
+// running them supports it
+#if defined(_MSC_VER)
+#define AGI_AUDIO_AVX2
+#define AGI_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#elif defined(__GNUC__)
+#define AGI_AUDIO_AVX2
+#define AGI_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+#endif
+
+namespace {
+using namespace agi::audio;
+
+// Scalar reference implementations, also used for the tails of the vector
+// versions and on non-x86 platforms
+
+void uint8_to_int16(const uint8_t *src, int16_t *dst, size_t count) {
+	for (size_t i = 0; i < count; ++i)
+		dst[i] = static_cast<int16_t>((src[i] - 128) * 256);
+}
+
+void int32_to_int16(const int32_t *src, int16_t *dst, size_t count) {
+	for (size_t i = 0; i < count; ++i)
+		dst[i] = static_cast<int16_t>(src[i] >> 16);
+}
+
+// Generic integer path: take the two most significant bytes of each
+// little-endian sample
+void int_to_int16(const char *src, int16_t *dst, size_t count, int bytes_per_sample) {
+	src += bytes_per_sample - sizeof(int16_t);
+	for (size_t i = 0; i < count; ++i, src += bytes_per_sample)
+		memcpy(&dst[i], src, sizeof(int16_t));
+}
+
+template<typename Float>
+void float_to_int16(const Float *src, int16_t *dst, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		Float expanded = src[i] * 32768;
+		dst[i] = expanded < -32768 ? -32768 :
+			expanded > 32767 ? 32767 :
+			static_cast<int16_t>(expanded);
+	}
+}
+
+void downmix_scalar(const int16_t *src, int16_t *dst, size_t frames, int channels) {
+	for (size_t i = 0; i < frames; ++i, src += channels) {
+		int sum = 0;
+		for (int c = 0; c < channels; ++c)
+			sum += src[c];
+		dst[i] = static_cast<int16_t>(sum / channels);
+	}
+}
+
+#ifdef AGI_AUDIO_SSE2
+void uint8_to_int16_sse2(const uint8_t *src, int16_t *dst, size_t count) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bias = _mm_set1_epi16(-0x8000);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		// Interleaving with zero bytes below shifts each sample into the high
+		// byte, and flipping the sign bit removes the bias
+		__m128i lo = _mm_xor_si128(_mm_unpacklo_epi8(zero, v), bias);
+		__m128i hi = _mm_xor_si128(_mm_unpackhi_epi8(zero, v), bias);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), lo);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 8), hi);
+	}
+	uint8_to_int16(src + i, dst + i, count - i);
+}
+
+void int32_to_int16_sse2(const int32_t *src, int16_t *dst, size_t count) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i a = _mm_srai_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), 16);
+		__m128i b = _mm_srai_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 4)), 16);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(a, b));
+	}
+	int32_to_int16(src + i, dst + i, count - i);
+}
+
+// Clamping before the truncating conversion gives the same result as the
+// scalar version, as everything outside of [-32768, 32767] saturates
+void float_to_int16_sse2(const float *src, int16_t *dst, size_t count) {
+	const __m128 scale = _mm_set1_ps(32768.f);
+	const __m128 lo = _mm_set1_ps(-32768.f);
+	const __m128 hi = _mm_set1_ps(32767.f);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+		a = _mm_min_ps(_mm_max_ps(a, lo), hi);
+		b = _mm_min_ps(_mm_max_ps(b, lo), hi);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+			_mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)));
+	}
+	float_to_int16(src + i, dst + i, count - i);
+}
+
+void double_to_int16_sse2(const double *src, int16_t *dst, size_t count) {
+	const __m128d scale = _mm_set1_pd(32768.);
+	const __m128d lo = _mm_set1_pd(-32768.);
+	const __m128d hi = _mm_set1_pd(32767.);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i out[4];
+		for (int j = 0; j < 4; ++j) {
+			__m128d v = _mm_mul_pd(_mm_loadu_pd(src + i + j * 2), scale);
+			out[j] = _mm_cvttpd_epi32(_mm_min_pd(_mm_max_pd(v, lo), hi));
+		}
+		__m128i a = _mm_unpacklo_epi64(out[0], out[1]);
+		__m128i b = _mm_unpacklo_epi64(out[2], out[3]);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(a, b));
+	}
+	float_to_int16(src + i, dst + i, count - i);
+}
+
+void downmix_stereo_sse2(const int16_t *src, int16_t *dst, size_t frames) {
+	const __m128i ones = _mm_set1_epi16(1);
+	size_t i = 0;
+	for (; i + 8 <= frames; i += 8) {
+		// madd of each left/right pair with 1 gives their 32 bit sums
+		__m128i a = _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2)), ones);
+		__m128i b = _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2 + 8)), ones);
+		// Halve, rounding towards zero by adding one to negative sums first
+		a = _mm_srai_epi32(_mm_add_epi32(a, _mm_srli_epi32(a, 31)), 1);
+		b = _mm_srai_epi32(_mm_add_epi32(b, _mm_srli_epi32(b, 31)), 1);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(a, b));
+	}
+	downmix_scalar(src + i * 2, dst + i, frames - i, 2);
+}
+
+// For other channel counts the sums are divided as floats. With at most 64
+// channels the sums are exactly representable and the quotient of a
+// non-multiple is always more than one ulp away from an integer, so the
+// truncated result matches integer division.
+void downmix_sse2(const int16_t *src, int16_t *dst, size_t frames, int channels) {
+	if (channels > 64)
+		return downmix_scalar(src, dst, frames, channels);
+
+	const __m128 divisor = _mm_set1_ps(static_cast<float>(channels));
+	alignas(16) int32_t sums[8];
+	size_t i = 0;
+	for (; i + 8 <= frames; i += 8) {
+		for (int j = 0; j < 8; ++j, src += channels) {
+			int sum = 0;
+			for (int c = 0; c < channels; ++c)
+				sum += src[c];
+			sums[j] = sum;
+		}
+		__m128 a = _mm_div_ps(_mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i *>(sums))), divisor);
+		__m128 b = _mm_div_ps(_mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i *>(sums + 4))), divisor);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+			_mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)));
+	}
+	downmix_scalar(src, dst + i, frames - i, channels);
+}
+#endif
+
+#ifdef AGI_AUDIO_AVX2
+// packs works within each 128 bit lane, so the 64 bit quarters have to be
+// put back in order afterwards
+AGI_TARGET_AVX2 void int32_to_int16_avx2(const int32_t *src, int16_t *dst, size_t count) {
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256i a = _mm256_srai_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i)), 16);
+		__m256i b = _mm256_srai_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 8)), 16);
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packed);
+	}
+	int32_to_int16(src + i, dst + i, count - i);
+}
+
+AGI_TARGET_AVX2 void float_to_int16_avx2(const float *src, int16_t *dst, size_t count) {
+	const __m256 scale = _mm256_set1_ps(32768.f);
+	const __m256 lo = _mm256_set1_ps(-32768.f);
+	const __m256 hi = _mm256_set1_ps(32767.f);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256 a = _mm256_mul_ps(_mm256_loadu_ps(src + i), scale);
+		__m256 b = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale);
+		a = _mm256_min_ps(_mm256_max_ps(a, lo), hi);
+		b = _mm256_min_ps(_mm256_max_ps(b, lo), hi);
+		__m256i packed = _mm256_packs_epi32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_permute4x64_epi64(packed, 0xD8));
+	}
+	float_to_int16(src + i, dst + i, count - i);
+}
+
+AGI_TARGET_AVX2 void double_to_int16_avx2(const double *src, int16_t *dst, size_t count) {
+	const __m256d scale = _mm256_set1_pd(32768.);
+	const __m256d lo = _mm256_set1_pd(-32768.);
+	const __m256d hi = _mm256_set1_pd(32767.);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256d a = _mm256_mul_pd(_mm256_loadu_pd(src + i), scale);
+		__m256d b = _mm256_mul_pd(_mm256_loadu_pd(src + i + 4), scale);
+		__m128i ia = _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(a, lo), hi));
+		__m128i ib = _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(b, lo), hi));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(ia, ib));
+	}
+	float_to_int16(src + i, dst + i, count - i);
+}
+
+AGI_TARGET_AVX2 void downmix_stereo_avx2(const int16_t *src, int16_t *dst, size_t frames) {
+	const __m256i ones = _mm256_set1_epi16(1);
+	size_t i = 0;
+	for (; i + 16 <= frames; i += 16) {
+		__m256i a = _mm256_madd_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 2)), ones);
+		__m256i b = _mm256_madd_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 2 + 16)), ones);
+		a = _mm256_srai_epi32(_mm256_add_epi32(a, _mm256_srli_epi32(a, 31)), 1);
+		b = _mm256_srai_epi32(_mm256_add_epi32(b, _mm256_srli_epi32(b, 31)), 1);
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packed);
+	}
+	downmix_scalar(src + i * 2, dst + i, frames - i, 2);
+}
+
+bool cpu_has_avx2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	// The OS has to save the AVX registers as well
+	if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+/// The best available implementation of each kernel for this CPU
+struct Kernels {
+	void (*uint8_to_int16)(const uint8_t *, int16_t *, size_t) = ::uint8_to_int16;
+	void (*int32_to_int16)(const int32_t *, int16_t *, size_t) = ::int32_to_int16;
+	void (*float_to_int16)(const float *, int16_t *, size_t) = ::float_to_int16<float>;
+	void (*double_to_int16)(const double *, int16_t *, size_t) = ::float_to_int16<double>;
+	void (*downmix_stereo)(const int16_t *, int16_t *, size_t) = [](const int16_t *src, int16_t *dst, size_t frames) {
+		downmix_scalar(src, dst, frames, 2);
+	};
+	void (*downmix)(const int16_t *, int16_t *, size_t, int) = downmix_scalar;
+
+	Kernels() {
+#ifdef AGI_AUDIO_SSE2
+		uint8_to_int16 = uint8_to_int16_sse2;
+		int32_to_int16 = int32_to_int16_sse2;
+		float_to_int16 = float_to_int16_sse2;
+		double_to_int16 = double_to_int16_sse2;
+		downmix_stereo = downmix_stereo_sse2;
+		downmix = downmix_sse2;
+#endif
+#ifdef AGI_AUDIO_AVX2
+		if (cpu_has_avx2()) {
+			int32_to_int16 = int32_to_int16_avx2;
+			float_to_int16 = float_to_int16_avx2;
+			double_to_int16 = double_to_int16_avx2;
+			downmix_stereo = downmix_stereo_avx2;
+		}
+#endif
+	}
+};
+
+Kernels const& kernels() {
+	static const Kernels k;
+	return k;
+}
+}
+
+namespace agi { namespace audio {
+void ConvertToInt16(const void *src, int16_t *dst, size_t count, int bytes_per_sample, bool float_samples) {
+	auto const& k = kernels();
+	if (float_samples) {
+		if (bytes_per_sample == sizeof(float))
+			k.float_to_int16(static_cast<const float *>(src), dst, count);
+		else if (bytes_per_sample == sizeof(double))
+			k.double_to_int16(static_cast<const double *>(src), dst, count);
+	}
+	else if (bytes_per_sample == sizeof(int16_t))
+		memcpy(dst, src, count * sizeof(int16_t));
+	else if (bytes_per_sample == sizeof(uint8_t))
+		k.uint8_to_int16(static_cast<const uint8_t *>(src), dst, count);
+	else if (bytes_per_sample == sizeof(int32_t))
+		k.int32_to_int16(static_cast<const int32_t *>(src), dst, count);
+	else
+		int_to_int16(static_cast<const char *>(src), dst, count, bytes_per_sample);
+}
+
+void DownmixToMono(const int16_t *src, int16_t *dst, size_t frames, int channels) {
+	auto const& k = kernels();
+	if (channels == 1)
+		memcpy(dst, src, frames * sizeof(int16_t));
+	else if (channels == 2)
+		k.downmix_stereo(src, dst, frames);
+	else
+		k.downmix(src, dst, frames, channels);
+}
+
+struct ScratchBuffer::Slot {
+	std::vector<char> data;
+	bool in_use = false;
+};
+
+ScratchBuffer::ScratchBuffer(size_t size) {
+	static thread_local std::array<Slot, slots> arena;
+	for (auto& s : arena) {
+		if (s.in_use) continue;
+		slot = &s;
+		s.in_use = true;
+		if (s.data.size() < size)
+			s.data.resize(size);
+		data = s.data.data();
+		return;
+	}
+
+	fallback.resize(size);
+	data = fallback.data();
+}
+
+ScratchBuffer::~ScratchBuffer() {
+	if (slot)
+		slot->in_use = false;
+}
+} }
@@ -0,0 +1,76 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file sample_convert.h
+/// @brief Sample format conversion kernels used by AudioProvider
+/// @ingroup libaegisub
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace agi { namespace audio {
+/// Convert samples to 16 bit, leaving channels interleaved
+/// @param src Source samples
+/// @param dst Destination buffer, which must hold count samples
+/// @param count Number of samples (not frames) to convert
+/// @param bytes_per_sample Size of each source sample
+/// @param float_samples Are the source samples floating point?
+///
+/// 8 bit samples are assumed to be unsigned with a bias of 128, other integer
+/// formats are signed and truncated to their most significant 16 bits, and
+/// floating point samples are scaled from [-1, 1] and clamped.
+void ConvertToInt16(const void *src, int16_t *dst, size_t count, int bytes_per_sample, bool float_samples);
+
+/// Average interleaved 16 bit channels into a single channel
+/// @param src Interleaved source samples
+/// @param dst Destination buffer, which must hold frames samples
+/// @param frames Number of frames to downmix
+/// @param channels Number of channels in src
+///
+/// Rounds towards zero, like integer division of the sum would.
+void DownmixToMono(const int16_t *src, int16_t *dst, size_t frames, int channels);
+
+/// @class ScratchBuffer
+/// @brief Temporary buffer backed by a small per-thread arena
+///
+/// Each thread keeps a few buffers around which are handed out in turn and
+/// grow to the largest size requested of them, so that repeated conversions
+/// do not touch the heap. If all of them are currently in use (i.e. a
+/// conversion was nested inside another one on the same thread), a
+/// separate allocation is made instead.
+class ScratchBuffer {
+	struct Slot;
+	Slot *slot = nullptr;
+	std::vector<char> fallback;
+	char *data;
+
+	ScratchBuffer(ScratchBuffer const&) = delete;
+	ScratchBuffer& operator=(ScratchBuffer const&) = delete;
+
+public:
+	/// Number of buffers kept per thread
+	static const size_t slots = 4;
+
+	ScratchBuffer(size_t size);
+	~ScratchBuffer();
+
+	template<typename T>
+	T *get() const { return reinterpret_cast<T *>(data); }
+};
+} }
@@ -0,0 +1,240 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file buffer_pool.cpp
+/// @brief Recycling of large, frequently reallocated buffers
+/// @ingroup libaegisub
+
+#include <libaegisub/buffer_pool.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+/// Requests up to this size are rounded to a multiple of the alignment
+const size_t small_size = 4096;
+/// Number of size classes between consecutive powers of two, which bounds
+/// the wasted space at 1/8 of the block
+const size_t classes_per_octave = 8;
+
+uint8_t *allocate_block(size_t size) {
+	const size_t align = agi::buffer_pool::alignment;
+	void *raw = std::malloc(size + align + sizeof(void *));
+	if (!raw) throw std::bad_alloc();
+
+	auto addr = reinterpret_cast<uintptr_t>(raw) + sizeof(void *) + align - 1;
+	auto block = reinterpret_cast<uint8_t *>(addr & ~uintptr_t(align - 1));
+	reinterpret_cast<void **>(block)[-1] = raw;
+	return block;
+}
+
+void free_block(uint8_t *block) {
+	std::free(reinterpret_cast<void **>(block)[-1]);
+}
+}
+
+namespace agi {
+namespace detail {
+struct buffer_pool_state {
+	std::mutex lock;
+	/// Unused blocks by size class
+	std::map<size_t, std::vector<uint8_t *>> free;
+	size_t retained = 0;
+	const size_t max_retained;
+
+	buffer_pool_state(size_t max_retained) : max_retained(max_retained) { }
+
+	~buffer_pool_state() {
+		trim();
+	}
+
+	void trim() {
+		for (auto& size_class : free) {
+			for (auto block : size_class.second)
+				free_block(block);
+		}
+		free.clear();
+		retained = 0;
+	}
+
+	/// Get a block of exactly the given size class
+	uint8_t *acquire(size_t size) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			auto it = free.find(size);
+			if (it != free.end() && !it->second.empty()) {
+				auto block = it->second.back();
+				it->second.pop_back();
+				retained -= size;
+				return block;
+			}
+		}
+		return allocate_block(size);
+	}
+
+	void release(uint8_t *block, size_t size) {
+		std::unique_lock<std::mutex> guard(lock);
+
+		// Blocks of other sizes are most likely left over from something no
+		// longer in use, so discard those before the one being returned
+		std::vector<uint8_t *> to_free;
+		for (auto it = free.begin(); it != free.end() && retained + size > max_retained; ) {
+			if (it->first == size) {
+				++it;
+				continue;
+			}
+			while (!it->second.empty() && retained + size > max_retained) {
+				to_free.push_back(it->second.back());
+				it->second.pop_back();
+				retained -= it->first;
+			}
+			if (it->second.empty())
+				it = free.erase(it);
+			else
+				++it;
+		}
+
+		if (retained + size <= max_retained) {
+			free[size].push_back(block);
+			retained += size;
+		}
+		else
+			to_free.push_back(block);
+
+		guard.unlock();
+		for (auto b : to_free)
+			free_block(b);
+	}
+};
+}
+
+const size_t buffer_pool::alignment;
+
+buffer_pool::buffer_pool(size_t max_retained)
+: state(std::make_shared<detail::buffer_pool_state>(max_retained))
+{
+}
+
+size_t buffer_pool::size_class(size_t size) {
+	if (size <= small_size)
+		return std::max<size_t>(alignment, (size + alignment - 1) & ~(alignment - 1));
+
+	size_t octave = small_size;
+	while (octave * 2 <= size)
+		octave *= 2;
+	const size_t step = octave / classes_per_octave;
+	return (size + step - 1) / step * step;
+}
+
+size_t buffer_pool::retained() const {
+	std::lock_guard<std::mutex> guard(state->lock);
+	return state->retained;
+}
+
+void buffer_pool::trim() {
+	std::lock_guard<std::mutex> guard(state->lock);
+	state->trim();
+}
+
+pooled_buffer::pooled_buffer(buffer_pool const& pool)
+: pool(pool.state)
+{
+}
+
+pooled_buffer::pooled_buffer(pooled_buffer const& other)
+: pool(other.pool)
+{
+	*this = other;
+}
+
+pooled_buffer::pooled_buffer(pooled_buffer&& other) noexcept
+: pool(other.pool)
+, ptr(other.ptr)
+, len(other.len)
+, cap(other.cap)
+{
+	other.ptr = nullptr;
+	other.len = other.cap = 0;
+}
+
+pooled_buffer& pooled_buffer::operator=(pooled_buffer const& other) {
+	if (this != &other)
+		assign(other.ptr, other.ptr + other.len);
+	return *this;
+}
+
+pooled_buffer& pooled_buffer::operator=(pooled_buffer&& other) noexcept {
+	if (this == &other) return *this;
+	release();
+	// The block has to go back to the pool it came from
+	pool = other.pool;
+	ptr = other.ptr;
+	len = other.len;
+	cap = other.cap;
+	other.ptr = nullptr;
+	other.len = other.cap = 0;
+	return *this;
+}
+
+pooled_buffer::~pooled_buffer() {
+	release();
+}
+
+void pooled_buffer::release() {
+	if (ptr)
+		pool->release(ptr, cap);
+	ptr = nullptr;
+	len = cap = 0;
+}
+
+void pooled_buffer::resize(size_t size) {
+	if (size > cap) {
+		const size_t new_cap = buffer_pool::size_class(size);
+		uint8_t *block = pool->acquire(new_cap);
+		if (len)
+			memcpy(block, ptr, len);
+		const size_t old_len = len;
+		release();
+		ptr = block;
+		cap = new_cap;
+		len = old_len;
+	}
+	len = size;
+}
+
+void pooled_buffer::assign(const uint8_t *first, const uint8_t *last) {
+	const size_t size = last - first;
+	if (size > cap) {
+		const size_t new_cap = buffer_pool::size_class(size);
+		uint8_t *block = pool->acquire(new_cap);
+		release();
+		ptr = block;
+		cap = new_cap;
+	}
+	if (size)
+		memcpy(ptr, first, size);
+	len = size;
+}
+
+void pooled_buffer::clear() {
+	release();
+}
+}
@@ -18,10 +18,12 @@
 
 #include "libaegisub/util.h"
 
+#include <algorithm>
 #include <atomic>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/strand.hpp>
 #include <condition_variable>
+#include <exception>
 #include <mutex>
 #include <thread>
 
@@ -52,6 +54,46 @@ namespace {
 		SerialQueue() : strand(*service) { }
 	};
 
+	/// State of a ParallelFor. This is shared with the tasks on the background
+	/// queue as some of them may not get to run until after the loop is done.
+	struct ParallelLoop {
+		std::function<void (size_t)> fn;
+		size_t count;
+
+		std::atomic<size_t> next{0};
+		/// Lowest index whose call threw, or count if none have
+		std::atomic<size_t> first_error;
+		std::mutex lock;
+		std::condition_variable all_done;
+		size_t done = 0;
+		std::exception_ptr error;
+
+		ParallelLoop(std::function<void (size_t)> fn, size_t count)
+		: fn(std::move(fn)), count(count), first_error(count) { }
+
+		/// Run iterations until there aren't any left to claim
+		void Work() {
+			for (size_t i; (i = next++) < count; ) {
+				if (i < first_error) {
+					try {
+						fn(i);
+					}
+					catch (...) {
+						std::lock_guard<std::mutex> guard(lock);
+						if (i < first_error) {
+							first_error = i;
+							error = std::current_exception();
+						}
+					}
+				}
+
+				std::lock_guard<std::mutex> guard(lock);
+				if (++done == count)
+					all_done.notify_all();
+			}
+		}
+	};
+
 	struct IOServiceThreadPool {
 		boost::asio::io_service io_service;
 		std::unique_ptr<boost::asio::io_service::work> work;
@@ -137,4 +179,24 @@ std::unique_ptr<Queue> Create() {
 	return std::unique_ptr<Queue>(new SerialQueue);
 }
 
+void ParallelFor(size_t count, std::function<void (size_t)> fn) {
+	size_t helpers = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+	if (helpers <= 1) {
+		for (size_t i = 0; i < count; ++i)
+			fn(i);
+		return;
+	}
+
+	// This thread runs iterations as well rather than just waiting
+	auto loop = std::make_shared<ParallelLoop>(std::move(fn), count);
+	for (size_t i = 1; i < helpers; ++i)
+		Background().Async([=] { loop->Work(); });
+	loop->Work();
+
+	std::unique_lock<std::mutex> guard(loop->lock);
+	loop->all_done.wait(guard, [&] { return loop->done == loop->count; });
+	if (loop->error)
+		std::rethrow_exception(loop->error);
+}
+
 } }
@@ -0,0 +1,169 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+/// @file image_orientation.cpp
+/// @brief Rotating and mirroring 32-bit images
+/// @ingroup libaegisub
+
+#include "libaegisub/image_orientation.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AGI_ORIENTATION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+using agi::image_orientation;
+
+/// Width and height in pixels of the blocks which transposing works on, so
+/// that both the rows being read and the rows being written stay in cache
+const size_t tile_size = 32;
+
+uint32_t load_pixel(const uint8_t *row, size_t x) {
+	uint32_t px;
+	memcpy(&px, row + x * 4, 4);
+	return px;
+}
+
+void store_pixel(uint8_t *row, size_t x, uint32_t px) {
+	memcpy(row + x * 4, &px, 4);
+}
+
+void reverse_row(const uint8_t *src, uint8_t *dst, size_t width) {
+	size_t x = 0;
+#ifdef AGI_ORIENTATION_SSE2
+	for (; x + 4 <= width; x += 4) {
+		__m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + (width - x - 4) * 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), _mm_shuffle_epi32(px, _MM_SHUFFLE(0, 1, 2, 3)));
+	}
+#endif
+	for (; x < width; ++x)
+		store_pixel(dst, x, load_pixel(src, width - x - 1));
+}
+
+/// Copy one block of a transposed image pixel by pixel
+/// @param rows Source rows for each output column of the block, starting at x0
+void transpose_block_scalar(const uint8_t *const *rows, uint8_t *dst, size_t dst_pitch,
+                            size_t x0, size_t x1, size_t y0, size_t y1, size_t src_width, bool mirror_y)
+{
+	for (size_t y = y0; y < y1; ++y) {
+		size_t src_x = mirror_y ? src_width - y - 1 : y;
+		uint8_t *dst_row = dst + y * dst_pitch;
+		for (size_t x = x0; x < x1; ++x)
+			store_pixel(dst_row, x, load_pixel(rows[x - x0], src_x));
+	}
+}
+
+void copy_transposed(const uint8_t *src, size_t src_pitch, size_t width, size_t height,
+                     uint8_t *dst, size_t dst_pitch, image_orientation o)
+{
+	// The output is height pixels wide and width pixels tall, and output
+	// pixel (x, y) comes from input column y and row x, after mirroring
+	const size_t dst_width = height, dst_height = width;
+	const uint8_t *rows[tile_size];
+
+	for (size_t tx = 0; tx < dst_width; tx += tile_size) {
+		const size_t tx_end = std::min(dst_width, tx + tile_size);
+		for (size_t x = tx; x < tx_end; ++x)
+			rows[x - tx] = src + (o.mirror_x ? height - x - 1 : x) * src_pitch;
+
+		for (size_t ty = 0; ty < dst_height; ty += tile_size) {
+			const size_t ty_end = std::min(dst_height, ty + tile_size);
+			size_t x = tx, y = ty;
+
+#ifdef AGI_ORIENTATION_SSE2
+			// Transpose 4x4 pixel blocks in registers, then fill in the ragged
+			// right and bottom edges of the tile a pixel at a time
+			for (y = ty; y + 4 <= ty_end; y += 4) {
+				// Source columns for output rows y to y + 3
+				const size_t src_x = o.mirror_y ? width - y - 4 : y;
+				for (x = tx; x + 4 <= tx_end; x += 4) {
+					__m128i r[4];
+					for (int i = 0; i < 4; ++i) {
+						r[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[x - tx + i] + src_x * 4));
+						if (o.mirror_y)
+							r[i] = _mm_shuffle_epi32(r[i], _MM_SHUFFLE(0, 1, 2, 3));
+					}
+
+					__m128i t0 = _mm_unpacklo_epi32(r[0], r[1]);
+					__m128i t1 = _mm_unpacklo_epi32(r[2], r[3]);
+					__m128i t2 = _mm_unpackhi_epi32(r[0], r[1]);
+					__m128i t3 = _mm_unpackhi_epi32(r[2], r[3]);
+
+					uint8_t *out = dst + y * dst_pitch + x * 4;
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi64(t0, t1));
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(out + dst_pitch), _mm_unpackhi_epi64(t0, t1));
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(out + dst_pitch * 2), _mm_unpacklo_epi64(t2, t3));
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(out + dst_pitch * 3), _mm_unpackhi_epi64(t2, t3));
+				}
+				transpose_block_scalar(rows + (x - tx), dst, dst_pitch, x, tx_end, y, y + 4, width, o.mirror_y);
+			}
+			x = tx;
+#endif
+			transpose_block_scalar(rows, dst, dst_pitch, x, tx_end, y, ty_end, width, o.mirror_y);
+		}
+	}
+}
+}
+
+namespace agi {
+image_orientation image_orientation::rotation(int degrees) {
+	image_orientation o;
+	switch ((degrees % 360 + 360) % 360 / 90) {
+		case 1: o.transpose = true; o.mirror_y = true; break;
+		case 2: o.mirror_x = true; o.mirror_y = true; break;
+		case 3: o.transpose = true; o.mirror_x = true; break;
+		default: break;
+	}
+	return o;
+}
+
+image_orientation image_orientation::after_flip(bool horizontal, bool vertical) const {
+	// Mirroring the input's columns mirrors the output's rows if the image is
+	// being transposed, and vice versa
+	image_orientation o = *this;
+	o.mirror_x ^= transpose ? vertical : horizontal;
+	o.mirror_y ^= transpose ? horizontal : vertical;
+	return o;
+}
+
+void copy_oriented(const uint8_t *src, size_t src_pitch, size_t width, size_t height,
+                   uint8_t *dst, size_t dst_pitch, image_orientation orientation)
+{
+	if (!width || !height) return;
+
+	if (orientation.transpose)
+		return copy_transposed(src, src_pitch, width, height, dst, dst_pitch, orientation);
+
+	if (orientation.is_identity() && src_pitch == dst_pitch) {
+		memcpy(dst, src, src_pitch * (height - 1) + width * 4);
+		return;
+	}
+
+	for (size_t y = 0; y < height; ++y) {
+		const uint8_t *src_row = src + (orientation.mirror_y ? height - y - 1 : y) * src_pitch;
+		uint8_t *dst_row = dst + y * dst_pitch;
+		if (orientation.mirror_x)
+			reverse_row(src_row, dst_row, width);
+		else
+			memcpy(dst_row, src_row, width * 4);
+	}
+}
+}
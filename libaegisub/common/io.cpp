@@ -57,6 +57,7 @@ Save::Save(fs::path const& file, bool binary)
 }
 
 Save::~Save() noexcept(false) {
+	if (discarded) return;
 	fp.reset(); // Need to close before rename on Windows to unlock the file
 	for (int i = 0; i < 10; ++i) {
 		try {
@@ -72,5 +73,11 @@ Save::~Save() noexcept(false) {
 	}
 }
 
+void Save::Discard() {
+	discarded = true;
+	fp.reset();
+	fs::Remove(tmp_name);
+}
+
 	} // namespace io
 } // namespace agi
@@ -0,0 +1,65 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/prefix_matcher.h"
+
+namespace agi {
+PrefixMatcher::PrefixMatcher(std::vector<std::string> const& strings) {
+	columns.fill(0);
+	for (auto const& str : strings) {
+		for (char c : str) {
+			auto& column = columns[static_cast<uint8_t>(c)];
+			if (!column)
+				column = static_cast<uint16_t>(width++);
+		}
+	}
+
+	children.resize(width, 0);
+	matches.push_back(-1);
+	for (size_t i = 0; i < strings.size(); ++i) {
+		size_t node = 0;
+		for (char c : strings[i]) {
+			size_t slot = node * width + columns[static_cast<uint8_t>(c)];
+			if (!children[slot]) {
+				children[slot] = static_cast<uint32_t>(matches.size());
+				matches.push_back(-1);
+				children.resize(children.size() + width, 0);
+			}
+			node = children[slot];
+		}
+		if (matches[node] < 0)
+			matches[node] = static_cast<int>(i);
+	}
+}
+
+int PrefixMatcher::Find(const char *begin, const char *end) const {
+	int best = -1;
+	size_t node = 0;
+	for (;;) {
+		// A shorter match can still win if it came earlier in the list
+		int match = matches[node];
+		if (match >= 0 && (best < 0 || match < best))
+			best = match;
+
+		if (begin == end) break;
+		size_t column = columns[static_cast<uint8_t>(*begin++)];
+		if (!column) break;
+		node = children[node * width + column];
+		if (!node) break;
+	}
+	return best;
+}
+}
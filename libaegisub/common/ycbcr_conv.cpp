@@ -16,6 +16,17 @@
 
 #include "libaegisub/ycbcr_conv.h"
 
+#include "libaegisub/dispatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AGI_YCBCR_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace {
 double matrix_coefficients[][3] = {
 	{.299, .587, .114},    // BT.601
@@ -40,6 +51,105 @@ void col_mult(std::array<double, 9>& m, std::array<double, 3> v) {
 		m[6] * v[0], m[7] * v[1], m[8] * v[2],
 	}};
 }
+
+void from_ycbcr_matrix(agi::ycbcr_matrix mat, agi::ycbcr_range range, std::array<double, 9>& m, std::array<double, 3>& shift) {
+	auto coeff = matrix_coefficients[(int)mat];
+	double Kr = coeff[0];
+	double Kg = coeff[1];
+	double Kb = coeff[2];
+	m = {{
+		1,  0,             (1-Kr),
+		1, -(1-Kb)*Kb/Kg, -(1-Kr)*Kr/Kg,
+		1,  (1-Kb),        0,
+	}};
+
+	if (range == agi::ycbcr_range::pc) {
+		col_mult(m, {{1., 2., 2.}});
+		shift = {{0, -128., -128.}};
+	}
+	else {
+		col_mult(m, {{255./219., 255./112., 255./112.}});
+		shift = {{-16., -128., -128.}};
+	}
+}
+
+/// Fractional bits of the fixed-point conversion coefficients. The largest
+/// coefficient is a bit over 2, so this is as many as fit in an int16_t.
+const int coeff_bits = 13;
+
+typedef std::array<std::array<int16_t, 3>, 3> coeff_matrix;
+
+// Scalar version of the row conversion, also used for the tails of rows in
+// the vector version. Y, Cb and Cr are all full width here.
+void convert_row(coeff_matrix const& coeff, std::array<int32_t, 3> const& offset,
+                 const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+	auto channel = [&](int c, int x) -> uint8_t {
+		int32_t value = (coeff[c][0] * y[x] + coeff[c][1] * u[x] + coeff[c][2] * v[x] + offset[c]) >> coeff_bits;
+		return static_cast<uint8_t>(value < 0 ? 0 : value > 255 ? 255 : value);
+	};
+
+	for (int x = 0; x < width; ++x, dst += 4) {
+		dst[0] = channel(2, x);
+		dst[1] = channel(1, x);
+		dst[2] = channel(0, x);
+		dst[3] = 0;
+	}
+}
+
+#ifdef AGI_YCBCR_SSE2
+void convert_row_sse2(coeff_matrix const& coeff, std::array<int32_t, 3> const& offset,
+                      const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	// Y and Cb are interleaved so that one madd does both of their terms, and
+	// Cr is interleaved with zero for the third
+	__m128i yu_coeff[3], v_coeff[3], offsets[3];
+	for (int c = 0; c < 3; ++c) {
+		yu_coeff[c] = _mm_set1_epi32(static_cast<int32_t>(static_cast<uint16_t>(coeff[c][0]) | static_cast<uint32_t>(static_cast<uint16_t>(coeff[c][1])) << 16));
+		v_coeff[c] = _mm_set1_epi32(static_cast<uint16_t>(coeff[c][2]));
+		offsets[c] = _mm_set1_epi32(offset[c]);
+	}
+
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m128i y16 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(y + x)), zero);
+		__m128i u16 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + x)), zero);
+		__m128i v16 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + x)), zero);
+		__m128i yu_lo = _mm_unpacklo_epi16(y16, u16);
+		__m128i yu_hi = _mm_unpackhi_epi16(y16, u16);
+		__m128i v_lo = _mm_unpacklo_epi16(v16, zero);
+		__m128i v_hi = _mm_unpackhi_epi16(v16, zero);
+
+		// R, G and B, each as eight bytes with saturation to [0, 255]
+		__m128i rgb[3];
+		for (int c = 0; c < 3; ++c) {
+			__m128i lo = _mm_add_epi32(_mm_madd_epi16(yu_lo, yu_coeff[c]), _mm_madd_epi16(v_lo, v_coeff[c]));
+			__m128i hi = _mm_add_epi32(_mm_madd_epi16(yu_hi, yu_coeff[c]), _mm_madd_epi16(v_hi, v_coeff[c]));
+			lo = _mm_srai_epi32(_mm_add_epi32(lo, offsets[c]), coeff_bits);
+			hi = _mm_srai_epi32(_mm_add_epi32(hi, offsets[c]), coeff_bits);
+			__m128i words = _mm_packs_epi32(lo, hi);
+			rgb[c] = _mm_packus_epi16(words, words);
+		}
+
+		__m128i bg = _mm_unpacklo_epi8(rgb[2], rgb[1]);
+		__m128i ra = _mm_unpacklo_epi8(rgb[0], zero);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), _mm_unpacklo_epi16(bg, ra));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4 + 16), _mm_unpackhi_epi16(bg, ra));
+	}
+	convert_row(coeff, offset, y + x, u + x, v + x, dst + x * 4, width - x);
+}
+#endif
+
+/// Expand a row of subsampled chroma to full width
+void upsample_row(const uint8_t *src, uint8_t *dst, int width, int shift) {
+	for (int x = 0; x < width; ++x)
+		dst[x] = src[x >> shift];
+}
+
+/// Number of rows given to a thread at a time when converting in parallel
+const int rows_per_chunk = 32;
 }
 
 namespace agi {
@@ -65,24 +175,7 @@ void ycbcr_converter::init_src(ycbcr_matrix src_mat, ycbcr_range src_range) {
 }
 
 void ycbcr_converter::init_dst(ycbcr_matrix dst_mat, ycbcr_range dst_range) {
-	auto coeff = matrix_coefficients[(int)dst_mat];
-	double Kr = coeff[0];
-	double Kg = coeff[1];
-	double Kb = coeff[2];
-	from_ycbcr = {{
-		1,  0,             (1-Kr),
-		1, -(1-Kb)*Kb/Kg, -(1-Kr)*Kr/Kg,
-		1,  (1-Kb),        0,
-	}};
-
-	if (dst_range == ycbcr_range::pc) {
-		col_mult(from_ycbcr, {{1., 2., 2.}});
-		shift_from = {{0, -128., -128.}};
-	}
-	else {
-		col_mult(from_ycbcr, {{255./219., 255./112., 255./112.}});
-		shift_from = {{-16., -128., -128.}};
-	}
+	from_ycbcr_matrix(dst_mat, dst_range, from_ycbcr, shift_from);
 }
 
 ycbcr_converter::ycbcr_converter(ycbcr_matrix mat, ycbcr_range range) {
@@ -94,5 +187,78 @@ ycbcr_converter::ycbcr_converter(ycbcr_matrix src_mat, ycbcr_range src_range, yc
 	init_src(src_mat, src_range);
 	init_dst(dst_mat, dst_range);
 }
+
+ycbcr_to_bgra::ycbcr_to_bgra(ycbcr_matrix mat, ycbcr_range range) {
+	std::array<double, 9> m;
+	std::array<double, 3> shift;
+	from_ycbcr_matrix(mat, range, m, shift);
+
+	const double scale = 1 << coeff_bits;
+	for (int c = 0; c < 3; ++c) {
+		double total_shift = 0;
+		for (int i = 0; i < 3; ++i) {
+			coeff[c][i] = static_cast<int16_t>(std::lround(m[c * 3 + i] * scale));
+			total_shift += m[c * 3 + i] * shift[i];
+		}
+		// Add half so that the final shift rounds rather than truncates
+		offset[c] = static_cast<int32_t>(std::lround(total_shift * scale)) + (1 << (coeff_bits - 1));
+	}
+}
+
+void ycbcr_to_bgra::ConvertRows(ycbcr_image const& src, uint8_t *dst, size_t dst_pitch, int first, int last) const {
+	int h_shift = 0, v_shift = 0;
+	switch (src.subsampling) {
+		case ycbcr_subsampling::yuv420: h_shift = 1; v_shift = 1; break;
+		case ycbcr_subsampling::yuv422: h_shift = 1; break;
+		case ycbcr_subsampling::yuv411: h_shift = 2; break;
+		default: break;
+	}
+
+	const bool mono = src.subsampling == ycbcr_subsampling::mono;
+	std::vector<uint8_t> u_row, v_row;
+	if (mono) {
+		u_row.assign(src.width, 128);
+		v_row.assign(src.width, 128);
+	}
+	else if (h_shift) {
+		u_row.resize(src.width);
+		v_row.resize(src.width);
+	}
+
+	const uint8_t *u = u_row.data();
+	const uint8_t *v = v_row.data();
+	int upsampled_row = -1;
+	for (int row = first; row < last; ++row) {
+		if (!mono) {
+			int chroma_row = row >> v_shift;
+			const uint8_t *src_u = src.planes[1] + chroma_row * src.strides[1];
+			const uint8_t *src_v = src.planes[2] + chroma_row * src.strides[2];
+			if (!h_shift) {
+				u = src_u;
+				v = src_v;
+			}
+			// Vertically subsampled rows share chroma with their neighbours
+			else if (chroma_row != upsampled_row) {
+				upsample_row(src_u, &u_row[0], src.width, h_shift);
+				upsample_row(src_v, &v_row[0], src.width, h_shift);
+				upsampled_row = chroma_row;
+			}
+		}
+
+		const uint8_t *y = src.planes[0] + row * src.strides[0];
+#ifdef AGI_YCBCR_SSE2
+		convert_row_sse2(coeff, offset, y, u, v, dst + row * dst_pitch, src.width);
+#else
+		convert_row(coeff, offset, y, u, v, dst + row * dst_pitch, src.width);
+#endif
+	}
 }
 
+void ycbcr_to_bgra::Convert(ycbcr_image const& src, uint8_t *dst, size_t dst_pitch) const {
+	size_t chunks = (src.height + rows_per_chunk - 1) / rows_per_chunk;
+	dispatch::ParallelFor(chunks, [&](size_t chunk) {
+		int first = static_cast<int>(chunk) * rows_per_chunk;
+		ConvertRows(src, dst, dst_pitch, first, std::min(src.height, first + rows_per_chunk));
+	});
+}
+}
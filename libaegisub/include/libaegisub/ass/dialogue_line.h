@@ -0,0 +1,59 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file dialogue_line.h
+/// @brief Splitting Dialogue and Comment lines into their fields
+
+#pragma once
+
+#include <libaegisub/split.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace agi { namespace ass {
+/// The fields of a Dialogue or Comment line. The string fields refer to the
+/// parsed line and are only valid as long as it is.
+struct DialogueFields {
+	bool comment = false;
+	int layer = 0;
+	StringRange start;
+	StringRange end;
+	StringRange style;
+	StringRange actor;
+	/// Margins, already clamped to the valid range
+	std::array<int, 3> margin = std::array<int, 3>{{0, 0, 0}};
+	StringRange effect;
+	/// Text with any extradata block removed
+	StringRange text;
+	/// Was there an extradata block at the start of the text?
+	bool has_extradata = false;
+	std::vector<uint32_t> extradata_ids;
+};
+
+/// Split a line into its fields in a single pass without allocating (other
+/// than for the extradata ids, if there are any)
+///
+/// Only well-formed lines are handled. For anything else, such as a missing
+/// field or a number which doesn't fit, false is returned so that the caller
+/// can fall back to a parser which can report the problem.
+/// @param line Line to parse, including the Dialogue: or Comment: prefix
+/// @param[out] fields Fields of the line
+/// @return Was the line parsed?
+bool ParseDialogueFields(std::string const& line, DialogueFields& fields);
+} }
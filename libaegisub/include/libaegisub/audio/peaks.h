@@ -0,0 +1,113 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace agi {
+class AudioProvider;
+
+/// Summary of a run of 16-bit mono samples
+struct AudioPeak {
+	/// Smallest non-positive sample, or zero
+	int16_t min = 0;
+	/// Largest positive sample, or zero
+	int16_t max = 0;
+	/// Sum of all positive samples
+	int64_t pos_sum = 0;
+	/// Sum of all non-positive samples
+	int64_t neg_sum = 0;
+
+	void Add(int16_t sample) {
+		if (sample > 0) {
+			if (sample > max) max = sample;
+			pos_sum += sample;
+		}
+		else {
+			if (sample < min) min = sample;
+			neg_sum += sample;
+		}
+	}
+
+	void Add(AudioPeak const& other) {
+		if (other.min < min) min = other.min;
+		if (other.max > max) max = other.max;
+		pos_sum += other.pos_sum;
+		neg_sum += other.neg_sum;
+	}
+};
+
+/// @class AudioPeakPyramid
+/// @brief Multi-resolution min/max/sum summary of an audio stream
+///
+/// The pyramid is built incrementally by a single writer (normally the decoder
+/// thread of a cache provider) feeding it the int16 mono samples in order, and
+/// may be queried concurrently from other threads. Queries only use levels
+/// which have been fully built and fall back to reading samples from the
+/// provider for the rest, so query cost is bounded by the number of blocks
+/// touched rather than the number of samples covered.
+class AudioPeakPyramid {
+public:
+	/// Number of levels in the pyramid
+	static const size_t levels = 3;
+
+private:
+	int64_t num_samples;
+	/// Number of samples which have been fed to Append
+	int64_t added_samples = 0;
+	/// Number of samples whose summaries are visible to readers
+	std::atomic<int64_t> available_samples{0};
+
+	std::array<std::vector<AudioPeak>, levels> data;
+	/// Summaries of the incomplete block at the end of each level
+	std::array<AudioPeak, levels> partial;
+
+	void Publish();
+
+public:
+	/// Constructor
+	/// @param num_samples Total number of samples in the stream being summarised
+	AudioPeakPyramid(int64_t num_samples);
+
+	/// Feed the next count samples of the stream into the pyramid
+	void Append(const int16_t *buf, int64_t count);
+
+	/// Get the summary of a range of samples
+	/// @param provider Provider to read samples not covered by the pyramid from
+	/// @param start First sample of the range
+	/// @param count Number of samples in the range
+	AudioPeak Query(AudioProvider const& provider, int64_t start, int64_t count) const;
+
+	/// Have summaries for the entire stream been built?
+	bool IsComplete() const { return available_samples == num_samples; }
+
+	/// Load a previously saved pyramid
+	/// @return true if the file existed and matches the stream length
+	///
+	/// Must be called before anything has been appended
+	bool Load(fs::path const& filename);
+
+	/// Save a complete pyramid to disk
+	void Save(fs::path const& filename) const;
+};
+}
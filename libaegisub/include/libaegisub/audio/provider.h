@@ -24,23 +24,35 @@
 #include <memory>
 
 namespace agi {
+class AudioPeakPyramid;
+
 class AudioProvider {
 protected:
 	int channels = 0;
 	/// Total number of samples per channel
 	int64_t num_samples = 0;
 	/// Samples per channel which have been decoded and can be fetched with FillBuffer
-	/// Only applicable for the cache providers
+	/// Only applicable for the cache providers. Caches which decode out of
+	/// order may also have decoded audio beyond this; see IsRangeDecoded.
 	std::atomic<int64_t> decoded_samples{0};
 	int sample_rate = 0;
 	int bytes_per_sample = 0;
 	bool float_samples = false;
+	/// Index of the track in the file which was opened, or -1 if the
+	/// provider doesn't let the user pick one
+	int track = -1;
 
 	virtual void FillBuffer(void *buf, int64_t start, int64_t count) const = 0;
 	virtual void FillBufferInt16Mono(int16_t* buf, int64_t start, int64_t count) const;
 
 	void ZeroFill(void *buf, int64_t count) const;
 
+	/// Convert count samples in this provider's native format to 16-bit mono
+	void ConvertToInt16Mono(const void *src, int16_t *dst, int64_t count) const;
+
+	/// Copy count samples in this provider's native format with the volume adjusted
+	void ScaleSamples(const void *src, void *dst, int64_t count, double volume) const;
+
 public:
 	virtual ~AudioProvider() = default;
 
@@ -55,9 +67,39 @@ public:
 	int     GetBytesPerSample() const { return bytes_per_sample; }
 	int     GetChannels()       const { return channels; }
 	bool    AreSamplesFloat()   const { return float_samples; }
+	int     GetTrack()          const { return track; }
 
 	/// Does this provider benefit from external caching?
 	virtual bool NeedsCache() const { return false; }
+
+	/// Can FillBuffer be called from several threads at once, and is seeking
+	/// cheap enough that the audio can be decoded in chunks out of order?
+	virtual bool SupportsConcurrentReads() const { return false; }
+
+	/// Have all of the samples in the given range been decoded?
+	virtual bool IsRangeDecoded(int64_t start, int64_t count) const { return start + count <= decoded_samples; }
+
+	/// Ask a cache provider to decode the audio starting at the given sample
+	///
+	/// This is only a hint, and cache providers whose source has to be read
+	/// sequentially ignore it.
+	virtual void PrioritizeDecoding(int64_t) const { }
+
+	/// Get a precomputed peak summary of the audio, if this provider has one
+	virtual AudioPeakPyramid const* GetPeaks() const { return nullptr; }
+
+	/// Get a pointer directly into a cache provider's storage
+	///
+	/// Takes the first sample wanted, the number of samples wanted and an out
+	/// pointer which is set to the samples at the first one, in this
+	/// provider's format. Returns the number of samples available there, or
+	/// zero if there's no direct access.
+	///
+	/// Fewer samples than asked for are returned when the range crosses the
+	/// end of a cache block or of the decoded audio, so callers should loop
+	/// until they get everything or zero. The memory is read-only and stays
+	/// valid for the lifetime of the provider.
+	virtual int64_t GetSpan(int64_t, int64_t, const void **) const { return 0; }
 };
 
 /// Helper base class for an audio provider which wraps another provider
@@ -74,6 +116,7 @@ public:
 		sample_rate = source->GetSampleRate();
 		bytes_per_sample = source->GetBytesPerSample();
 		float_samples = source->AreSamplesFloat();
+		track = source->GetTrack();
 	}
 };
 
@@ -94,6 +137,19 @@ std::unique_ptr<AudioProvider> CreateConvertAudioProvider(std::unique_ptr<AudioP
 std::unique_ptr<AudioProvider> CreateLockAudioProvider(std::unique_ptr<AudioProvider> source_provider);
 std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& dir);
 std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> source_provider);
+/// RAM cache which stores the audio losslessly compressed
+std::unique_ptr<AudioProvider> CreateCompressedRAMAudioProvider(std::unique_ptr<AudioProvider> source_provider);
+
+/// Cache providers whose peak summary of the audio is loaded from and saved to
+/// peak_cache rather than always being rebuilt while decoding
+std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& dir, fs::path const& peak_cache);
+std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& peak_cache);
+std::unique_ptr<AudioProvider> CreateCompressedRAMAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& peak_cache);
+
+/// HD cache which keeps the decoded audio in persistent_file once it has all
+/// been decoded, and uses that file rather than decoding again if it already
+/// exists and matches the source's format
+std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& dir, fs::path const& peak_cache, fs::path const& persistent_file);
 
 void SaveAudioClip(AudioProvider const& provider, fs::path const& path, int start_time, int end_time);
 }
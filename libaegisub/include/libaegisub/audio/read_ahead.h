@@ -0,0 +1,145 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace agi {
+class AudioProvider;
+
+/// @class AudioReadAhead
+/// @brief Decodes audio for a player ahead of time on a background thread
+///
+/// The decoded audio is kept in a single-producer single-consumer ring
+/// buffer. The consumer side (Read, Peek, Consume, Wait and Seek) is meant to
+/// be used by a single thread at a time, normally the audio player's output
+/// thread or callback, and apart from Seek and Wait it never waits for the
+/// decoder or allocates, so a slow read from the provider shows up as a short
+/// read rather than as the output thread stalling. The decoder thread sleeps
+/// whenever the ring is full or there is nothing left to decode.
+///
+/// On Linux the decoder sleeps on a futex, so Read and Consume never take a
+/// lock, even when they have to wake it. Elsewhere waking it briefly takes a
+/// mutex which only guards the sleep itself.
+///
+/// Volume is applied when decoding, so changes to it are heard once the
+/// audio already buffered has been played.
+class AudioReadAhead {
+	AudioProvider const& provider;
+	bool mono16;
+	size_t frame_size;
+	/// Ring size in frames
+	int64_t capacity;
+	/// Frames decoded at a time
+	int64_t chunk;
+	std::vector<char> ring;
+
+	/// Stream position of the next frame the consumer will read. Only
+	/// written by the consumer.
+	std::atomic<int64_t> read_pos{0};
+	/// Stream position one past the last decoded frame in the ring. Only
+	/// written by the decoder thread.
+	std::atomic<int64_t> write_pos{0};
+	/// Most recent seek which the decoder thread has started decoding for
+	std::atomic<uint64_t> ack_epoch{0};
+	/// Most recent seek made by the consumer
+	uint64_t consumer_epoch = 0;
+	/// Set by the decoder thread before it checks for free space, so that the
+	/// consumer knows it has to wake it after freeing some
+	std::atomic<bool> wants_space{false};
+
+	/// Incremented each time the decoder thread is woken. The decoder reads
+	/// it before checking whether it has anything to do and then sleeps only
+	/// while it's unchanged, so a wakeup in between isn't lost.
+	std::atomic<uint32_t> wake_count{0};
+	/// Used to sleep on wake_count where there are no futexes
+	std::mutex wake_lock;
+	std::condition_variable wake_cv;
+
+	std::atomic<int64_t> end{0};
+	std::atomic<double> volume{1.0};
+
+	/// Guards the below, and is held by the decoder thread while it
+	/// publishes decoded audio so that a seek can't slip in between
+	std::mutex lock;
+	/// Signalled when new audio has been decoded
+	std::condition_variable data_ready;
+	uint64_t seek_epoch = 0;
+	int64_t seek_target = 0;
+	bool closing = false;
+
+	std::thread decoder;
+
+	void DecodeThread();
+	/// Sleep until wake_count is no longer seen
+	void SleepDecoder(uint32_t seen);
+	/// Wake the decoder thread. Called when there's a new seek, space has
+	/// been freed, the end position has changed or the reader is being
+	/// destroyed. Never takes lock.
+	void WakeDecoder();
+	/// Frames available to the consumer, or zero if the decoder hasn't caught
+	/// up with the last seek
+	int64_t Available() const;
+
+public:
+	/// Constructor
+	/// @param provider Provider to read from, which must outlive this
+	/// @param mono16 Convert the audio to 16-bit mono rather than using the provider's format
+	/// @param buffer_ms Amount of audio to decode ahead
+	AudioReadAhead(AudioProvider const& provider, bool mono16, int buffer_ms = 500);
+	~AudioReadAhead();
+
+	/// Discard the buffered audio and start decoding from start
+	void Seek(int64_t start);
+	/// Set the position to stop decoding at. May be called from any thread.
+	void SetEnd(int64_t end);
+	/// Set the volume for audio decoded from now on. May be called from any thread.
+	void SetVolume(double volume) { this->volume = volume; }
+
+	/// Get the decoded audio at the read position without consuming it
+	/// @param[out] data Set to the audio, in the output format
+	/// @return Number of frames at data, which may be fewer than are
+	///         available if the buffered audio wraps around the ring
+	int64_t Peek(const void **data) const;
+	/// Mark count frames as read
+	void Consume(int64_t count);
+	/// Move the read position forward by count frames, whether or not they
+	/// have been decoded yet. Used to keep the position in step with the
+	/// output when silence had to be played in place of audio which wasn't
+	/// ready; the decoder jumps ahead rather than decoding the skipped audio.
+	void Skip(int64_t count);
+	/// Copy up to count frames to dst and consume them
+	/// @return Number of frames copied
+	int64_t Read(void *dst, int64_t count);
+
+	/// Block until count frames (or everything up to the end position) are
+	/// available, or the timeout expires
+	/// @return Number of frames available
+	int64_t Wait(int64_t count, std::chrono::milliseconds timeout);
+
+	/// Stream position of the next frame which will be read
+	int64_t GetPosition() const { return read_pos; }
+	/// Size in bytes of each frame in the output format
+	size_t GetFrameSize() const { return frame_size; }
+};
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file buffer_pool.h
+/// @brief Recycling of large, frequently reallocated buffers
+/// @ingroup libaegisub
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace agi {
+namespace detail { struct buffer_pool_state; }
+
+/// @class buffer_pool
+/// @brief A thread-safe free list of aligned memory blocks
+///
+/// Requests are rounded up to a size class so that buffers of similar but not
+/// identical sizes can share blocks. Blocks which are released are kept for
+/// reuse until the total size of the unused blocks would exceed a limit, at
+/// which point blocks of other size classes are freed first.
+class buffer_pool {
+	friend class pooled_buffer;
+	std::shared_ptr<detail::buffer_pool_state> state;
+
+public:
+	/// Alignment of every block handed out by a pool
+	static const size_t alignment = 64;
+
+	/// Constructor
+	/// @param max_retained Maximum number of bytes of unused blocks to keep
+	explicit buffer_pool(size_t max_retained);
+
+	/// Size of the block used for a request of the given size
+	static size_t size_class(size_t size);
+
+	/// Number of bytes in unused blocks currently held by the pool
+	size_t retained() const;
+
+	/// Free all unused blocks
+	void trim();
+};
+
+/// @class pooled_buffer
+/// @brief A resizable byte buffer whose storage comes from a buffer_pool
+///
+/// The storage is returned to the pool when the buffer is destroyed or needs
+/// a larger block. Copies draw from the same pool as the buffer being copied
+/// into, so a buffer which is repeatedly assigned frames of the same size
+/// never reallocates. The pool is kept alive until all of its buffers have
+/// been destroyed.
+class pooled_buffer {
+	std::shared_ptr<detail::buffer_pool_state> pool;
+	uint8_t *ptr = nullptr;
+	size_t len = 0;
+	size_t cap = 0;
+
+	/// Give the current block back to the pool
+	void release();
+
+public:
+	explicit pooled_buffer(buffer_pool const& pool);
+	pooled_buffer(pooled_buffer const& other);
+	pooled_buffer(pooled_buffer&& other) noexcept;
+	pooled_buffer& operator=(pooled_buffer const& other);
+	pooled_buffer& operator=(pooled_buffer&& other) noexcept;
+	~pooled_buffer();
+
+	uint8_t *data() { return ptr; }
+	const uint8_t *data() const { return ptr; }
+	uint8_t& operator[](size_t i) { return ptr[i]; }
+	const uint8_t& operator[](size_t i) const { return ptr[i]; }
+
+	size_t size() const { return len; }
+	size_t capacity() const { return cap; }
+	bool empty() const { return len == 0; }
+
+	/// Change the size of the buffer, preserving the contents which fit in
+	/// the new size. Any new bytes are uninitialized.
+	void resize(size_t size);
+
+	/// Replace the contents of the buffer with a copy of [first, last)
+	void assign(const uint8_t *first, const uint8_t *last);
+
+	/// Empty the buffer and return its storage to the pool
+	void clear();
+};
+}
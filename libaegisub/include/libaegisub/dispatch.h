@@ -14,6 +14,7 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#include <cstddef>
 #include <functional>
 #include <memory>
 
@@ -46,5 +47,15 @@ namespace agi {
 
 		/// Create a new serial queue
 		std::unique_ptr<Queue> Create();
+
+		/// Call fn for each index in [0, count), with the calls spread between
+		/// the calling thread and the background queue, and return once they
+		/// have all finished
+		///
+		/// If any of the calls throw, the calls for higher indices which
+		/// haven't started yet are skipped and the exception thrown for the
+		/// lowest index is rethrown, so errors are reported as if the loop
+		/// had run serially.
+		void ParallelFor(size_t count, std::function<void (size_t)> fn);
 	}
 }
@@ -0,0 +1,60 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+/// @file image_orientation.h
+/// @brief Rotating and mirroring 32-bit images
+/// @ingroup libaegisub
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace agi {
+/// One of the eight combinations of rotating by multiples of 90 degrees and
+/// mirroring an image
+///
+/// Pixel (x, y) of the output comes from the input by first mirroring the
+/// output coordinates as requested and then, if transpose is set, swapping
+/// them. Every combination of rotations and flips reduces to one of these.
+struct image_orientation {
+	bool transpose = false; ///< Swap rows and columns
+	bool mirror_x = false;  ///< Reverse the order of the pixels in each row
+	bool mirror_y = false;  ///< Reverse the order of the rows
+
+	/// Orientation for rotating an image by some multiple of 90 degrees
+	/// @param degrees Counterclockwise rotation; other angles are rounded down
+	static image_orientation rotation(int degrees);
+
+	/// This orientation applied to an image which was first mirrored
+	image_orientation after_flip(bool horizontal, bool vertical) const;
+
+	bool is_identity() const { return !transpose && !mirror_x && !mirror_y; }
+};
+
+/// Copy a 32 bits per pixel image, reorienting it in the process
+/// @param src First row of the source image
+/// @param src_pitch Bytes between the starts of consecutive source rows
+/// @param width Width of the source image in pixels
+/// @param height Height of the source image in pixels
+/// @param dst First row of the destination image, which is height pixels wide
+///            and width pixels tall if the orientation transposes
+/// @param dst_pitch Bytes between the starts of consecutive destination rows
+/// @param orientation Orientation to apply
+void copy_oriented(const uint8_t *src, size_t src_pitch, size_t width, size_t height,
+                   uint8_t *dst, size_t dst_pitch, image_orientation orientation);
+}
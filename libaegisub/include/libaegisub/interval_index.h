@@ -0,0 +1,138 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file interval_index.h
+/// @brief Index of half-open intervals for overlap queries
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace agi {
+/// @class IntervalIndex
+/// @brief Static index answering which intervals overlap a range
+///
+/// The intervals are sorted by start and treated as an implicit balanced
+/// binary tree laid out in order in the array (the same layout as cgranges'
+/// implicit interval tree), with each node storing the largest end in its
+/// subtree. Queries are O(log n + matches) and the index takes no memory
+/// beyond the sorted intervals themselves.
+///
+/// Intervals are added with Add and the index is built by Build, after which
+/// it can't be modified.
+template<typename T>
+class IntervalIndex {
+	struct Entry {
+		int start;
+		int end;
+		/// Largest end in the subtree rooted at this entry
+		int max_end;
+		T value;
+	};
+	std::vector<Entry> entries;
+	/// Level of the root node, or -1 if there are no entries
+	int root_level = -1;
+
+public:
+	/// Add the interval [start, end)
+	void Add(int start, int end, T value) {
+		entries.push_back(Entry{start, end, end, std::move(value)});
+	}
+
+	/// Sort the intervals and build the tree
+	void Build() {
+		std::stable_sort(begin(entries), end(entries), [](Entry const& a, Entry const& b) {
+			return a.start < b.start;
+		});
+
+		const size_t n = entries.size();
+		root_level = -1;
+		if (!n) return;
+
+		// Leaves are the even indices. The tree is only complete if n is one
+		// less than a power of two, so track the rightmost node of each level
+		// to stand in for the right children which don't exist.
+		size_t last_i = 0;
+		int last = 0;
+		for (size_t i = 0; i < n; i += 2) {
+			last_i = i;
+			last = entries[i].max_end = entries[i].end;
+		}
+
+		int level = 1;
+		for (; size_t(1) << level <= n; ++level) {
+			const size_t x = size_t(1) << (level - 1);
+			for (size_t i = 2 * x - 1; i < n; i += 4 * x) {
+				int left = entries[i - x].max_end;
+				int right = i + x < n ? entries[i + x].max_end : last;
+				entries[i].max_end = std::max({entries[i].end, left, right});
+			}
+			last_i = (last_i >> level) & 1 ? last_i - x : last_i + x;
+			if (last_i < n)
+				last = std::max(last, entries[last_i].max_end);
+		}
+		root_level = level - 1;
+	}
+
+	/// Call func with the value of each interval overlapping [start, end),
+	/// in order of start time
+	template<typename Func>
+	void Overlapping(int start, int end, Func&& func) const {
+		if (root_level < 0 || start >= end) return;
+
+		struct Node {
+			int level;
+			size_t i;
+			bool left_done;
+		};
+		Node stack[64];
+		int top = 0;
+		stack[top++] = Node{root_level, (size_t(1) << root_level) - 1, false};
+
+		const size_t n = entries.size();
+		while (top) {
+			Node node = stack[--top];
+			if (node.level <= 3) {
+				// Small subtrees are faster to just scan
+				size_t first = node.i >> node.level << node.level;
+				size_t last = std::min(n, first + (size_t(1) << (node.level + 1)) - 1);
+				for (size_t i = first; i < last && entries[i].start < end; ++i) {
+					if (start < entries[i].end)
+						func(entries[i].value);
+				}
+			}
+			else if (!node.left_done) {
+				// The left child may not exist, in which case its subtree
+				// could still contain entries
+				const size_t left = node.i - (size_t(1) << (node.level - 1));
+				stack[top++] = Node{node.level, node.i, true};
+				if (left >= n || entries[left].max_end > start)
+					stack[top++] = Node{node.level - 1, left, false};
+			}
+			else if (node.i < n && entries[node.i].start < end) {
+				if (start < entries[node.i].end)
+					func(entries[node.i].value);
+				stack[top++] = Node{node.level - 1, node.i + (size_t(1) << (node.level - 1)), false};
+			}
+		}
+	}
+
+	size_t size() const { return entries.size(); }
+	bool empty() const { return entries.empty(); }
+};
+}
@@ -35,11 +35,16 @@ class Save {
 	std::unique_ptr<std::ostream> fp;
 	const fs::path file_name;
 	const fs::path tmp_name;
+	bool discarded = false;
 
 public:
 	Save(fs::path const& file, bool binary = false);
 	~Save() noexcept(false);
 	std::ostream& Get() { return *fp; }
+
+	/// Delete the partially written file rather than replacing the target
+	/// file with it when this is destroyed
+	void Discard();
 };
 
 	} // namespace io
@@ -0,0 +1,55 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file prefix_matcher.h
+/// @brief Trie for finding which of a fixed set of strings prefixes a text
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace agi {
+/// @class PrefixMatcher
+/// @brief Finds the first of a list of strings which is a prefix of a text
+///
+/// This gives the same result as checking starts_with for each string in
+/// order, but walks a trie over the strings so that it takes time
+/// proportional to the length of the match rather than to the number of
+/// strings. The trie is a single table with a column for each byte which
+/// appears in any of the strings.
+class PrefixMatcher {
+	/// Column of each byte in the table, or 0 for bytes not in any string
+	std::array<uint16_t, 256> columns;
+	size_t width = 1;
+	/// Index of each node's children, width per node, with 0 for no child
+	std::vector<uint32_t> children;
+	/// Index of the earliest string which ends at each node, or -1
+	std::vector<int> matches;
+
+public:
+	PrefixMatcher(std::vector<std::string> const& strings = {});
+
+	/// Get the index of the first string which is a prefix of [begin, end),
+	/// or -1 if none are
+	int Find(const char *begin, const char *end) const;
+	int Find(std::string const& text) const {
+		return Find(text.data(), text.data() + text.size());
+	}
+};
+}
@@ -15,6 +15,7 @@
 // Aegisub Project http://www.aegisub.org/
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 
 #include <libaegisub/color.h>
@@ -92,5 +93,52 @@ public:
 		return Color{arr[0], arr[1], arr[2], c.a};
 	}
 };
+
+/// Chroma subsampling of a planar YCbCr image
+enum class ycbcr_subsampling {
+	yuv420, ///< Half width and half height chroma
+	yuv422, ///< Half width chroma
+	yuv411, ///< Quarter width chroma
+	yuv444, ///< Full resolution chroma
+	mono    ///< No chroma planes at all
+};
+
+/// A planar 8-bit YCbCr image
+struct ycbcr_image {
+	int width;
+	int height;
+	ycbcr_subsampling subsampling;
+	/// Y, Cb and Cr planes. The chroma planes are unused for mono images.
+	std::array<const uint8_t *, 3> planes;
+	/// Bytes between the starts of consecutive rows of each plane
+	std::array<size_t, 3> strides;
+};
+
+/// A fixed-point converter from planar YCbCr images to BGRA
+///
+/// Chroma is upsampled by duplicating samples, and the results are within
+/// one of those from ycbcr_converter::ycbcr_to_rgb. The alpha channel is
+/// set to zero.
+class ycbcr_to_bgra {
+	/// Rows of the conversion matrix for R, G and B, scaled by 2^13
+	std::array<std::array<int16_t, 3>, 3> coeff;
+	/// Offsets to add for each channel, including the input shift and rounding
+	std::array<int32_t, 3> offset;
+
+public:
+	ycbcr_to_bgra(ycbcr_matrix mat, ycbcr_range range);
+
+	/// Convert some of the rows of an image
+	/// @param src Image to convert
+	/// @param dst Start of the first row of the output image (not the first row converted)
+	/// @param dst_pitch Bytes between the starts of consecutive output rows
+	/// @param first First row to convert
+	/// @param last One past the last row to convert
+	void ConvertRows(ycbcr_image const& src, uint8_t *dst, size_t dst_pitch, int first, int last) const;
+
+	/// Convert an entire image, splitting the rows between the threads of the
+	/// background dispatch queue
+	void Convert(ycbcr_image const& src, uint8_t *dst, size_t dst_pitch) const;
+};
 }
 
@@ -19,11 +19,13 @@
 #include <libaegisub/fs_fwd.h>
 
 #include <boost/flyweight.hpp>
+#include <memory>
 
 /// @class AssAttachment
 class AssAttachment final : public AssEntry {
-	/// ASS uuencoded entry data, including header.
-	boost::flyweight<std::string> entry_data;
+	/// ASS uuencoded entry data, including header. Copies of an attachment
+	/// share this, and it's copied on write.
+	std::shared_ptr<std::string> entry_data;
 
 	/// Name of the attached file, with SSA font mangling if it is a ttf
 	boost::flyweight<std::string> filename;
@@ -35,7 +37,7 @@ public:
 	size_t GetSize() const;
 
 	/// Add a line of data (without newline) read from a subtitle file
-	void AddData(std::string const& data) { entry_data = entry_data.get() + data + "\r\n"; }
+	void AddData(std::string const& data);
 
 	/// Extract the contents of this attachment to a file
 	/// @param filename Path to save the attachment to
@@ -45,7 +47,12 @@ public:
 	/// @param raw If false, remove the SSA filename mangling
 	std::string GetFileName(bool raw=false) const;
 
-	std::string const& GetEntryData() const { return entry_data; }
+	std::string const& GetEntryData() const { return *entry_data; }
+
+	/// Get the entry data shared between copies of this attachment. Holding
+	/// on to it makes any later change to the attachment copy the data first,
+	/// so the pointer identifies this exact content.
+	std::shared_ptr<const std::string> GetSharedEntryData() const { return entry_data; }
 	AssEntryGroup Group() const override;
 
 	AssAttachment(AssAttachment const& rgt) = default;
@@ -32,9 +32,11 @@
 /// @ingroup subs_storage
 
 #include "ass_dialogue.h"
+#include "ass_parsed_text.h"
 #include "subtitle_format.h"
 #include "utils.h"
 
+#include <libaegisub/ass/dialogue_line.h>
 #include <libaegisub/of_type_adaptor.h>
 #include <libaegisub/split.h>
 #include <libaegisub/make_unique.h>
@@ -47,9 +49,12 @@
 #include <boost/spirit/include/karma_generate.hpp>
 #include <boost/spirit/include/karma_int.hpp>
 
+#include <atomic>
+
 using namespace boost::adaptors;
 
-static int next_id = 0;
+// Lines are constructed on worker threads when files are loaded
+static std::atomic<int> next_id{0};
 
 AssDialogue::AssDialogue() {
 	Id = ++next_id;
@@ -89,6 +94,23 @@ public:
 };
 
 void AssDialogue::Parse(std::string const& raw) {
+	agi::ass::DialogueFields fields;
+	if (agi::ass::ParseDialogueFields(raw, fields)) {
+		Comment = fields.comment;
+		Layer = fields.layer;
+		Start = agi::str(fields.start);
+		End = agi::str(fields.end);
+		Style = agi::str(fields.style);
+		Actor = agi::str(fields.actor);
+		Margin = fields.margin;
+		Effect = agi::str(fields.effect);
+		if (fields.has_extradata)
+			ExtradataIds = fields.extradata_ids;
+		Text = agi::str(fields.text);
+		return;
+	}
+
+	// Malformed lines go through the slow path to get the right error
 	agi::StringRange str;
 	if (boost::starts_with(raw, "Dialogue:")) {
 		Comment = false;
@@ -167,9 +189,14 @@ static void append_unsafe_str(std::string &out, std::string const& str) {
 }
 
 std::string AssDialogue::GetEntryData() const {
-	std::string str = Comment ? "Comment: " : "Dialogue: ";
+	std::string str;
 	str.reserve(51 + Style.get().size() + Actor.get().size() + Effect.get().size() + Text.get().size());
+	AppendEntryData(str);
+	return str;
+}
 
+void AssDialogue::AppendEntryData(std::string &str) const {
+	str += Comment ? "Comment: " : "Dialogue: ";
 	append_int(str, Layer);
 	append_str(str, Start.GetAssFormatted());
 	append_str(str, End.GetAssFormatted());
@@ -192,78 +219,10 @@ std::string AssDialogue::GetEntryData() const {
 		if (c != '\n' && c != '\r')
 			str += c;
 	}
-
-	return str;
 }
 
 std::vector<std::unique_ptr<AssDialogueBlock>> AssDialogue::ParseTags() const {
-	std::vector<std::unique_ptr<AssDialogueBlock>> Blocks;
-
-	// Empty line, make an empty block
-	if (Text.get().empty()) {
-		Blocks.push_back(agi::make_unique<AssDialogueBlockPlain>());
-		return Blocks;
-	}
-
-	int drawingLevel = 0;
-	std::string const& text(Text.get());
-
-	for (size_t len = text.size(), cur = 0; cur < len; ) {
-		// Overrides block
-		if (text[cur] == '{') {
-			size_t end = text.find('}', cur);
-
-			// VSFilter requires that override blocks be closed, while libass
-			// does not. We match VSFilter here.
-			if (end == std::string::npos)
-				goto plain;
-
-			++cur;
-			// Get contents of block
-			std::string work = text.substr(cur, end - cur);
-			cur = end + 1;
-
-			if (work.size() && work.find('\\') == std::string::npos) {
-				//We've found an override block with no backslashes
-				//We're going to assume it's a comment and not consider it an override block
-				Blocks.push_back(agi::make_unique<AssDialogueBlockComment>(work));
-			}
-			else {
-				// Create block
-				auto block = agi::make_unique<AssDialogueBlockOverride>(work);
-				block->ParseTags();
-
-				// Look for \p in block
-				for (auto const& tag : block->Tags) {
-					if (tag.Name == "\\p")
-						drawingLevel = tag.Params[0].Get<int>(0);
-				}
-				Blocks.push_back(std::move(block));
-			}
-
-			continue;
-		}
-
-		// Plain-text/drawing block
-plain:
-		std::string work;
-		size_t end = text.find('{', cur + 1);
-		if (end == std::string::npos) {
-			work = text.substr(cur);
-			cur = len;
-		}
-		else {
-			work = text.substr(cur, end - cur);
-			cur = end;
-		}
-
-		if (drawingLevel == 0)
-			Blocks.push_back(agi::make_unique<AssDialogueBlockPlain>(work));
-		else
-			Blocks.push_back(agi::make_unique<AssDialogueBlockDrawing>(work, drawingLevel));
-	}
-
-	return Blocks;
+	return AssParsedText(Text).MakeBlocks();
 }
 
 void AssDialogue::StripTags() {
@@ -35,9 +35,11 @@
 #pragma once
 
 #include <boost/intrusive/list.hpp>
+#include <functional>
 #include <memory>
 #include <string>
 
+class AssDialogue;
 class AssFile;
 class AssExportFilterChain;
 class wxWindow;
@@ -71,6 +73,20 @@ public:
 	///                      to open a progress dialog
 	virtual void ProcessSubs(AssFile *subs, wxWindow *parent_window=nullptr)=0;
 
+	/// Get a function which applies this filter to a single line, for filters
+	/// which process each line without looking at the others
+	/// @param subs Subtitles which will be processed
+	/// @return The function, or an empty function if the filter has to be
+	///         run on the whole file with ProcessSubs
+	///
+	/// When exporting, adjacent filters with line processors are run together
+	/// in a single pass over the lines, split between several threads. The
+	/// function may be called for different lines at the same time and must
+	/// only modify the line it's given. Nothing but the sections other than
+	/// the dialogue lines should be looked at when creating it, as earlier
+	/// filters may not have been applied to the lines yet.
+	virtual std::function<void (AssDialogue&)> GetLineProcessor(AssFile *) { return nullptr; }
+
 	/// Draw setup controls
 	/// @param parent Parent window to add controls to
 	/// @param c Project context
@@ -34,6 +34,7 @@
 
 #include "ass_exporter.h"
 
+#include "ass_dialogue.h"
 #include "ass_export_filter.h"
 #include "ass_file.h"
 #include "compat.h"
@@ -41,9 +42,38 @@
 #include "project.h"
 #include "subtitle_format.h"
 
+#include <libaegisub/dispatch.h>
+
+#include <algorithm>
 #include <memory>
 #include <wx/sizer.h>
 
+namespace {
+typedef std::function<void (AssDialogue&)> LineProcessor;
+
+/// Number of lines given to a thread at a time
+const size_t lines_per_chunk = 256;
+
+/// Run each line of the file through all of the processors, with the lines
+/// split between the threads of the background queue
+void run_line_filters(AssFile *subs, std::vector<LineProcessor> const& processors) {
+	if (processors.empty()) return;
+
+	std::vector<AssDialogue *> lines;
+	for (auto& line : subs->Events)
+		lines.push_back(&line);
+
+	size_t chunks = (lines.size() + lines_per_chunk - 1) / lines_per_chunk;
+	agi::dispatch::ParallelFor(chunks, [&](size_t chunk) {
+		size_t end = std::min(lines.size(), (chunk + 1) * lines_per_chunk);
+		for (size_t i = chunk * lines_per_chunk; i < end; ++i) {
+			for (auto const& process : processors)
+				process(*lines[i]);
+		}
+	});
+}
+}
+
 AssExporter::AssExporter(agi::Context *c) : c(c) { }
 
 void AssExporter::DrawSettings(wxWindow *parent, wxSizer *target_sizer) {
@@ -82,10 +112,21 @@ std::vector<std::string> AssExporter::GetAllFilterNames() const {
 void AssExporter::Export(agi::fs::path const& filename, std::string const& charset, wxWindow *export_dialog) {
 	AssFile subs(*c->ass);
 
+	// Filters which work a line at a time are run together in one pass over
+	// the file, with any filters which need the whole file acting as barriers
+	std::vector<LineProcessor> line_filters;
 	for (auto filter : filters) {
 		filter->LoadSettings(is_default, c);
+		if (auto process = filter->GetLineProcessor(&subs)) {
+			line_filters.push_back(std::move(process));
+			continue;
+		}
+
+		run_line_filters(&subs, line_filters);
+		line_filters.clear();
 		filter->ProcessSubs(&subs, export_dialog);
 	}
+	run_line_filters(&subs, line_filters);
 
 	const SubtitleFormat *writer = SubtitleFormat::GetWriter(filename);
 	if (!writer)
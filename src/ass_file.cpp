@@ -85,6 +85,8 @@ void AssFile::swap(AssFile& from) throw() {
 	Extradata.swap(from.Extradata);
 	std::swap(Properties, from.Properties);
 	std::swap(next_extradata_id, from.next_extradata_id);
+	std::swap(time_index, from.time_index);
+	std::swap(time_index_valid, from.time_index_valid);
 }
 
 AssFile& AssFile::operator=(AssFile from) {
@@ -175,15 +177,41 @@ int AssFile::Commit(wxString const& desc, int type, int amend_id, AssDialogue *s
 			event.Row = i++;
 	}
 
+	if (type == COMMIT_NEW || (type & (COMMIT_DIAG_ADDREM | COMMIT_ORDER | COMMIT_DIAG_TIME)))
+		time_index_valid = false;
+
 	AnnouncePreCommit(type, single_line);
 
-	PushState({desc, &amend_id, single_line});
+	PushState({desc, type, &amend_id, single_line});
 
 	AnnounceCommit(type, single_line);
 
 	return amend_id;
 }
 
+std::vector<AssDialogue *> AssFile::LinesIn(int start, int end) {
+	if (!time_index_valid) {
+		time_index = {};
+		size_t i = 0;
+		for (auto& line : Events)
+			time_index.Add(line.Start, line.End, std::make_pair(i++, &line));
+		time_index.Build();
+		time_index_valid = true;
+	}
+
+	std::vector<std::pair<size_t, AssDialogue *>> found;
+	time_index.Overlapping(start, end, [&](std::pair<size_t, AssDialogue *> const& line) {
+		found.push_back(line);
+	});
+	std::sort(found.begin(), found.end());
+
+	std::vector<AssDialogue *> lines;
+	lines.reserve(found.size());
+	for (auto const& line : found)
+		lines.push_back(line.second);
+	return lines;
+}
+
 bool AssFile::CompStart(AssDialogue const& lft, AssDialogue const& rgt) {
 	return lft.Start < rgt.Start;
 }
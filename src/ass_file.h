@@ -32,6 +32,7 @@
 #include "ass_entry.h"
 
 #include <libaegisub/fs_fwd.h>
+#include <libaegisub/interval_index.h>
 #include <libaegisub/signal.h>
 
 #include <boost/intrusive/list.hpp>
@@ -63,6 +64,7 @@ struct LineFold {
 
 struct AssFileCommit {
 	wxString const& message;
+	int type;
 	int *commit_id;
 	AssDialogue *single_line;
 };
@@ -93,6 +95,11 @@ class AssFile {
 	agi::signal::Signal<int, const AssDialogue*> AnnouncePreCommit;
 	agi::signal::Signal<AssFileCommit> PushState;
 
+	/// Dialogue lines and their position in the file, indexed by time. Built
+	/// when first needed after being invalidated.
+	agi::IntervalIndex<std::pair<size_t, AssDialogue *>> time_index;
+	bool time_index_valid = false;
+
 	void SetExtradataValue(AssDialogue& line, std::string const& key, std::string const& value, bool del);
 public:
 	/// The lines in the file
@@ -138,6 +145,17 @@ public:
 	/// Set the value of a [Script Info] key. Adds it if it doesn't exist.
 	void SetScriptInfo(std::string const& key, std::string const& value);
 
+	/// Get the dialogue lines (including comments) which are visible at some
+	/// point in [start, end), in file order
+	std::vector<AssDialogue *> LinesIn(int start, int end);
+	/// Get the dialogue lines (including comments) which are visible at the
+	/// given time, in file order
+	std::vector<AssDialogue *> LinesAt(int time) { return LinesIn(time, time + 1); }
+	/// Discard the index used by LinesIn and LinesAt. Commits which change
+	/// line times or which lines are in the file do this, so this is only
+	/// needed after changing lines without committing.
+	void InvalidateTimeIndex() { time_index_valid = false; }
+
 	/// @brief Add a new extradata entry
 	/// @param key Class identifier/owner for the extradata
 	/// @param value Data for the extradata
@@ -29,6 +29,7 @@
 // Aegisub Project http://www.aegisub.org/
 
 #include "ass_dialogue.h"
+#include "ass_parsed_text.h"
 
 #include "utils.h"
 
@@ -36,13 +37,16 @@
 #include <libaegisub/exception.h>
 #include <libaegisub/format.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/prefix_matcher.h>
 
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/range/adaptor/filtered.hpp>
 #include <boost/range/adaptor/transformed.hpp>
+#include <cstring>
 #include <functional>
+#include <mutex>
 
 using namespace boost::adaptors;
 
@@ -174,9 +178,8 @@ struct AssOverrideTagProto {
 };
 
 static std::vector<AssOverrideTagProto> proto;
-static void load_protos() {
-	if (!proto.empty()) return;
-
+static agi::PrefixMatcher proto_matcher;
+static void init_protos() {
 	proto.resize(56);
 	int i = 0;
 
@@ -305,32 +308,43 @@ static void load_protos() {
 	proto[i].AddParam(VariableDataType::INT, AssParameterClass::RELATIVE_TIME_START,OPTIONAL_3 | OPTIONAL_4);
 	proto[i].AddParam(VariableDataType::FLOAT, AssParameterClass::NORMAL,OPTIONAL_2 | OPTIONAL_4);
 	proto[i].AddParam(VariableDataType::BLOCK);
+
+	std::vector<std::string> names;
+	for (auto const& tag : proto)
+		names.push_back(tag.name);
+	proto_matcher = agi::PrefixMatcher(names);
 }
 
-std::vector<std::string> tokenize(const std::string &text) {
-	std::vector<std::string> paramList;
-	paramList.reserve(6);
+// Tags are parsed on worker threads by export filters
+static void load_protos() {
+	static std::once_flag once;
+	std::call_once(once, init_protos);
+}
 
+/// Split the text following a tag's name into its parameters
+/// @param add Called with each parameter and whether it should be trimmed
+template<typename Func>
+void split_parameters(agi::StringRange text, Func&& add) {
 	if (text.empty())
-		return paramList;
+		return;
 
-	if (text[0] != '(') {
+	if (text.front() != '(') {
 		// There's just one parameter (because there's no parentheses)
 		// This means text is all our parameters
-		paramList.emplace_back(boost::trim_copy(text));
-		return paramList;
+		add(text, true);
+		return;
 	}
 
 	// Ok, so there are parentheses used here, so there may be more than one parameter
 	// Enter fullscale parsing!
-	size_t i = 0, textlen = text.size();
+	auto i = text.begin(), textend = text.end();
 	int parDepth = 1;
-	while (i < textlen && parDepth > 0) {
+	while (i < textend && parDepth > 0) {
 		// Just skip until next ',' or ')', whichever comes first
 		// (Next ')' is achieved when parDepth == 0)
-		size_t start = ++i;
-		while (i < textlen && parDepth > 0) {
-			char c = text[i];
+		auto start = ++i;
+		while (i < textend && parDepth > 0) {
+			char c = *i;
 			// parDepth 1 is where we start, and the tag-level we're interested in parsing on
 			if (c == ',' && parDepth == 1) break;
 			if (c == '(') parDepth++;
@@ -344,66 +358,87 @@ std::vector<std::string> tokenize(const std::string &text) {
 			i++;
 		}
 		// i now points to the first character not member of this parameter
-		paramList.emplace_back(boost::trim_copy(text.substr(start, i - start)));
+		add(agi::StringRange(start, i), true);
 	}
 
-	if (i+1 < textlen) {
+	if (textend - i > 1) {
 		// There's some additional garbage after the parentheses
 		// Just add it in for completeness
-		paramList.emplace_back(text.begin() + i + 1, text.end());
+		add(agi::StringRange(i + 1, textend), false);
 	}
-	return paramList;
 }
 
-void parse_parameters(AssOverrideTag *tag, const std::string &text, AssOverrideTagProto::iterator proto_it) {
-	tag->Clear();
-
-	// Tokenize text, attempting to find all parameters
-	std::vector<std::string> paramList = tokenize(text);
-	size_t totalPars = paramList.size();
+/// Find the prototype for the tag at the start of text
+AssOverrideTagProto::iterator find_proto(agi::StringRange text) {
+	load_protos();
+	if (text.empty()) return proto.end();
+	int i = proto_matcher.Find(&*text.begin(), &*text.begin() + text.size());
+	return i < 0 ? proto.end() : proto.begin() + i;
+}
 
-	int parsFlag = 1 << (totalPars - 1); // Get optional parameters flag
-	// vector (i)clip is the second clip proto_ittype in the list
-	if ((tag->Name == "\\clip" || tag->Name == "\\iclip") && totalPars != 4) {
+/// Match the parameters in the text following a tag's name to the tag's prototype
+/// @param add Called with each parameter's prototype and its text, or
+///            nullptr if the parameter is omitted
+/// @return The prototype used, which is the next one for vector clips
+template<typename Func>
+AssOverrideTagProto::iterator match_parameters(agi::StringRange text, AssOverrideTagProto::iterator proto_it, Func&& add) {
+	// No tag has more than seven parameters, so any past that are ignored
+	agi::StringRange params[8];
+	size_t total = 0;
+	split_parameters(text, [&](agi::StringRange param, bool trim) {
+		if (total < 8)
+			params[total] = trim ? boost::trim_copy(param) : param;
+		++total;
+	});
+
+	// vector (i)clip is the second clip prototype in the list
+	if ((proto_it->name == "\\clip" || proto_it->name == "\\iclip") && total != 4)
 		++proto_it;
-	}
-
-	unsigned curPar = 0;
-	for (auto& curproto : proto_it->params) {
-		// Create parameter
-		tag->Params.emplace_back(curproto.type, curproto.classification);
 
-		// Check if it's optional and not present
-		if (!(curproto.optional & parsFlag) || curPar >= totalPars)
-			continue;
-
-		tag->Params.back().Set(paramList[curPar++]);
+	// Get optional parameters flag
+	int pars_flag = total > 0 && total < 32 ? 1 << (total - 1) : 0;
+	size_t cur = 0;
+	for (auto const& param_proto : proto_it->params) {
+		if ((param_proto.optional & pars_flag) && cur < total)
+			add(param_proto, &params[cur++]);
+		else
+			add(param_proto, nullptr);
 	}
+	return proto_it;
 }
 
-}
-
-// From ass_dialogue.h
-void AssDialogueBlockOverride::ParseTags() {
-	Tags.clear();
+/// Split the contents of an override block into tags at the backslashes
+/// which aren't inside parentheses
+template<typename Func>
+void split_tags(agi::StringRange text, Func&& add) {
+	if (text.empty())
+		return;
 
 	int depth = 0;
-	size_t start = 0;
-	for (size_t i = 1; i < text.size(); ++i) {
+	auto start = text.begin();
+	for (auto i = text.begin() + 1; i < text.end(); ++i) {
 		if (depth > 0) {
-			if (text[i] == ')')
+			if (*i == ')')
 				--depth;
 		}
-		else if (text[i] == '\\') {
-			Tags.emplace_back(text.substr(start, i - start));
+		else if (*i == '\\') {
+			add(agi::StringRange(start, i));
 			start = i;
 		}
-		else if (text[i] == '(')
+		else if (*i == '(')
 			++depth;
 	}
+	add(agi::StringRange(start, text.end()));
+}
 
-	if (!text.empty())
-		Tags.emplace_back(text.substr(start));
+}
+
+// From ass_dialogue.h
+void AssDialogueBlockOverride::ParseTags() {
+	Tags.clear();
+	split_tags(agi::StringRange(text.begin(), text.end()), [&](agi::StringRange tag) {
+		Tags.emplace_back(agi::str(tag));
+	});
 }
 
 void AssDialogueBlockOverride::AddTag(std::string const& tag) {
@@ -441,14 +476,18 @@ void AssOverrideTag::Clear() {
 }
 
 void AssOverrideTag::SetText(const std::string &text) {
-	load_protos();
-	for (auto cur = proto.begin(); cur != proto.end(); ++cur) {
-		if (boost::starts_with(text, cur->name)) {
-			Name = cur->name;
-			parse_parameters(this, text.substr(Name.size()), cur);
-			valid = true;
-			return;
-		}
+	auto cur = find_proto(agi::StringRange(text.begin(), text.end()));
+	if (cur != proto.end()) {
+		Clear();
+		Name = cur->name;
+		match_parameters(agi::StringRange(text.begin() + Name.size(), text.end()), cur,
+			[&](AssOverrideParamProto const& param_proto, agi::StringRange const *param) {
+				Params.emplace_back(param_proto.type, param_proto.classification);
+				if (param)
+					Params.back().Set(agi::str(*param));
+			});
+		valid = true;
+		return;
 	}
 
 	// Junk tag
@@ -473,3 +512,198 @@ AssOverrideTag::operator std::string() const {
 	if (parentheses) result += ")";
 	return result;
 }
+
+namespace {
+/// Call func with the text of range as a nul-terminated string
+template<typename Func>
+auto with_c_str(agi::StringRange range, Func&& func) -> decltype(func("")) {
+	char buf[64];
+	if (range.size() < sizeof(buf)) {
+		std::copy(range.begin(), range.end(), buf);
+		buf[range.size()] = 0;
+		return func(buf);
+	}
+	return func(agi::str(range).c_str());
+}
+}
+
+// From ass_parsed_text.h
+template<> std::string AssParsedText::Param::Get<std::string>() const {
+	if (omitted) throw agi::InternalError("AssParsedText::Param::Get() called on omitted parameter");
+	return agi::str(GetText());
+}
+
+template<> int AssParsedText::Param::Get<int>() const {
+	if (classification == AssParameterClass::ALPHA) {
+		auto text = GetText();
+		return with_c_str(agi::StringRange(std::find_if(text.begin(), text.end(), isxdigit), text.end()), [](const char *str) {
+			return mid<int>(0, strtol(str, nullptr, 16), 255);
+		});
+	}
+	if (omitted) throw agi::InternalError("AssParsedText::Param::Get() called on omitted parameter");
+	return with_c_str(GetText(), atoi);
+}
+
+template<> double AssParsedText::Param::Get<double>() const {
+	if (omitted) throw agi::InternalError("AssParsedText::Param::Get() called on omitted parameter");
+	return with_c_str(GetText(), atof);
+}
+
+template<> float AssParsedText::Param::Get<float>() const {
+	return Get<double>();
+}
+
+template<> bool AssParsedText::Param::Get<bool>() const {
+	return Get<int>() != 0;
+}
+
+template<> agi::Color AssParsedText::Param::Get<agi::Color>() const {
+	return Get<std::string>();
+}
+
+agi::StringRange AssParsedText::Tag::Name() const {
+	if (node->extra < 0)
+		return parsed->Range(*node);
+	std::string const& name = proto[node->extra].name;
+	return agi::StringRange(name.begin(), name.end());
+}
+
+bool AssParsedText::Tag::Is(const char *name) const {
+	auto tag_name = Name();
+	size_t len = strlen(name);
+	return tag_name.size() == len && std::equal(tag_name.begin(), tag_name.end(), name);
+}
+
+AssParsedText::AssParsedText(boost::flyweight<std::string> const& line_text)
+: text(line_text)
+{
+	std::string const& str = text.get();
+	if (str.empty()) {
+		nodes.push_back(Node{0, 0, 1, 0, static_cast<uint8_t>(AssBlockType::PLAIN), 0, false});
+		return;
+	}
+
+	// Every brace can start at most two blocks, every tag needs either a
+	// brace or a backslash, and no tag has more than seven parameters, so
+	// this is always enough to never need to grow the array
+	size_t braces = std::count(str.begin(), str.end(), '{');
+	size_t slashes = std::count(str.begin(), str.end(), '\\');
+	nodes.reserve(2 * braces + 1 + 8 * (braces + slashes));
+
+	int drawing_level = 0;
+	for (size_t len = str.size(), cur = 0; cur < len; ) {
+		// Overrides block, which VSFilter requires to be closed
+		if (str[cur] == '{') {
+			size_t end = str.find('}', cur);
+			if (end != std::string::npos) {
+				size_t begin = cur + 1;
+				cur = end + 1;
+
+				if (end > begin && std::find(str.begin() + begin, str.begin() + end, '\\') == str.begin() + end) {
+					// No backslashes, so it's a comment
+					nodes.push_back(Node{uint32_t(begin - 1), uint32_t(end + 1), 1, 0, static_cast<uint8_t>(AssBlockType::COMMENT), 0, false});
+					continue;
+				}
+
+				size_t block = nodes.size();
+				nodes.push_back(Node{uint32_t(begin), uint32_t(end), 0, 0, static_cast<uint8_t>(AssBlockType::OVERRIDE), 0, false});
+
+				split_tags(agi::StringRange(str.begin() + begin, str.begin() + end), [&](agi::StringRange tag) {
+					AddTag(tag.begin() - str.begin(), tag.end() - str.begin(), drawing_level);
+				});
+
+				nodes[block].count = nodes.size() - block;
+				continue;
+			}
+		}
+
+		// Plain-text/drawing block
+		size_t end = std::min(str.find('{', cur + 1), len);
+		auto type = drawing_level == 0 ? AssBlockType::PLAIN : AssBlockType::DRAWING;
+		nodes.push_back(Node{uint32_t(cur), uint32_t(end), 1, drawing_level, static_cast<uint8_t>(type), 0, false});
+		cur = end;
+	}
+}
+
+void AssParsedText::AddTag(size_t begin, size_t end, int& drawing_level) {
+	auto str_begin = text.get().begin();
+	auto tag_text = agi::StringRange(str_begin + begin, str_begin + end);
+
+	size_t tag = nodes.size();
+	auto proto_it = find_proto(tag_text);
+	if (proto_it == proto.end()) {
+		// Junk tag
+		nodes.push_back(Node{uint32_t(begin), uint32_t(end), 0, -1, 0, 0, false});
+		return;
+	}
+
+	nodes.push_back(Node{uint32_t(begin), uint32_t(end), 0, 0, 0, 0, false});
+	proto_it = match_parameters(agi::StringRange(tag_text.begin() + proto_it->name.size(), tag_text.end()), proto_it,
+		[&](AssOverrideParamProto const& param_proto, agi::StringRange const *param) {
+			Node node{0, 0, 0, 0, static_cast<uint8_t>(param_proto.type), static_cast<uint8_t>(param_proto.classification), true};
+			if (param) {
+				node.begin = uint32_t(param->begin() - str_begin);
+				node.end = uint32_t(param->end() - str_begin);
+				node.omitted = false;
+			}
+			nodes.push_back(node);
+		});
+	nodes[tag].extra = int32_t(proto_it - proto.begin());
+	nodes[tag].count = nodes.size() - tag - 1;
+
+	if (proto_it->name == "\\p")
+		drawing_level = Param(this, &nodes[tag + 1]).Get<int>(0);
+}
+
+std::vector<std::unique_ptr<AssDialogueBlock>> AssParsedText::MakeBlocks() const {
+	std::vector<std::unique_ptr<AssDialogueBlock>> blocks;
+	blocks.reserve(nodes.size());
+	ForEachBlock([&](Block block) {
+		auto text = block.GetText();
+		switch (block.GetType()) {
+		case AssBlockType::PLAIN:
+			blocks.push_back(agi::make_unique<AssDialogueBlockPlain>(agi::str(text)));
+			break;
+		case AssBlockType::DRAWING:
+			blocks.push_back(agi::make_unique<AssDialogueBlockDrawing>(agi::str(text), block.GetScale()));
+			break;
+		case AssBlockType::COMMENT:
+			// The block's text has the braces, which the comment block adds back
+			blocks.push_back(agi::make_unique<AssDialogueBlockComment>(std::string(text.begin() + 1, text.end() - 1)));
+			break;
+		case AssBlockType::OVERRIDE: {
+			auto override_block = agi::make_unique<AssDialogueBlockOverride>(agi::str(text));
+			block.ForEachTag([&](Tag tag) {
+				override_block->Tags.emplace_back();
+				auto& out = override_block->Tags.back();
+				out.Name = agi::str(tag.Name());
+				if (!tag.IsValid()) return;
+
+				out.valid = true;
+				auto params = tag.GetParams();
+				out.Params.reserve(params.size());
+				for (size_t i = 0; i < params.size(); ++i) {
+					auto param = params[i];
+					out.Params.emplace_back(param.GetType(), param.classification);
+					if (!param.omitted)
+						out.Params.back().Set(agi::str(param.GetText()));
+				}
+			});
+			blocks.push_back(std::move(override_block));
+			break;
+		}
+		}
+	});
+	return blocks;
+}
+
+AssParsedText::Params AssParsedText::FindTag(const char *name) const {
+	for (size_t i = 0; i < nodes.size(); i += nodes[i].count) {
+		if (nodes[i].type != static_cast<uint8_t>(AssBlockType::OVERRIDE)) continue;
+		for (Node const *tag = &nodes[i] + 1, *end = &nodes[i] + nodes[i].count; tag < end; tag += tag->count + 1) {
+			if (Tag(this, tag).Is(name))
+				return Tag(this, tag).GetParams();
+		}
+	}
+	return Params();
+}
@@ -88,6 +88,7 @@ public:
 };
 
 class AssOverrideTag {
+	friend class AssParsedText;
 	bool valid = false;
 
 public:
@@ -0,0 +1,171 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file ass_parsed_text.h
+/// @see ass_override.cpp
+/// @ingroup subs_storage
+
+#pragma once
+
+#include "ass_dialogue.h"
+
+#include <libaegisub/split.h>
+
+#include <cstdint>
+
+/// @class AssParsedText
+/// @brief Read-only parse of a line's text into blocks, tags and parameters
+///
+/// AssDialogue::ParseTags builds a separately allocated object for every
+/// block, tag and parameter so that they can be edited and written back.
+/// Code which only needs to look at the tags can use this instead. All of
+/// the blocks, tags and parameters are stored in preorder in a single
+/// array and refer to the text by offsets, so a parse makes one allocation.
+/// The text is shared with the line rather than copied, and the parse stays
+/// valid even if the line is later changed.
+///
+/// AssDialogue::ParseTags builds its blocks from this parse with MakeBlocks,
+/// so the two can't disagree about where blocks, tags and parameters are.
+/// The parameters of \\t are not parsed further here; MakeBlocks leaves that
+/// to AssOverrideParameter as before.
+///
+/// Callers which edit the tags and write them back still need the blocks
+/// from ParseTags and have deliberately not been moved to this:
+/// resolution_resampler.cpp, export_framerate.cpp, ass_karaoke.cpp,
+/// command/edit.cpp, dialog_translation.cpp, dialog_style_editor.cpp,
+/// VisualTool::SetOverride and the SRT and EBU 3264 subtitle formats.
+class AssParsedText {
+	struct Node {
+		/// Offsets of the node's text
+		uint32_t begin;
+		uint32_t end;
+		/// For blocks, the number of nodes in the block including itself;
+		/// for tags, the number of parameters
+		uint32_t count;
+		/// For drawing blocks, the scale; for tags, the tag prototype's
+		/// index or -1 for junk tags
+		int32_t extra;
+		uint8_t type;
+		uint8_t classification;
+		bool omitted;
+	};
+
+	boost::flyweight<std::string> text;
+	std::vector<Node> nodes;
+
+	/// Parse the tag in [begin, end) and its parameters
+	void AddTag(size_t begin, size_t end, int& drawing_level);
+
+	agi::StringRange Range(Node const& node) const {
+		return agi::StringRange(text.get().begin() + node.begin, text.get().begin() + node.end);
+	}
+
+public:
+	/// A single parameter to an override tag
+	class Param {
+		AssParsedText const *parsed;
+		Node const *node;
+	public:
+		Param(AssParsedText const *parsed, Node const *node)
+		: parsed(parsed), node(node)
+		, omitted(node->omitted)
+		, classification(static_cast<AssParameterClass>(node->classification))
+		{ }
+
+		/// Is this parameter actually present?
+		bool omitted;
+		/// Type of parameter
+		AssParameterClass classification;
+
+		VariableDataType GetType() const { return static_cast<VariableDataType>(node->type); }
+		/// Text of the parameter, or an empty range if it's omitted
+		agi::StringRange GetText() const { return parsed->Range(*node); }
+		template<class T> T Get() const;
+		template<class T> T Get(T def) const {
+			return !omitted ? Get<T>() : def;
+		}
+	};
+
+	/// The parameters of a tag. A default-constructed Params refers to no
+	/// tag at all and is false.
+	class Params {
+		AssParsedText const *parsed = nullptr;
+		Node const *first = nullptr;
+		size_t count = 0;
+	public:
+		Params() = default;
+		Params(AssParsedText const *parsed, Node const *first, size_t count)
+		: parsed(parsed), first(first), count(count) { }
+
+		explicit operator bool() const { return parsed != nullptr; }
+		size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+		Param operator[](size_t i) const { return Param(parsed, first + i); }
+		Param front() const { return (*this)[0]; }
+	};
+
+	/// A tag in an override block
+	class Tag {
+		AssParsedText const *parsed;
+		Node const *node;
+	public:
+		Tag(AssParsedText const *parsed, Node const *node) : parsed(parsed), node(node) { }
+
+		bool IsValid() const { return node->extra >= 0; }
+		/// Name of the tag with the slash, or all of its text if it's not valid
+		agi::StringRange Name() const;
+		/// Does this tag have the given name?
+		bool Is(const char *name) const;
+		Params GetParams() const { return Params(parsed, node + 1, node->count); }
+	};
+
+	/// A block of the text
+	class Block {
+		AssParsedText const *parsed;
+		Node const *node;
+	public:
+		Block(AssParsedText const *parsed, Node const *node) : parsed(parsed), node(node) { }
+
+		AssBlockType GetType() const { return static_cast<AssBlockType>(node->type); }
+		/// Text of the block. This has the braces for comments but not for
+		/// override blocks.
+		agi::StringRange GetText() const { return parsed->Range(*node); }
+		/// Scale of drawing blocks
+		int GetScale() const { return node->extra; }
+		/// Call func with each of the tags of an override block
+		template<typename Func>
+		void ForEachTag(Func&& func) const {
+			for (Node const *tag = node + 1, *end = node + node->count; tag < end; tag += tag->count + 1)
+				func(Tag(parsed, tag));
+		}
+	};
+
+	AssParsedText(boost::flyweight<std::string> const& text);
+
+	/// Call func with each of the blocks
+	template<typename Func>
+	void ForEachBlock(Func&& func) const {
+		for (size_t i = 0; i < nodes.size(); i += nodes[i].count)
+			func(Block(this, &nodes[i]));
+	}
+
+	/// Get the parameters of the first tag with the given name in any of the
+	/// override blocks, or an empty Params if there's no such tag
+	Params FindTag(const char *name) const;
+
+	/// Build editable blocks from this parse, for AssDialogue::ParseTags
+	std::vector<std::unique_ptr<AssDialogueBlock>> MakeBlocks() const;
+};
@@ -118,15 +118,18 @@ void AssParser::ParseAttachmentLine(std::string const& data) {
 
 	// Data is over, add attachment to the file
 	if (!valid_data || is_filename) {
-		target->Attachments.push_back(*attach.release());
+		target->Attachments.push_back(*attach);
+		attach.reset();
 		AddLine(data);
 	}
 	else {
 		attach->AddData(data);
 
 		// Done building
-		if (data.size() < 80)
-			target->Attachments.push_back(*attach.release());
+		if (data.size() < 80) {
+			target->Attachments.push_back(*attach);
+			attach.reset();
+		}
 	}
 }
 
@@ -40,4 +40,7 @@ public:
 	~AssParser();
 
 	void AddLine(std::string const& data);
+
+	/// Are lines currently being added to the [Events] section?
+	bool InEvents() const { return !attach && state == &AssParser::ParseEventLine; }
 };
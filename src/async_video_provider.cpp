@@ -30,32 +30,46 @@
 #else
 #include <boost/gil/gil_all.hpp>
 #endif
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 enum {
 	NEW_SUBS_FILE = -1,
 	SUBS_FILE_ALREADY_LOADED = -2
 };
 
-std::shared_ptr<VideoFrame> AsyncVideoProvider::ProcFrame(int frame_number, double time, bool raw) {
-	// Find an unused buffer to use or allocate a new one if needed
-	std::shared_ptr<VideoFrame> frame;
-	for (auto& buffer : buffers) {
-		if (buffer.use_count() == 1) {
-			frame = buffer;
-			break;
-		}
-	}
-
-	if (!frame) {
-		frame = std::make_shared<VideoFrame>();
-		buffers.push_back(frame);
-	}
+namespace {
+/// Number of frames to render ahead of the requested one
+const int prefetch_count = 4;
+/// Largest forward step which is treated as playback or frame stepping
+/// rather than a seek, as playback drops frames when it can't keep up
+const int max_sequential_step = 3;
+}
 
+std::shared_ptr<const VideoFrame> AsyncVideoProvider::ProcFrame(int frame_number, double time, bool raw) {
+	std::shared_ptr<const VideoFrame> shared;
 	try {
-		source_provider->GetFrame(frame_number, *frame);
+		shared = source_provider->GetSharedFrame(frame_number);
 	}
 	catch (VideoProviderError const& err) { throw VideoProviderErrorEvent(err); }
 
+	// Frames from the cache can be passed on as is if nothing is going to be
+	// drawn on them
+	if (shared && (raw || !subs_provider || !subs)) return shared;
+
+	// The pixel data is drawn from the frame pool, so once playback has
+	// warmed it up this reuses the block of a frame which is no longer in use
+	auto frame = std::make_shared<VideoFrame>();
+	if (shared)
+		*frame = *shared;
+	else {
+		try {
+			source_provider->GetFrame(frame_number, *frame);
+		}
+		catch (VideoProviderError const& err) { throw VideoProviderErrorEvent(err); }
+	}
+
 	if (raw || !subs_provider || !subs) return frame;
 
 	try {
@@ -93,7 +107,8 @@ VideoFrame AsyncVideoProvider::GetBlankFrame(bool white) {
 	result.height = GetHeight();
 	result.pitch = result.width * 4;
 	result.flipped = false;
-	result.data.resize(result.pitch * result.height, white ? 255 : 0);
+	result.data.resize(result.pitch * result.height);
+	memset(result.data.data(), white ? 255 : 0, result.data.size());
 	return result;
 }
 
@@ -151,6 +166,7 @@ AsyncVideoProvider::AsyncVideoProvider(agi::fs::path const& video_filename, std:
 , subs_provider(get_subs_provider(parent, br))
 , source_provider(VideoProviderFactory::GetProvider(video_filename, colormatrix, br))
 , parent(parent)
+, keyframes(source_provider->GetKeyFrames())
 {
 }
 
@@ -166,6 +182,7 @@ void AsyncVideoProvider::LoadSubtitles(const AssFile *new_subs) throw() {
 	worker->Async([=]{
 		subs.reset(copy);
 		single_frame = NEW_SUBS_FILE;
+		prefetched.clear();
 		ProcAsync(req_version, false);
 	});
 }
@@ -173,18 +190,26 @@ void AsyncVideoProvider::LoadSubtitles(const AssFile *new_subs) throw() {
 void AsyncVideoProvider::UpdateSubtitles(const AssFile *new_subs, const AssDialogue *changed) throw() {
 	uint_fast32_t req_version = ++version;
 
-	// Copy just the line which were changed, then replace the line at the
-	// same index in the worker's copy of the file with the new entry
-	auto copy = new AssDialogue(*changed);
+	// Copy just the line which was changed, then copy it over the line at the
+	// same index in the worker's copy of the file
+	AssDialogueBase copy = *changed;
 	worker->Async([=]{
-		int i = 0;
 		auto it = subs->Events.begin();
-		std::advance(it, copy->Row - i);
-		i = copy->Row;
-		subs->Events.insert(it, *copy);
-		delete &*it--;
-
-		single_frame = NEW_SUBS_FILE;
+		std::advance(it, copy.Row);
+
+		// The worker's line keeps its own Id, which is what the renderer
+		// knows it by
+		const int id = it->Id;
+		if (it->Start != copy.Start || it->End != copy.End)
+			subs->InvalidateTimeIndex();
+		static_cast<AssDialogueBase&>(*it) = copy;
+		it->Id = id;
+		prefetched.clear();
+
+		// If the renderer can update the line in place there's no need to
+		// hand it the whole file again
+		if (single_frame == NEW_SUBS_FILE || !subs_provider || !subs_provider->UpdateLine(*it))
+			single_frame = NEW_SUBS_FILE;
 		ProcAsync(req_version, true);
 	});
 }
@@ -193,15 +218,102 @@ void AsyncVideoProvider::RequestFrame(int new_frame, double new_time) throw() {
 	uint_fast32_t req_version = ++version;
 
 	worker->Async([=]{
+		PredictFrames(frame_number, new_frame);
 		time = new_time;
 		frame_number = new_frame;
 		ProcAsync(req_version, false);
+		Prefetch(req_version);
 	});
 }
 
+void AsyncVideoProvider::PredictFrames(int prev_frame, int new_frame) {
+	// Re-requesting the same frame doesn't say anything new
+	if (new_frame == prev_frame) return;
+
+	predicted.clear();
+
+	if (prev_frame >= 0 && timecodes.IsLoaded()) {
+		int step = new_frame - prev_frame;
+		if (step > 0 && step <= max_sequential_step) {
+			// Playing or stepping forwards
+			for (int i = 1; i <= prefetch_count && new_frame + i < GetFrameCount(); ++i)
+				predicted.push_back(new_frame + i);
+		}
+		else if (step == -1) {
+			// Stepping backwards
+			for (int i = 1; i <= prefetch_count && new_frame - i >= 0; ++i)
+				predicted.push_back(new_frame - i);
+		}
+		else {
+			// Check for seeking to the next or previous keyframe, i.e. the new
+			// frame is a keyframe and there are none in between the two
+			auto it = lower_bound(begin(keyframes), end(keyframes), new_frame);
+			if (it != end(keyframes) && *it == new_frame) {
+				if (step > 0 && (it == begin(keyframes) || *(it - 1) <= prev_frame)) {
+					for (int i = 1; i <= prefetch_count && it + i < end(keyframes); ++i)
+						predicted.push_back(*(it + i));
+				}
+				else if (step < 0 && (it + 1 == end(keyframes) || *(it + 1) >= prev_frame)) {
+					for (int i = 1; i <= prefetch_count && it - i >= begin(keyframes); ++i)
+						predicted.push_back(*(it - i));
+				}
+			}
+		}
+	}
+
+	// Drop prefetched frames which aren't going to be wanted
+	prefetched.erase(remove_if(begin(prefetched), end(prefetched), [&](PrefetchedFrame const& pf) {
+		return pf.frame != new_frame && find(begin(predicted), end(predicted), pf.frame) == end(predicted);
+	}), end(prefetched));
+}
+
+std::shared_ptr<const VideoFrame> AsyncVideoProvider::TakePrefetched(int frame, double time) {
+	for (auto it = begin(prefetched); it != end(prefetched); ++it) {
+		if (it->frame == frame && it->time == time) {
+			auto image = std::move(it->image);
+			prefetched.erase(it);
+			return image;
+		}
+	}
+	return nullptr;
+}
+
+void AsyncVideoProvider::Prefetch(uint_fast32_t req_version) {
+	// Any new request or change makes the predictions stale. The requests
+	// which come in while stepping or playing make new predictions, and
+	// frames which were already rendered and are still wanted are kept.
+	if (req_version < version) return;
+
+	// While only the lines visible on one frame are loaded, rendering any
+	// other frame would load the entire file and undo the cheap path used
+	// while editing, so leave that to the first real request for another frame
+	if (subs_provider && subs && single_frame != SUBS_FILE_ALREADY_LOADED) return;
+
+	for (int frame : predicted) {
+		auto it = find_if(begin(prefetched), end(prefetched), [=](PrefetchedFrame const& pf) {
+			return pf.frame == frame;
+		});
+		if (it != end(prefetched)) continue;
+
+		double frame_time = timecodes.TimeAtFrame(frame);
+		try {
+			prefetched.push_back(PrefetchedFrame{frame, frame_time, ProcFrame(frame, frame_time)});
+		}
+		catch (wxEvent const&) {
+			// Errors are reported if and when the frame is actually requested
+			return;
+		}
+
+		// Render just one frame per job so that real requests which come in
+		// meanwhile don't have to wait for all of the predicted frames
+		worker->Async([=] { Prefetch(req_version); });
+		return;
+	}
+}
+
 bool AsyncVideoProvider::NeedUpdate(std::vector<AssDialogueBase const*> const& visible_lines) {
 	// Always need to render after a seek
-	if (single_frame != NEW_SUBS_FILE || frame_number != last_rendered)
+	if (frame_number != last_rendered)
 		return true;
 
 	// Obviously need to render if the number of visible lines has changed
@@ -233,9 +345,9 @@ void AsyncVideoProvider::ProcAsync(uint_fast32_t req_version, bool check_updated
 	if (req_version < version || frame_number < 0) return;
 
 	std::vector<AssDialogueBase const*> visible_lines;
-	for (auto const& line : subs->Events) {
-		if (!line.Comment && !(line.Start > time || line.End <= time))
-			visible_lines.push_back(&line);
+	for (auto line : subs->LinesAt(static_cast<int>(std::floor(time)))) {
+		if (!line->Comment)
+			visible_lines.push_back(line);
 	}
 
 	if (check_updated && !NeedUpdate(visible_lines)) return;
@@ -247,7 +359,10 @@ void AsyncVideoProvider::ProcAsync(uint_fast32_t req_version, bool check_updated
 	last_rendered = frame_number;
 
 	try {
-		FrameReadyEvent *evt = new FrameReadyEvent(ProcFrame(frame_number, time), time);
+		auto frame = TakePrefetched(frame_number, time);
+		if (!frame)
+			frame = ProcFrame(frame_number, time);
+		FrameReadyEvent *evt = new FrameReadyEvent(std::move(frame), time);
 		evt->SetEventType(EVT_FRAME_READY);
 		parent->QueueEvent(evt);
 	}
@@ -257,14 +372,24 @@ void AsyncVideoProvider::ProcAsync(uint_fast32_t req_version, bool check_updated
 	}
 }
 
-std::shared_ptr<VideoFrame> AsyncVideoProvider::GetFrame(int frame, double time, bool raw) {
-	std::shared_ptr<VideoFrame> ret;
+std::shared_ptr<const VideoFrame> AsyncVideoProvider::GetFrame(int frame, double time, bool raw) {
+	std::shared_ptr<const VideoFrame> ret;
 	worker->Sync([&]{ ret = ProcFrame(frame, time, raw); });
 	return ret;
 }
 
 void AsyncVideoProvider::SetColorSpace(std::string const& matrix) {
-	worker->Async([=] { source_provider->SetColorSpace(matrix); });
+	worker->Async([=] {
+		source_provider->SetColorSpace(matrix);
+		prefetched.clear();
+	});
+}
+
+void AsyncVideoProvider::SetTimecodes(agi::vfr::Framerate const& fps) {
+	worker->Async([=] {
+		timecodes = fps;
+		prefetched.clear();
+	});
 }
 
 wxDEFINE_EVENT(EVT_FRAME_READY, FrameReadyEvent);
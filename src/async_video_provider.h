@@ -67,7 +67,7 @@ class AsyncVideoProvider {
 	/// lines have actually changed
 	bool NeedUpdate(std::vector<AssDialogueBase const*> const& visible_lines);
 
-	std::shared_ptr<VideoFrame> ProcFrame(int frame, double time, bool raw = false);
+	std::shared_ptr<const VideoFrame> ProcFrame(int frame, double time, bool raw = false);
 
 	/// Produce a frame if req_version is still the current version
 	void ProcAsync(uint_fast32_t req_version, bool check_updated);
@@ -76,7 +76,30 @@ class AsyncVideoProvider {
 	/// they can be rendered
 	std::atomic<uint_fast32_t> version{ 0 };
 
-	std::vector<std::shared_ptr<VideoFrame>> buffers;
+	/// A frame which was rendered before it was requested
+	struct PrefetchedFrame {
+		int frame;
+		double time;
+		std::shared_ptr<const VideoFrame> image;
+	};
+
+	/// Timecodes used to work out the times of frames which haven't been
+	/// requested yet
+	agi::vfr::Framerate timecodes;
+	/// Keyframes of the video, for guessing where keyframe seeking will go
+	std::vector<int> keyframes;
+	/// Frames which are expected to be requested soon, in order
+	std::vector<int> predicted;
+	/// Frames which have been rendered ahead of time
+	std::vector<PrefetchedFrame> prefetched;
+
+	/// Guess which frames will be requested next based on the last two requests
+	void PredictFrames(int prev_frame, int new_frame);
+	/// Remove a prefetched frame from the cache if there is one
+	std::shared_ptr<const VideoFrame> TakePrefetched(int frame, double time);
+	/// Render the next predicted frame if req_version is still the current
+	/// version, and queue rendering the one after that
+	void Prefetch(uint_fast32_t req_version);
 
 	// Returns a monochromatic frame with the current dimensions
 	VideoFrame GetBlankFrame(bool white);
@@ -109,7 +132,7 @@ public:
 	/// @brief frame Frame number
 	/// @brief time  Exact start time of the frame in seconds
 	/// @brief raw   Get raw frame without subtitles
-	std::shared_ptr<VideoFrame> GetFrame(int frame, double time, bool raw = false);
+	std::shared_ptr<const VideoFrame> GetFrame(int frame, double time, bool raw = false);
 
 	/// @brief Synchronously get the subtitles with transparent background
 	/// @brief time  Exact start time of the frame in seconds
@@ -123,6 +146,10 @@ public:
 	/// Ask the video provider to change YCbCr matricies
 	void SetColorSpace(std::string const& matrix);
 
+	/// Set the timecodes which are used to calculate the times of frames
+	/// rendered before they are requested
+	void SetTimecodes(agi::vfr::Framerate const& fps);
+
 	int GetFrameCount() const             { return source_provider->GetFrameCount(); }
 	int GetWidth() const                  { return source_provider->GetWidth(); }
 	int GetHeight() const                 { return source_provider->GetHeight(); }
@@ -135,6 +162,7 @@ public:
 	std::string GetDecoderName() const    { return source_provider->GetDecoderName(); }
 	bool ShouldSetVideoProperties() const { return source_provider->ShouldSetVideoProperties(); }
 	bool HasAudio() const                 { return source_provider->HasAudio(); }
+	VideoCacheStats GetCacheStats() const { return source_provider->GetCacheStats(); }
 
 	/// @brief Constructor
 	/// @param videoFileName File to open
@@ -146,11 +174,11 @@ public:
 /// Event which signals that a requested frame is ready
 struct FrameReadyEvent final : public wxEvent {
 	/// Frame which is ready
-	std::shared_ptr<VideoFrame> frame;
+	std::shared_ptr<const VideoFrame> frame;
 	/// Time which was used for subtitle rendering
 	double time;
 	wxEvent *Clone() const override { return new FrameReadyEvent(*this); };
-	FrameReadyEvent(std::shared_ptr<VideoFrame> frame, double time)
+	FrameReadyEvent(std::shared_ptr<const VideoFrame> frame, double time)
 	: frame(std::move(frame)), time(time) { }
 };
 
@@ -136,6 +136,7 @@ void AudioController::PlayRange(const TimeRange &range)
 {
 	if (!player) return;
 
+	provider->PrioritizeDecoding(SamplesFromMilliseconds(range.begin()));
 	player->Play(SamplesFromMilliseconds(range.begin()), SamplesFromMilliseconds(range.length()));
 	playback_mode = PM_Range;
 	playback_timer.Start(20);
@@ -162,6 +163,7 @@ void AudioController::PlayToEnd(int start_ms)
 	if (!player) return;
 
 	int64_t start_sample = SamplesFromMilliseconds(start_ms);
+	provider->PrioritizeDecoding(start_sample);
 	player->Play(start_sample, provider->GetNumSamples()-start_sample);
 	playback_mode = PM_ToEnd;
 	playback_timer.Start(20);
@@ -49,6 +49,7 @@
 #include <libaegisub/make_unique.h>
 
 #include <algorithm>
+#include <cmath>
 
 #include <wx/dcbuffer.h>
 #include <wx/mousestate.h>
@@ -626,6 +627,8 @@ void AudioDisplay::ScrollPixelToLeft(int pixel_position)
 	scroll_left = pixel_position;
 	scrollbar->SetPosition(scroll_left);
 	timeline->SetPosition(scroll_left);
+	if (provider)
+		provider->PrioritizeDecoding(controller->SamplesFromMilliseconds(TimeFromRelativeX(0)));
 	Refresh();
 }
 
@@ -769,10 +772,23 @@ void AudioDisplay::ReloadRenderingSettings()
 			spectrum_fref_pos [spectrum_freq_curve]
 		);
 
+		spectrum_ready_connection = audio_spectrum_renderer->AddBlocksReadyListener([=](int64_t start, int64_t end) {
+			audio_renderer->Invalidate(start, end);
+			if (!provider) return;
+
+			// Only redraw the part of the view showing the new data
+			const double samples_per_pixel = ms_per_pixel * provider->GetSampleRate() / 1000.0;
+			const int x1 = std::max(0, int(start / samples_per_pixel) - scroll_left);
+			const int x2 = std::min(GetClientSize().GetWidth(), int(std::ceil(end / samples_per_pixel)) - scroll_left + 1);
+			if (x1 < x2)
+				RefreshRect(wxRect(x1, audio_top, x2 - x1, audio_height), false);
+		});
+
 		audio_renderer_provider = std::move(audio_spectrum_renderer);
 	}
 	else
 	{
+		spectrum_ready_connection.Disconnect();
 		colour_scheme_name = OPT_GET("Colour/Audio Display/Waveform")->GetString();
 		audio_renderer_provider = agi::make_unique<AudioWaveformRenderer>(colour_scheme_name);
 	}
@@ -796,16 +812,18 @@ void AudioDisplay::OnLoadTimer(wxTimerEvent&)
 		const int64_t new_decoded_count = provider->GetDecodedSamples();
 		if (new_decoded_count != last_sample_decoded)
 			audio_load_speed = (audio_load_speed + (double)new_decoded_count / elapsed) / 2;
-		if (audio_load_speed == 0) return;
-
-		int new_pos = AbsoluteXFromTime(elapsed * audio_load_speed * 1000.0 / provider->GetSampleRate());
-		if (new_pos > audio_load_position)
-			audio_load_position = new_pos;
+		if (audio_load_speed != 0)
+		{
+			int new_pos = AbsoluteXFromTime(elapsed * audio_load_speed * 1000.0 / provider->GetSampleRate());
+			if (new_pos > audio_load_position)
+				audio_load_position = new_pos;
+		}
 
 		const double left = last_sample_decoded * 1000.0 / provider->GetSampleRate() / ms_per_pixel;
-		const double right = new_decoded_count * 1000.0 / provider->GetSampleRate() / ms_per_pixel;
 
-		if (left < scroll_left + pixel_audio_width && right >= scroll_left)
+		// Audio past the contiguously decoded part may have been decoded out
+		// of order, so anything in view which wasn't decoded may have changed
+		if (left < scroll_left + GetClientSize().GetWidth())
 			Refresh();
 		else
 			RefreshRect(scrollbar->GetBounds());
@@ -73,6 +73,9 @@ class AudioDisplay: public wxWindow {
 	/// The current audio renderer
 	std::unique_ptr<AudioRendererBitmapProvider> audio_renderer_provider;
 
+	/// Redraws when the spectrum renderer has computed more data
+	agi::signal::Connection spectrum_ready_connection;
+
 	/// The controller managing us
 	AudioController *controller = nullptr;
 
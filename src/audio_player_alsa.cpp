@@ -41,6 +41,7 @@
 #include "options.h"
 
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/audio/read_ahead.h>
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
 
@@ -85,14 +86,16 @@ class AlsaPlayer final : public AudioPlayer {
 	int64_t last_position = 0;
 	clock::time_point last_position_time;
 
-	std::vector<char> decode_buffer;
-
 	std::thread thread;
 
 	snd_pcm_format_t GetPCMFormat(const agi::AudioProvider *provider);
 
 	void PlaybackThread();
 
+	/// Write up to frames frames of the audio which has been decoded ahead
+	/// @return Number of frames written, or a negative value on error
+	snd_pcm_sframes_t WriteFrames(snd_pcm_t *pcm, agi::AudioReadAhead& reader, snd_pcm_sframes_t frames);
+
 	void UpdatePlaybackPosition(snd_pcm_t *pcm, int64_t position)
 	{
 		snd_pcm_sframes_t delay;
@@ -148,6 +151,34 @@ snd_pcm_format_t AlsaPlayer::GetPCMFormat(const agi::AudioProvider *provider) {
 	}
 }
 
+snd_pcm_sframes_t AlsaPlayer::WriteFrames(snd_pcm_t *pcm, agi::AudioReadAhead& reader, snd_pcm_sframes_t frames)
+{
+	snd_pcm_sframes_t total = 0;
+	while (total < frames)
+	{
+		// Written straight from the ring buffer, which may take two writes
+		// if the audio wraps around its end
+		const void *data;
+		auto count = std::min<snd_pcm_sframes_t>(reader.Peek(&data), frames - total);
+		if (count <= 0)
+			break;
+
+		snd_pcm_sframes_t written = snd_pcm_writei(pcm, data, count);
+		if (written == -ESTRPIPE || written == -EPIPE)
+			snd_pcm_recover(pcm, written, 0);
+		else if (written == 0)
+			break;
+		else if (written < 0)
+			return written;
+		else
+		{
+			reader.Consume(written);
+			total += written;
+		}
+	}
+	return total;
+}
+
 void AlsaPlayer::PlaybackThread()
 {
 	std::unique_lock<std::mutex> lock(mutex);
@@ -171,7 +202,9 @@ do_setup:
 		return;
 	LOG_D("audio/player/alsa") << "set pcm params";
 
-	size_t framesize = fallback_mono16 ? sizeof(int16_t) : provider->GetChannels() * provider->GetBytesPerSample();
+	// Decoding happens on the reader's thread so that a slow read from the
+	// provider doesn't starve the device
+	agi::AudioReadAhead reader(*provider, fallback_mono16);
 
 	while (true)
 	{
@@ -189,32 +222,21 @@ do_setup:
 		message = Message::None;
 
 		LOG_D("audio/player/alsa") << "starting playback";
-		int64_t position = start_position;
+		reader.SetVolume(volume);
+		reader.SetEnd(end_position);
+		reader.Seek(start_position);
 
 		// Initial buffer-fill
 		{
-			auto avail = std::min(snd_pcm_avail(pcm), (snd_pcm_sframes_t)(end_position-position));
-			decode_buffer.resize(avail * framesize);
-			if (fallback_mono16) {
-				provider->GetInt16MonoAudioWithVolume(reinterpret_cast<int16_t*>(decode_buffer.data()), position, avail, volume);
-			} else {
-				provider->GetAudioWithVolume(decode_buffer.data(), position, avail, volume);
-			}
-
-			snd_pcm_sframes_t written = 0;
-			while (written <= 0)
+			auto avail = std::min(snd_pcm_avail(pcm), (snd_pcm_sframes_t)(end_position-start_position));
+			reader.Wait(avail, std::chrono::seconds(1));
+			if (WriteFrames(pcm, reader, avail) < 0)
 			{
-				written = snd_pcm_writei(pcm, decode_buffer.data(), avail);
-				if (written == -ESTRPIPE)
-					snd_pcm_recover(pcm, written, 0);
-				else if (written <= 0)
-				{
-					LOG_D("audio/player/alsa") << "error filling buffer";
-					return;
-				}
+				LOG_D("audio/player/alsa") << "error filling buffer";
+				return;
 			}
-			position += written;
 		}
+		int64_t position = reader.GetPosition();
 
 		// Start playback
 		LOG_D("audio/player/alsa") << "initial buffer filled, hitting start";
@@ -242,6 +264,9 @@ do_setup:
 				break;
 			}
 
+			reader.SetVolume(volume);
+			reader.SetEnd(end_position);
+
 			// Fill buffer
 			snd_pcm_sframes_t tmp_pcm_avail = snd_pcm_avail(pcm);
 			if (tmp_pcm_avail == -EPIPE)
@@ -257,29 +282,15 @@ do_setup:
 			if (avail < 0)
 				continue;
 
+			// Whatever has been decoded so far; if the reader has fallen
+			// behind the device underruns rather than this thread blocking
+			snd_pcm_sframes_t written = WriteFrames(pcm, reader, avail);
+			if (written < 0)
 			{
-				decode_buffer.resize(avail * framesize);
-				if (fallback_mono16) {
-					provider->GetInt16MonoAudioWithVolume(reinterpret_cast<int16_t*>(decode_buffer.data()), position, avail, volume);
-				} else {
-					provider->GetAudioWithVolume(decode_buffer.data(), position, avail, volume);
-				}
-				snd_pcm_sframes_t written = 0;
-				while (written <= 0)
-				{
-					written = snd_pcm_writei(pcm, decode_buffer.data(), avail);
-					if (written == -ESTRPIPE || written == -EPIPE)
-						snd_pcm_recover(pcm, written, 0);
-					else if (written == 0)
-						break;
-					else if (written < 0)
-					{
-						LOG_D("audio/player/alsa") << "error filling buffer, written=" << written;
-						return;
-					}
-				}
-				position += written;
+				LOG_D("audio/player/alsa") << "error filling buffer, written=" << written;
+				return;
 			}
+			position = reader.GetPosition();
 
 			UpdatePlaybackPosition(pcm, position);
 
@@ -39,10 +39,12 @@
 #include "utils.h"
 
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/audio/read_ahead.h>
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
 
 #include <cstdio>
+#include <cstring>
 #include <pulse/pulseaudio.h>
 #include <wx/thread.h>
 
@@ -74,6 +76,10 @@ class PulseAudioPlayer final : public AudioPlayer {
 
 	int paerror = 0;
 
+	/// Audio decoded ahead of the stream's requests, so that the write
+	/// callback doesn't have to wait on the provider
+	std::unique_ptr<agi::AudioReadAhead> reader;
+
 	static void pa_setvolume_success(pa_context *c, int success, PulseAudioPlayer *thread);
 	/// Called by PA to notify about other context-related stuff
 	static void pa_context_notify(pa_context *c, PulseAudioPlayer *thread);
@@ -172,6 +178,8 @@ PulseAudioPlayer::PulseAudioPlayer(agi::AudioProvider *provider) : AudioPlayer(p
 	pa_channel_map_init_auto(&map, ss.channels, PA_CHANNEL_MAP_DEFAULT);
 	pa_cvolume_init(&volume);
 
+	reader = agi::make_unique<agi::AudioReadAhead>(*provider, fallback_mono16);
+
 	stream = pa_stream_new(context, "Sound", &ss, &map);
 	if (!stream) {
 		// argh!
@@ -236,16 +244,28 @@ void PulseAudioPlayer::Play(int64_t start,int64_t count)
 	cur_frame = start;
 	end_frame = start + count;
 
+	// The reader is only used from the mainloop thread other than here, so
+	// seeking with the mainloop locked keeps it to one consumer at a time
+	pa_threaded_mainloop_lock(mainloop);
+	reader->SetEnd(end_frame);
+	reader->Seek(start);
+	pa_threaded_mainloop_unlock(mainloop);
+	// Give the reader a moment to decode the start so that it isn't replaced
+	// by silence when the audio is already cached, but don't hold up the GUI
+	// for a slow read; the write callback keeps the stream going until the
+	// audio arrives
+	reader->Wait(provider->GetSampleRate() / 50, std::chrono::milliseconds(50));
+
 	is_playing = true;
 
 	play_start_time = 0;
 	pa_threaded_mainloop_lock(mainloop);
 	paerror = pa_stream_get_time(stream, (pa_usec_t*) &play_start_time);
-	pa_threaded_mainloop_unlock(mainloop);
 	if (paerror)
 		LOG_E("audio/player/pulse") << "Error getting stream time: " << pa_strerror(paerror) << "(" << paerror << ")";
 
 	PulseAudioPlayer::pa_stream_write(stream, pa_stream_writable_size(stream), this);
+	pa_threaded_mainloop_unlock(mainloop);
 
 	pa_threaded_mainloop_lock(mainloop);
 	pa_operation *op = pa_stream_trigger(stream, (pa_stream_success_cb_t)pa_stream_success, this);
@@ -283,6 +303,7 @@ void PulseAudioPlayer::Stop()
 void PulseAudioPlayer::SetEndPosition(int64_t pos)
 {
 	end_frame = pos;
+	reader->SetEnd(pos);
 }
 
 int64_t PulseAudioPlayer::GetCurrentPosition()
@@ -330,26 +351,38 @@ void PulseAudioPlayer::pa_stream_write(pa_stream *p, size_t length, PulseAudioPl
 		pa_operation *op = pa_stream_drain(p, nullptr, nullptr);
 		pa_operation_unref(op);
 		return;
+	}
+
+	// Fill PA's own buffer rather than allocating one for every request
+	void *buf;
+	size_t nbytes = length;
+	if (pa_stream_begin_write(p, &buf, &nbytes) || !buf)
+		return;
 
-	} else if (thread->cur_frame >= thread->end_frame) {
+	unsigned long bpf = thread->bpf;
+	unsigned long frames = nbytes / bpf;
+	if (frames == 0) {
+		pa_stream_cancel_write(p);
+		return;
+	}
+	if (thread->cur_frame >= thread->end_frame) {
 		// Past end of stream, but not a full second, add some silence
-		void *buf = calloc(length, 1);
-		::pa_stream_write(p, buf, length, free, 0, PA_SEEK_RELATIVE);
-		thread->cur_frame += length / thread->bpf;
+		memset(buf, 0, frames * bpf);
+		::pa_stream_write(p, buf, frames * bpf, nullptr, 0, PA_SEEK_RELATIVE);
+		thread->cur_frame += frames;
 		return;
 	}
 
-	unsigned long bpf = thread->bpf;
-	unsigned long frames = length / thread->bpf;
 	unsigned long maxframes = thread->end_frame - thread->cur_frame;
 	if (frames > maxframes) frames = maxframes;
-	void *buf = malloc(frames * bpf);
-	if (thread->fallback_mono16) {
-		thread->provider->GetInt16MonoAudio(reinterpret_cast<int16_t *>(buf), thread->cur_frame, frames);
-	} else {
-		thread->provider->GetAudio(buf, thread->cur_frame, frames);
-	}
-	::pa_stream_write(p, buf, frames*bpf, free, 0, PA_SEEK_RELATIVE);
+	// This runs on the mainloop thread, so it mustn't wait for the reader.
+	// If it has fallen behind, fill the rest of the request with silence and
+	// skip the audio it replaces, so that what's heard stays in step with
+	// the stream time GetCurrentPosition is based on.
+	auto read = thread->reader->Read(buf, frames);
+	memset(static_cast<char *>(buf) + read * bpf, 0, (frames - read) * bpf);
+	thread->reader->Skip(frames - read);
+	::pa_stream_write(p, buf, frames * bpf, nullptr, 0, PA_SEEK_RELATIVE);
 	thread->cur_frame += frames;
 }
 
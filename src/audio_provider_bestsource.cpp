@@ -33,28 +33,54 @@
 #include <libaegisub/background_runner.h>
 #include <libaegisub/log.h>
 
+#include <condition_variable>
 #include <map>
+#include <mutex>
 
 namespace {
+/// Most sources to open for decoding on several threads at once
+const size_t max_sources = 4;
+
 class BSAudioProvider final : public agi::AudioProvider {
+	agi::fs::path filename;
 	std::map<std::string, std::string> bsopts;
 	BestAudioSource bs;
 	AudioProperties properties;
 
+	/// Sources other than bs for the cache to decode with concurrently. A
+	/// BestAudioSource can only be used by one thread at a time, so each
+	/// read borrows one which isn't in use, opening another (from the index
+	/// already written by bs) if there are none.
+	mutable std::vector<std::unique_ptr<BestAudioSource>> extra_sources;
+	mutable std::vector<BestAudioSource *> idle_sources;
+	/// Number of sources either open or being opened, including bs
+	mutable size_t open_sources = 1;
+	mutable std::mutex sources_lock;
+	mutable std::condition_variable source_returned;
+	/// Configured maximum cache size, which is shared between all of the
+	/// open sources
+	int64_t max_cache_size;
+
+	BestAudioSource *AcquireSource() const;
+	void ReleaseSource(BestAudioSource *source) const;
+
 	void FillBuffer(void *Buf, int64_t Start, int64_t Count) const override;
 public:
 	BSAudioProvider(agi::fs::path const& filename, agi::BackgroundRunner *br);
 
 	bool NeedsCache() const override { return OPT_GET("Provider/Audio/BestSource/Aegisub Cache")->GetBool(); }
+	bool SupportsConcurrentReads() const override { return true; }
 };
 
 /// @brief Constructor
 /// @param filename The filename to open
 BSAudioProvider::BSAudioProvider(agi::fs::path const& filename, agi::BackgroundRunner *br) try
-: bsopts()
+: filename(filename)
+, bsopts()
 , bs(filename.string(), -1, -1, GetBSCacheFile(filename), &bsopts)
 {
-	bs.SetMaxCacheSize(OPT_GET("Provider/Audio/BestSource/Max Cache Size")->GetInt() << 20);
+	max_cache_size = OPT_GET("Provider/Audio/BestSource/Max Cache Size")->GetInt() << 20;
+	bs.SetMaxCacheSize(max_cache_size);
 	br->Run([&](agi::ProgressSink *ps) {
 		ps->SetTitle(from_wx(_("Exacting")));
 		ps->SetMessage(from_wx(_("Creating cache... This can take a while!")));
@@ -71,13 +97,69 @@ BSAudioProvider::BSAudioProvider(agi::fs::path const& filename, agi::BackgroundR
 	channels = properties.Channels;
 	num_samples = properties.NumSamples;
 	decoded_samples = OPT_GET("Provider/Audio/BestSource/Aegisub Cache")->GetBool() ? 0 : num_samples;
+	idle_sources.push_back(&bs);
 }
 catch (AudioException const& err) {
 	throw agi::AudioProviderError("Failed to create BestAudioSource");
 }
 
+BestAudioSource *BSAudioProvider::AcquireSource() const {
+	std::unique_lock<std::mutex> lock(sources_lock);
+	BestAudioSource *source = nullptr;
+	if (idle_sources.empty() && open_sources < max_sources) {
+		// Opened without holding the lock so that other threads can keep
+		// trading the sources which are already open
+		++open_sources;
+		lock.unlock();
+		std::unique_ptr<BestAudioSource> new_source;
+		try {
+			new_source = agi::make_unique<BestAudioSource>(filename.string(), -1, -1, GetBSCacheFile(filename), &bsopts);
+		}
+		catch (AudioException const&) {
+			LOG_D("bs") << "Failed to open another BestAudioSource, sharing the existing ones";
+		}
+		lock.lock();
+
+		// A failed slot stays counted so that opening isn't retried on every read
+		if (new_source) {
+			extra_sources.push_back(std::move(new_source));
+			source = extra_sources.back().get();
+		}
+	}
+
+	if (!source) {
+		source_returned.wait(lock, [&] { return !idle_sources.empty(); });
+		source = idle_sources.back();
+		idle_sources.pop_back();
+	}
+
+	// A single source gets the whole cache, and it's split evenly once
+	// others are opened for concurrent reads. The source isn't shared with
+	// any other thread until it's released, so it can be resized here.
+	const int64_t cache_size = max_cache_size / (int64_t)open_sources;
+	lock.unlock();
+	source->SetMaxCacheSize(cache_size);
+	return source;
+}
+
+void BSAudioProvider::ReleaseSource(BestAudioSource *source) const {
+	{
+		std::lock_guard<std::mutex> lock(sources_lock);
+		idle_sources.push_back(source);
+	}
+	source_returned.notify_one();
+}
+
 void BSAudioProvider::FillBuffer(void *Buf, int64_t Start, int64_t Count) const {
-	const_cast<BestAudioSource &>(bs).GetPackedAudio(reinterpret_cast<uint8_t *>(Buf), Start, Count);
+	auto source = AcquireSource();
+	try {
+		source->GetPackedAudio(reinterpret_cast<uint8_t *>(Buf), Start, Count);
+	}
+	catch (...) {
+		ReleaseSource(source);
+		throw;
+	}
+	ReleaseSource(source);
 }
 
 }
@@ -25,6 +25,8 @@
 #include <libaegisub/log.h>
 #include <libaegisub/path.h>
 
+#include <boost/crc.hpp>
+#include <boost/filesystem/path.hpp>
 #include <boost/range/iterator_range.hpp>
 
 using namespace agi;
@@ -57,6 +59,65 @@ const factory providers[] = {
 	{"VapourSynth", CreateVapourSynthAudioProvider, false},
 #endif
 };
+
+/// Get a file in one of the audio cache directories for data derived from
+/// an audio file, cleaning out the least recently used files in that
+/// directory, or an empty path if something went wrong
+/// @param provider_name Name of the provider which opened the file
+/// @param dir Cache directory under ?local
+/// @param ext Extension of the cache files
+/// @param opt Option group with the Size and Files limits for the cache
+fs::path GetAudioCacheFile(fs::path const& filename, AudioProvider const& provider, const char *provider_name, Path const& path_helper, std::string const& dir, std::string const& ext, std::string const& opt) {
+	try {
+		// Key on the file's identity and modification time like the index
+		// caches do, plus the provider, track and decoded format since the
+		// cached data depends on them
+		uintmax_t len = fs::Size(filename);
+		boost::crc_32_type hash;
+		hash.process_bytes(filename.string().c_str(), filename.string().size());
+
+		auto result = path_helper.Decode("?local/" + dir + "/" + filename.filename().string()
+			+ "_" + std::to_string(hash.checksum())
+			+ "_" + std::to_string(len)
+			+ "_" + std::to_string(fs::ModifiedTime(filename))
+			+ "_" + std::to_string(provider.GetNumSamples())
+			+ "_" + std::to_string(provider.GetSampleRate())
+			+ "_" + std::to_string(provider.GetChannels())
+			+ "_" + std::to_string(provider.GetTrack())
+			+ "_" + provider_name + ext);
+		fs::CreateDirectory(result.parent_path());
+
+		// Count this as a use so that the cleaner evicts the least recently
+		// used files rather than this one
+		if (fs::FileExists(result))
+			fs::Touch(result);
+
+		CleanCache(result.parent_path(), "*" + ext,
+			OPT_GET(opt + "/Size")->GetInt(),
+			OPT_GET(opt + "/Files")->GetInt());
+		return result;
+	}
+	catch (agi::Exception const& e) {
+		LOG_D("audio_provider") << "Not caching " << ext << " file: " << e.GetMessage();
+		return fs::path();
+	}
+}
+
+/// Get the file to persist the waveform peak summary of an audio file in,
+/// or an empty path if it should not be persisted
+fs::path GetPeakCacheFile(fs::path const& filename, AudioProvider const& provider, const char *provider_name, Path const& path_helper) {
+	if (!OPT_GET("Audio/Cache/Peaks/Enable")->GetBool())
+		return fs::path();
+	return GetAudioCacheFile(filename, provider, provider_name, path_helper, "peakcache", ".peaks", "Audio/Cache/Peaks");
+}
+
+/// Get the file to keep the decoded audio of an audio file in between
+/// sessions, or an empty path if it should not be kept
+fs::path GetPersistentAudioCacheFile(fs::path const& filename, AudioProvider const& provider, const char *provider_name, Path const& path_helper) {
+	if (!OPT_GET("Audio/Cache/HD/Persistent/Enable")->GetBool())
+		return fs::path();
+	return GetAudioCacheFile(filename, provider, provider_name, path_helper, "audiocache", ".pcm", "Audio/Cache/HD/Persistent");
+}
 }
 
 std::vector<std::string> GetAudioProviderNames() {
@@ -70,6 +131,7 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
 	auto sorted = GetSorted(boost::make_iterator_range(std::begin(providers), std::end(providers)), preferred);
 
 	std::unique_ptr<AudioProvider> provider;
+	const char *provider_name = nullptr;
 	bool found_file = false;
 	bool found_audio = false;
 	std::string msg_all;     // error messages from all attempted providers
@@ -79,6 +141,7 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
 		try {
 			provider = factory->create(filename, br);
 			if (!provider) continue;
+			provider_name = factory->name;
 			LOG_I("audio_provider") << "Using audio provider: " << factory->name;
 			break;
 		}
@@ -120,8 +183,13 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
 	if (!cache || !needs_cache)
 		return CreateLockAudioProvider(std::move(provider));
 
+	auto peak_cache = GetPeakCacheFile(filename, *provider, provider_name, path_helper);
+
 	// Convert to RAM
-	if (cache == 1) return CreateRAMAudioProvider(std::move(provider));
+	if (cache == 1) return CreateRAMAudioProvider(std::move(provider), peak_cache);
+
+	// Convert to compressed RAM
+	if (cache == 3) return CreateCompressedRAMAudioProvider(std::move(provider), peak_cache);
 
 	// Convert to HD
 	if (cache == 2) {
@@ -129,7 +197,8 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
 		if (path == "default")
 			path = "?temp";
 		auto cache_dir = path_helper.MakeAbsolute(path_helper.Decode(path), "?temp");
-		return CreateHDAudioProvider(std::move(provider), cache_dir);
+		auto persistent_file = GetPersistentAudioCacheFile(filename, *provider, provider_name, path_helper);
+		return CreateHDAudioProvider(std::move(provider), cache_dir, peak_cache, persistent_file);
 	}
 
 	throw InternalError("Invalid audio caching method");
@@ -148,6 +148,7 @@ void FFmpegSourceAudioProvider::LoadAudio(agi::fs::path const& filename) {
 
 	const FFMS_AudioProperties AudioInfo = *FFMS_GetAudioProperties(AudioSource);
 
+	track		= TrackNumber;
 	channels	= AudioInfo.Channels;
 	sample_rate	= AudioInfo.SampleRate;
 	num_samples = AudioInfo.NumSamples;
@@ -37,6 +37,7 @@
 #include <libaegisub/make_unique.h>
 
 #include <algorithm>
+#include <cmath>
 #include <wx/dc.h>
 
 namespace {
@@ -158,6 +159,15 @@ size_t AudioRenderer::NumBlocks(const int64_t samples) const
 	return static_cast<size_t>(duration / pixel_ms / cache_bitmap_width);
 }
 
+bool AudioRenderer::IsBlockDecoded(const int i) const
+{
+	const double samples_per_block = cache_bitmap_width * pixel_ms * provider->GetSampleRate() / 1000.0;
+	const int64_t margin = renderer ? renderer->GetSampleMargin() : 0;
+	const int64_t start = std::max<int64_t>(0, static_cast<int64_t>(i * samples_per_block) - margin);
+	const int64_t end = std::min(static_cast<int64_t>(std::ceil((i + 1) * samples_per_block)) + margin, provider->GetNumSamples());
+	return provider->IsRangeDecoded(start, end - start);
+}
+
 wxBitmap const& AudioRenderer::GetCachedBitmap(const int i, const AudioRenderingStyle style)
 {
 	assert(provider);
@@ -192,7 +202,7 @@ void AudioRenderer::Render(wxDC &dc, wxPoint origin, const int start, const int
 	// And the offset in it to start its use at
 	const int firstbitmapoffset = start % cache_bitmap_width;
 	// The last bitmap required
-	const int lastbitmap = std::min<int>(end / cache_bitmap_width, NumBlocks(provider->GetDecodedSamples()) - 1);
+	const int lastbitmap = std::min<int>(end / cache_bitmap_width, NumBlocks(provider->GetNumSamples()) - 1);
 
 	// Set a clipping region so that the first and last bitmaps don't draw
 	// outside the requested range
@@ -201,7 +211,13 @@ void AudioRenderer::Render(wxDC &dc, wxPoint origin, const int start, const int
 
 	for (int i = firstbitmap; i <= lastbitmap; ++i)
 	{
-		dc.DrawBitmap(GetCachedBitmap(i, style), origin);
+		// The cache providers may decode out of order, so blocks which
+		// haven't been decoded yet can be anywhere. They're left blank rather
+		// than cached with partial audio.
+		if (IsBlockDecoded(i))
+			dc.DrawBitmap(GetCachedBitmap(i, style), origin);
+		else
+			renderer->RenderBlank(dc, wxRect(origin.x, origin.y, cache_bitmap_width, pixel_height), style);
 		origin.x += cache_bitmap_width;
 	}
 
@@ -223,6 +239,24 @@ void AudioRenderer::Invalidate()
 	needs_age = false;
 }
 
+void AudioRenderer::Invalidate(const int64_t start_sample, const int64_t end_sample)
+{
+	if (!provider || end_sample <= start_sample) return;
+
+	const size_t num_blocks = NumBlocks(provider->GetNumSamples());
+	if (num_blocks == 0) return;
+
+	const double samples_per_block = cache_bitmap_width * pixel_ms * provider->GetSampleRate() / 1000.0;
+	const size_t first = static_cast<size_t>(std::max<int64_t>(0, start_sample) / samples_per_block);
+	const size_t last = std::min(static_cast<size_t>((end_sample - 1) / samples_per_block), num_blocks - 1);
+
+	for (auto& bmp : bitmaps)
+	{
+		for (size_t i = first; i <= last; ++i)
+			bmp.Discard(i);
+	}
+}
+
 void AudioRendererBitmapProvider::SetProvider(agi::AudioProvider *const _provider)
 {
 	if (compare_and_set(provider, _provider))
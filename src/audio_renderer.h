@@ -123,6 +123,9 @@ class AudioRenderer {
 	/// Calculate the number of cache blocks needed for a given number of samples
 	size_t NumBlocks(int64_t samples) const;
 
+	/// Have all of the samples read when rendering cache block i been decoded yet?
+	bool IsBlockDecoded(int i) const;
+
 public:
 	/// @brief Constructor
 	///
@@ -213,6 +216,14 @@ public:
 	/// that will affect the rendered images, it should call this function to ensure
 	/// the cache is kept consistent.
 	void Invalidate();
+
+	/// @brief Invalidate the cached bitmaps showing a range of audio
+	/// @param start_sample First sample whose rendering has changed
+	/// @param end_sample   One past the last sample whose rendering has changed
+	///
+	/// For bitmap providers which fill in their data over time, so that only
+	/// the bitmaps covering the new data have to be rendered again.
+	void Invalidate(int64_t start_sample, int64_t end_sample);
 };
 
 
@@ -287,4 +298,13 @@ public:
 	/// Deriving classes should override this method if they implement any
 	/// kind of caching.
 	virtual void AgeCache(size_t max_size) { }
+
+	/// @brief Get the number of samples on each side of a bitmap's range which
+	///        are read when rendering it
+	///
+	/// Bitmaps are only rendered once all of the audio they read has been
+	/// decoded, so that they're never cached with partially decoded audio.
+	/// Deriving classes which read audio outside of the range they draw
+	/// should override this method.
+	virtual int64_t GetSampleMargin() const { return 0; }
 };
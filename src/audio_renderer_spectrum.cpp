@@ -40,32 +40,35 @@
 #endif
 
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/util.h>
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#ifdef WITH_FFTW3
+#include <fftw3.h>
+#endif
 
 #include <wx/image.h>
 #include <wx/dcmemory.h>
 
-/// Allocates blocks of derived data for the audio spectrum
+/// Describes blocks of derived data for the audio spectrum
+///
+/// Blocks are computed by AudioSpectrumEngine and stored with Set(), so this
+/// never has to produce any itself.
 struct AudioSpectrumCacheBlockFactory {
 	typedef std::unique_ptr<float, std::default_delete<float[]>> BlockType;
 
 	/// Pointer back to the owning spectrum renderer
 	AudioSpectrumRenderer *spectrum;
 
-	/// @brief Allocate and fill a data block
-	/// @param i Index of the block to produce data for
-	/// @return Newly allocated and filled block
-	///
-	/// The filling is delegated to the spectrum renderer
-	BlockType ProduceBlock(size_t i)
-	{
-		auto res = new float[((size_t)1)<<spectrum->derivation_size];
-		spectrum->FillBlock(i, res);
-		return BlockType(res);
-	}
-
 	/// @brief Calculate the in-memory size of a spec
 	/// @return The size in bytes of a spectrum cache block
 	size_t GetBlockSize() const
@@ -84,6 +87,269 @@ public:
 	}
 };
 
+/// @class AudioSpectrumEngine
+/// @brief Pool of worker threads computing spectrum blocks
+///
+/// Blocks are requested from the GUI thread, computed by the workers and then
+/// handed back to the GUI thread in batches via the callback. Each worker has
+/// its own scratch buffers; with FFTW they all execute the same plan, which
+/// is only ever created and destroyed on the GUI thread.
+class AudioSpectrumEngine {
+public:
+	typedef AudioSpectrumCacheBlockFactory::BlockType BlockType;
+	typedef std::function<void (std::vector<std::pair<size_t, BlockType>>&)> DeliverFunc;
+
+private:
+	agi::AudioProvider *provider;
+	size_t derivation_size;
+	size_t derivation_dist;
+	float scale_fix;
+	DeliverFunc deliver;
+
+	/// Reference to ourself handed to the GUI thread with each batch
+	std::weak_ptr<AudioSpectrumEngine> self;
+
+#ifdef WITH_FFTW3
+	fftw_plan dft_plan = nullptr;
+#endif
+
+	/// Protects everything below
+	std::mutex lock;
+	std::condition_variable work_available;
+	/// Blocks waiting for a worker, in the order they should be computed
+	std::deque<size_t> queue;
+	/// Blocks which are queued, being computed or waiting for delivery
+	std::unordered_set<size_t> requested;
+	/// Computed blocks not yet delivered to the GUI thread
+	std::vector<std::pair<size_t, BlockType>> ready;
+	/// Has a delivery been posted to the GUI thread which hasn't run yet?
+	bool delivery_pending = false;
+	bool stopping = false;
+
+	std::vector<std::thread> workers;
+
+	/// Maximum number of queued blocks; the oldest prefetches are dropped past this
+	static const size_t max_queue = 4096;
+
+	AudioSpectrumEngine(agi::AudioProvider *provider, size_t derivation_size, size_t derivation_dist, float scale_fix, DeliverFunc deliver)
+	: provider(provider)
+	, derivation_size(derivation_size)
+	, derivation_dist(derivation_dist)
+	, scale_fix(scale_fix)
+	, deliver(std::move(deliver))
+	{
+	}
+
+	void Work();
+	void Deliver();
+
+	/// @brief Fill a block with frequency-power data for a time range
+	/// @param      block_index Index of the block to fill data for
+	/// @param[out] block       Address to write the data to
+	/// @param      audio       Scratch buffer for 2 << derivation_size samples
+	void FillBlock(size_t block_index, float *block, int16_t *audio, void *scratch_in, void *scratch_out);
+
+public:
+	/// @brief Create an engine and start its workers
+	/// @param provider Audio provider to read from
+	/// @param derivation_size Binary logarithm of number of samples per derivation
+	/// @param derivation_dist Binary logarithm of number of samples between derivations
+	/// @param scale_fix Compensation for derivation_size differing from the user's choice
+	/// @param deliver Called on the GUI thread with each batch of computed blocks
+	static std::shared_ptr<AudioSpectrumEngine> Create(agi::AudioProvider *provider, size_t derivation_size, size_t derivation_dist, float scale_fix, DeliverFunc deliver);
+
+	/// Stops and joins the workers. Blocks not yet delivered are discarded.
+	~AudioSpectrumEngine();
+
+	/// @brief Ask for blocks to be computed
+	/// @param blocks Indices of the blocks, in the order they should be computed
+	/// @param prefetch Are the blocks speculative rather than needed for display?
+	///
+	/// Blocks needed for display go before anything already queued and prefetched
+	/// blocks go after. Blocks which have already been requested are ignored.
+	void Request(std::vector<size_t> const& blocks, bool prefetch);
+};
+
+std::shared_ptr<AudioSpectrumEngine> AudioSpectrumEngine::Create(agi::AudioProvider *provider, size_t derivation_size, size_t derivation_dist, float scale_fix, DeliverFunc deliver)
+{
+	std::shared_ptr<AudioSpectrumEngine> engine(new AudioSpectrumEngine(provider, derivation_size, derivation_dist, scale_fix, std::move(deliver)));
+	engine->self = engine;
+
+#ifdef WITH_FFTW3
+	// The plan is only used with the new-array execute functions, so the
+	// arrays it is created with are just for measuring
+	double *input = fftw_alloc_real(2<<derivation_size);
+	fftw_complex *output = fftw_alloc_complex(2<<derivation_size);
+	engine->dft_plan = fftw_plan_dft_r2c_1d(2<<derivation_size, input, output, FFTW_MEASURE);
+	fftw_free(input);
+	fftw_free(output);
+#endif
+
+	// Leave a core for the GUI and the audio decoder
+	int threads = mid<int>(1, (int)std::thread::hardware_concurrency() - 1, 8);
+	// The workers must not hold a reference to the engine, as the engine joins
+	// them when it's destroyed
+	auto raw = engine.get();
+	for (int i = 0; i < threads; ++i)
+		engine->workers.emplace_back([=] { raw->Work(); });
+
+	return engine;
+}
+
+AudioSpectrumEngine::~AudioSpectrumEngine()
+{
+	{
+		std::unique_lock<std::mutex> l(lock);
+		stopping = true;
+	}
+	work_available.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+
+#ifdef WITH_FFTW3
+	if (dft_plan)
+		fftw_destroy_plan(dft_plan);
+#endif
+}
+
+void AudioSpectrumEngine::Request(std::vector<size_t> const& blocks, bool prefetch)
+{
+	size_t added = 0;
+	{
+		std::unique_lock<std::mutex> l(lock);
+		auto insert_pos = prefetch ? queue.end() : queue.begin();
+		for (size_t block : blocks)
+		{
+			if (!requested.insert(block).second) continue;
+			insert_pos = queue.insert(insert_pos, block) + 1;
+			++added;
+		}
+
+		while (queue.size() > max_queue)
+		{
+			requested.erase(queue.back());
+			queue.pop_back();
+		}
+	}
+
+	if (added == 1)
+		work_available.notify_one();
+	else if (added > 1)
+		work_available.notify_all();
+}
+
+void AudioSpectrumEngine::Work()
+{
+	agi::util::SetThreadName("Spectrum Worker");
+
+	std::vector<int16_t> audio(2 << derivation_size);
+#ifdef WITH_FFTW3
+	double *input = fftw_alloc_real(2<<derivation_size);
+	fftw_complex *output = fftw_alloc_complex(2<<derivation_size);
+	void *scratch_in = input, *scratch_out = output;
+#else
+	// 2x for the input sample data, 2x each for the real and imaginary parts
+	// of the output
+	std::vector<float> fft_scratch(6 << derivation_size);
+	void *scratch_in = fft_scratch.data(), *scratch_out = nullptr;
+#endif
+
+	std::unique_lock<std::mutex> l(lock);
+	while (true)
+	{
+		work_available.wait(l, [&] { return stopping || !queue.empty(); });
+		if (stopping) break;
+
+		size_t block_index = queue.front();
+		queue.pop_front();
+		l.unlock();
+
+		BlockType block(new float[(size_t)1 << derivation_size]);
+		FillBlock(block_index, block.get(), audio.data(), scratch_in, scratch_out);
+
+		l.lock();
+		ready.emplace_back(block_index, std::move(block));
+		if (!delivery_pending)
+		{
+			delivery_pending = true;
+			auto weak = self;
+			agi::dispatch::Main().Async([=] {
+				if (auto engine = weak.lock())
+					engine->Deliver();
+			});
+		}
+	}
+	l.unlock();
+
+#ifdef WITH_FFTW3
+	fftw_free(input);
+	fftw_free(output);
+#endif
+}
+
+void AudioSpectrumEngine::Deliver()
+{
+	std::vector<std::pair<size_t, BlockType>> blocks;
+	{
+		std::unique_lock<std::mutex> l(lock);
+		blocks.swap(ready);
+		delivery_pending = false;
+		for (auto const& block : blocks)
+			requested.erase(block.first);
+	}
+
+	if (!blocks.empty())
+		deliver(blocks);
+}
+
+void AudioSpectrumEngine::FillBlock(size_t block_index, float *block, int16_t *audio, void *scratch_in, void *scratch_out)
+{
+	// The providers the display gets are either caches, which can be read
+	// from several threads at once and return silence rather than waiting
+	// for audio which isn't decoded yet, or wrapped in a lock of their own,
+	// so the workers don't have to take turns here
+	int64_t first_sample = (((int64_t)block_index) << derivation_dist) - ((int64_t)1 << derivation_size);
+	provider->GetInt16MonoAudio(audio, first_sample, 2 << derivation_size);
+
+#ifdef WITH_FFTW3
+	double *dft_input = static_cast<double *>(scratch_in);
+	fftw_complex *dft_output = static_cast<fftw_complex *>(scratch_out);
+	for (size_t si = 0; si < (size_t)2 << derivation_size; ++si)
+		dft_input[si] = audio[si] / 32768.0;
+
+	fftw_execute_dft_r2c(dft_plan, dft_input, dft_output);
+
+	double scale_factor = scale_fix * 9 / sqrt(2 << (derivation_size + 1));
+
+	fftw_complex *o = dft_output;
+	for (size_t si = (size_t)1<<derivation_size; si > 0; --si)
+	{
+		*block++ = log10( sqrt(o[0][0] * o[0][0] + o[0][1] * o[0][1]) * scale_factor + 1 );
+		o++;
+	}
+#else
+	float *fft_input = static_cast<float *>(scratch_in);
+	float *fft_real = fft_input + (2 << derivation_size);
+	float *fft_imag = fft_input + (4 << derivation_size);
+	for (size_t si = 0; si < (size_t)2 << derivation_size; ++si)
+		fft_input[si] = audio[si] / 32768.f;
+
+	FFT fft;
+	fft.Transform(2<<derivation_size, fft_input, fft_real, fft_imag);
+
+	float scale_factor = scale_fix * 9 / sqrt(2 * (float)(2<<derivation_size));
+
+	for (size_t si = 1<<derivation_size; si > 0; --si)
+	{
+		// With x in range [0;1], log10(x*9+1) will also be in range [0;1],
+		// although the FFT output can apparently get greater magnitudes than 1
+		// despite the input being limited to [-1;+1).
+		*block++ = log10( sqrt(*fft_real * *fft_real + *fft_imag * *fft_imag) * scale_factor + 1 );
+		fft_real++; fft_imag++;
+	}
+#endif
+}
+
 AudioSpectrumRenderer::AudioSpectrumRenderer(std::string const& color_scheme_name)
 {
 	colors.reserve(AudioStyle_MAX);
@@ -100,41 +366,44 @@ AudioSpectrumRenderer::~AudioSpectrumRenderer()
 
 void AudioSpectrumRenderer::RecreateCache()
 {
-	update_derivation_values ();
+	// Stop the workers before anything they use goes away
+	engine.reset();
+	cache.reset();
 
-#ifdef WITH_FFTW3
-	if (dft_plan)
-	{
-		fftw_destroy_plan(dft_plan);
-		fftw_free(dft_input);
-		fftw_free(dft_output);
-		dft_plan = nullptr;
-		dft_input = nullptr;
-		dft_output = nullptr;
-	}
-#endif
+	update_derivation_values ();
 
 	if (provider)
 	{
 		size_t block_count = (size_t)((provider->GetNumSamples() + ((size_t)1<<derivation_dist) - 1) >> derivation_dist);
 		cache = agi::make_unique<AudioSpectrumCache>(block_count, this);
 
-#ifdef WITH_FFTW3
-		dft_input = fftw_alloc_real(2<<derivation_size);
-		dft_output = fftw_alloc_complex(2<<derivation_size);
-		dft_plan = fftw_plan_dft_r2c_1d(
-			2<<derivation_size,
-			dft_input,
-			dft_output,
-			FFTW_MEASURE);
-#else
-		// Allocate scratch for 6x the derivation size:
-		// 2x for the input sample data
-		// 2x for the real part of the output
-		// 2x for the imaginary part of the output
-		fft_scratch.resize(6 << derivation_size);
-#endif
-		audio_scratch.resize(2 << derivation_size);
+		// Because the FFTs used here are unnormalized DFTs, we have to compensate
+		// the possible length difference between derivation_size used in the
+		// calculations and its user-provided counterpart. Thus, the display is
+		// kept independent of the sampling rate.
+		const float scale_fix =
+			1.f / sqrtf (float (1 << (derivation_size - derivation_size_user)));
+
+		engine = AudioSpectrumEngine::Create(provider, derivation_size, derivation_dist, scale_fix,
+			[this](std::vector<std::pair<size_t, AudioSpectrumEngine::BlockType>>& blocks) {
+				std::sort(blocks.begin(), blocks.end(),
+					[](std::pair<size_t, AudioSpectrumEngine::BlockType> const& a, std::pair<size_t, AudioSpectrumEngine::BlockType> const& b) {
+						return a.first < b.first;
+					});
+				for (auto& block : blocks)
+					cache->Set(block.first, std::move(block.second));
+
+				// Columns are drawn from the block their first sample falls
+				// in, so block i covers the samples from i << derivation_dist
+				for (size_t i = 0; i < blocks.size(); )
+				{
+					size_t j = i + 1;
+					while (j < blocks.size() && blocks[j].first == blocks[j - 1].first + 1)
+						++j;
+					BlocksReady((int64_t)blocks[i].first << derivation_dist, ((int64_t)blocks[j - 1].first + 1) << derivation_dist);
+					i = j;
+				}
+			});
 	}
 }
 
@@ -145,15 +414,11 @@ void AudioSpectrumRenderer::OnSetProvider()
 
 void AudioSpectrumRenderer::SetResolution(size_t _derivation_size, size_t _derivation_dist)
 {
-	if (derivation_dist_user != _derivation_dist)
+	// Both change the number and meaning of the blocks, so anything the
+	// workers are doing is no longer of any use
+	if (derivation_dist_user != _derivation_dist || derivation_size_user != _derivation_size)
 	{
 		derivation_dist_user = _derivation_dist;
-		update_derivation_values ();
-		AgeCache (0);
-	}
-
-	if (derivation_size_user != _derivation_size)
-	{
 		derivation_size_user = _derivation_size;
 		RecreateCache();
 	}
@@ -168,14 +433,6 @@ void AudioSpectrumRenderer::set_reference_frequency_position (float pos_fref_)
 }
 
 
-template<class T>
-void AudioSpectrumRenderer::ConvertToFloat(size_t count, T *dest) {
-	for (size_t si = 0; si < count; ++si)
-	{
-		dest[si] = (T)(audio_scratch[si]) / 32768.0;
-	}
-}
-
 void AudioSpectrumRenderer::update_derivation_values ()
 {
 	// Below this sampling rate (Hz), the derivation values are identical to
@@ -202,57 +459,6 @@ void AudioSpectrumRenderer::update_derivation_values ()
 	}
 }
 
-void AudioSpectrumRenderer::FillBlock(size_t block_index, float *block)
-{
-	assert(cache);
-	assert(block);
-
-	int64_t first_sample = (((int64_t)block_index) << derivation_dist) - ((int64_t)1 << derivation_size);
-	provider->GetInt16MonoAudio(audio_scratch.data(), first_sample, 2 << derivation_size);
-	
-	// Because the FFTs used here are unnormalized DFTs, we have to compensate
-	// the possible length difference between derivation_size used in the
-	// calculations and its user-provided counterpart. Thus, the display is
-	// kept independent of the sampling rate.
-	const float scale_fix =
-		1.f / sqrtf (float (1 << (derivation_size - derivation_size_user)));
-
-#ifdef WITH_FFTW3
-	ConvertToFloat(2 << derivation_size, dft_input);
-
-	fftw_execute(dft_plan);
-
-	double scale_factor = scale_fix * 9 / sqrt(2 << (derivation_size + 1));
-
-	fftw_complex *o = dft_output;
-	for (size_t si = (size_t)1<<derivation_size; si > 0; --si)
-	{
-		*block++ = log10( sqrt(o[0][0] * o[0][0] + o[0][1] * o[0][1]) * scale_factor + 1 );
-		o++;
-	}
-#else
-	ConvertToFloat(2 << derivation_size, &fft_scratch[0]);
-
-	float *fft_input = &fft_scratch[0];
-	float *fft_real = &fft_scratch[0] + (2 << derivation_size);
-	float *fft_imag = &fft_scratch[0] + (4 << derivation_size);
-
-	FFT fft;
-	fft.Transform(2<<derivation_size, fft_input, fft_real, fft_imag);
-
-	float scale_factor = scale_fix * 9 / sqrt(2 * (float)(2<<derivation_size));
-
-	for (size_t si = 1<<derivation_size; si > 0; --si)
-	{
-		// With x in range [0;1], log10(x*9+1) will also be in range [0;1],
-		// although the FFT output can apparently get greater magnitudes than 1
-		// despite the input being limited to [-1;+1).
-		*block++ = log10( sqrt(*fft_real * *fft_real + *fft_imag * *fft_imag) * scale_factor + 1 );
-		fft_real++; fft_imag++;
-	}
-#endif
-}
-
 void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle style)
 {
 	// Misc. utility functions
@@ -308,16 +514,34 @@ void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 	float log_ratio_calc = (b_fref - clin) / (clog - clin);
 	log_ratio_calc       = mid (0.f, log_ratio_calc, 1.f);
 
+	auto column_block = [&](int ax) {
+		return (size_t)(ax * pixel_ms * provider->GetSampleRate() / 1000) >> derivation_dist;
+	};
+	const size_t block_count = (size_t)((provider->GetNumSamples() + ((size_t)1<<derivation_dist) - 1) >> derivation_dist);
+
+	// Blocks which still have to be computed for this range
+	std::vector<size_t> missing;
+
 	// ax = absolute x, absolute to the virtual spectrum bitmap
 	for (int ax = start; ax < end; ++ax)
 	{
-		// Derived audio data
-		size_t block_index = (size_t)(ax * pixel_ms * provider->GetSampleRate() / 1000) >> derivation_dist;
-		float *power = &cache->Get(block_index);
-
 		// Prepare bitmap writing
 		unsigned char *px = imgdata + (imgheight-1) * stride + (ax - start) * 3;
 
+		// Derived audio data
+		size_t block_index = column_block(ax);
+		float *power = block_index < block_count ? cache->TryGet(block_index) : nullptr;
+
+		// Draw silence until the data arrives
+		if (!power)
+		{
+			if (block_index < block_count && (missing.empty() || missing.back() != block_index))
+				missing.push_back(block_index);
+			for (int y = 0; y < imgheight; ++y, px -= stride)
+				pal->map(0.f, px);
+			continue;
+		}
+
 		float bin_prv = minband;
 		float bin_cur = minband;
 		for (int y = 0; y < imgheight; ++y)
@@ -366,6 +590,28 @@ void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 		}
 	}
 
+	if (!missing.empty())
+		engine->Request(missing, false);
+
+	// Start on whatever comes next so that it's ready when scrolled to, but
+	// only where the audio has been decoded, as otherwise the block would be
+	// computed from (and cached as) silence
+	const int64_t decoded = provider->GetDecodedSamples();
+	size_t decoded_blocks = block_count;
+	if (decoded < provider->GetNumSamples())
+		decoded_blocks = (size_t)(std::max<int64_t>(0, decoded - ((int64_t)1 << derivation_size)) >> derivation_dist);
+
+	std::vector<size_t> prefetch;
+	size_t first_prefetch = column_block(end);
+	size_t last_prefetch = std::min(first_prefetch + prefetch_blocks, decoded_blocks);
+	for (size_t i = first_prefetch; i < last_prefetch; ++i)
+	{
+		if (!cache->TryGet(i))
+			prefetch.push_back(i);
+	}
+	if (!prefetch.empty())
+		engine->Request(prefetch, true);
+
 	wxBitmap tmpbmp(img);
 	wxMemoryDC targetdc(bmp);
 	targetdc.DrawBitmap(tmpbmp, 0, 0);
@@ -39,12 +39,11 @@
 
 #include "audio_renderer.h"
 
-#ifdef WITH_FFTW3
-#include <fftw3.h>
-#endif
+#include <libaegisub/signal.h>
 
 class AudioColorScheme;
 class AudioSpectrumCache;
+class AudioSpectrumEngine;
 struct AudioSpectrumCacheBlockFactory;
 
 /// @class AudioSpectrumRenderer
@@ -52,12 +51,27 @@ struct AudioSpectrumCacheBlockFactory;
 ///
 /// Renders frequency-power spectrum graphs of PCM audio data using a derivation function
 /// such as the fast fourier transform.
+///
+/// The derivations are done on a pool of worker threads. Columns whose data
+/// has not been computed yet are drawn as silence, and BlocksReady is
+/// announced when more data has arrived so that the display can redraw them.
 class AudioSpectrumRenderer final : public AudioRendererBitmapProvider {
 	friend struct AudioSpectrumCacheBlockFactory;
 
 	/// Internal cache management for the spectrum
 	std::unique_ptr<AudioSpectrumCache> cache;
 
+	/// Worker threads computing blocks for the cache
+	std::shared_ptr<AudioSpectrumEngine> engine;
+
+	/// Number of blocks past the end of the rendered range to compute ahead of time
+	static const size_t prefetch_blocks = 256;
+
+	/// Announced on the GUI thread when blocks computed in the background
+	/// have been added to the cache, with the first sample and one past the
+	/// last sample of each contiguous range of columns which has changed
+	agi::signal::Signal<int64_t, int64_t> BlocksReady;
+
 	/// Colour tables used for rendering
 	std::vector<AudioColorScheme> colors;
 
@@ -103,35 +117,9 @@ class AudioSpectrumRenderer final : public AudioRendererBitmapProvider {
 	/// e.g. new audio provider or new resolution.
 	void RecreateCache();
 
-	/// @brief Fill a block with frequency-power data for a time range
-	/// @param      block_index Index of the block to fill data for
-	/// @param[out] block       Address to write the data to
-	void FillBlock(size_t block_index, float *block);
-
-	/// @brief Convert audio data to float range [-1;+1)
-	/// @param count Samples to convert
-	/// @param dest Buffer to fill
-	template<class T>
-	void ConvertToFloat(size_t count, T *dest);
-
 	/// @brief Updates the derivation_* after a derivation_*_user change.
 	void update_derivation_values ();
 
-#ifdef WITH_FFTW3
-	/// FFTW plan data
-	fftw_plan dft_plan = nullptr;
-	/// Pre-allocated input array for FFTW
-	double *dft_input = nullptr;
-	/// Pre-allocated output array for FFTW
-	fftw_complex *dft_output = nullptr;
-#else
-	/// Pre-allocated scratch area for doing FFT derivations
-	std::vector<float> fft_scratch;
-#endif
-
-	/// Pre-allocated scratch area for storing raw audio data
-	std::vector<int16_t> audio_scratch;
-
 public:
 	/// @brief Constructor
 	/// @param color_scheme_name Name of the color scheme to use
@@ -169,4 +157,12 @@ public:
 	/// @brief Cleans up the cache
 	/// @param max_size Maximum size in bytes for the cache
 	void AgeCache(size_t max_size) override;
+
+	/// Each column is derived from a window of audio centred on the start of
+	/// the derivation it falls in, which can begin slightly before the column
+	int64_t GetSampleMargin() const override {
+		return ((int64_t)1 << derivation_size) + ((int64_t)1 << derivation_dist);
+	}
+
+	DEFINE_SIGNAL_ADDERS(BlocksReady, AddBlocksReadyListener)
 };
@@ -32,6 +32,7 @@
 #include "audio_colorscheme.h"
 #include "options.h"
 
+#include <libaegisub/audio/peaks.h>
 #include <libaegisub/audio/provider.h>
 
 #include <algorithm>
@@ -70,8 +71,12 @@ void AudioWaveformRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 	dc.SetPen(*wxTRANSPARENT_PEN);
 	dc.DrawRectangle(rect);
 
+	// Use the provider's peak summary if it has one, so that the cost of
+	// rendering doesn't scale with the zoom level
+	auto peaks = provider->GetPeaks();
+
 	// Make sure we've got a buffer to fill with audio data
-	if (!audio_buffer)
+	if (!peaks && !audio_buffer)
 	{
 		// Buffer for one pixel strip of audio
 		size_t buffer_needed = pixel_samples * provider->GetChannels() * provider->GetBytesPerSample();
@@ -85,25 +90,20 @@ void AudioWaveformRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 
 	for (int x = 0; x < rect.width; ++x)
 	{
-		provider->GetInt16MonoAudio(reinterpret_cast<int16_t*>(audio_buffer.get()), (int64_t)cur_sample, (int64_t)pixel_samples);
-		cur_sample += pixel_samples;
-
-		int peak_min = 0, peak_max = 0;
-		int64_t avg_min_accum = 0, avg_max_accum = 0;
-		auto aud = reinterpret_cast<const int16_t *>(audio_buffer.get());
-		for (int si = pixel_samples; si > 0; --si, ++aud)
+		agi::AudioPeak peak;
+		if (peaks)
+			peak = peaks->Query(*provider, (int64_t)cur_sample, (int64_t)pixel_samples);
+		else
 		{
-			if (*aud > 0)
-			{
-				peak_max = std::max(peak_max, (int)*aud);
-				avg_max_accum += *aud;
-			}
-			else
-			{
-				peak_min = std::min(peak_min, (int)*aud);
-				avg_min_accum += *aud;
-			}
+			provider->GetInt16MonoAudio(reinterpret_cast<int16_t*>(audio_buffer.get()), (int64_t)cur_sample, (int64_t)pixel_samples);
+			auto aud = reinterpret_cast<const int16_t *>(audio_buffer.get());
+			for (int si = pixel_samples; si > 0; --si, ++aud)
+				peak.Add(*aud);
 		}
+		cur_sample += pixel_samples;
+
+		int peak_min = peak.min, peak_max = peak.max;
+		int64_t avg_min_accum = peak.neg_sum, avg_max_accum = peak.pos_sum;
 
 		// midpoint is half height
 		peak_min = std::max((int)(peak_min * amplitude_scale * midpoint) / 0x8000, -midpoint);
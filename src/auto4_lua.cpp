@@ -198,25 +198,25 @@ namespace {
 		}
 	}
 
-	std::shared_ptr<VideoFrame> check_VideoFrame(lua_State *L) {
-		auto framePtr = static_cast<std::shared_ptr<VideoFrame>*>(luaL_checkudata(L, 1, "VideoFrame"));
+	std::shared_ptr<const VideoFrame> check_VideoFrame(lua_State *L) {
+		auto framePtr = static_cast<std::shared_ptr<const VideoFrame>*>(luaL_checkudata(L, 1, "VideoFrame"));
 		return *framePtr;
 	}
 
 	int FrameWidth(lua_State *L) {
-		std::shared_ptr<VideoFrame> frame = check_VideoFrame(L);
+		std::shared_ptr<const VideoFrame> frame = check_VideoFrame(L);
 		push_value(L, frame->width);
 		return 1;
 	}
 
 	int FrameHeight(lua_State *L) {
-		std::shared_ptr<VideoFrame> frame = check_VideoFrame(L);
+		std::shared_ptr<const VideoFrame> frame = check_VideoFrame(L);
 		push_value(L, frame->height);
 		return 1;
 	}
 
 	int FramePixel(lua_State *L) {
-		std::shared_ptr<VideoFrame> frame = check_VideoFrame(L);
+		std::shared_ptr<const VideoFrame> frame = check_VideoFrame(L);
 		size_t x = lua_tointeger(L, -2);
 		size_t y = lua_tointeger(L, -1);
 		lua_pop(L, 2);
@@ -236,7 +236,7 @@ namespace {
 	}
 
 	int FramePixelFormatted(lua_State *L) {
-		std::shared_ptr<VideoFrame> frame = check_VideoFrame(L);
+		std::shared_ptr<const VideoFrame> frame = check_VideoFrame(L);
 		size_t x = lua_tointeger(L, -2);
 		size_t y = lua_tointeger(L, -1);
 		lua_pop(L, 2);
@@ -256,8 +256,8 @@ namespace {
 	}
 
 	int FrameDestory(lua_State *L) {
-		std::shared_ptr<VideoFrame> frame = check_VideoFrame(L);
-		frame.~shared_ptr<VideoFrame>();
+		std::shared_ptr<const VideoFrame> frame = check_VideoFrame(L);
+		frame.~shared_ptr<const VideoFrame>();
 		return 0;
 	}
 
@@ -294,11 +294,11 @@ namespace {
 		}
 
 		if (c && c->project->Timecodes().IsLoaded()) {
-			std::shared_ptr<VideoFrame> frame = c->videoController->GetFrame(frameNumber, !withSubtitles);
+			std::shared_ptr<const VideoFrame> frame = c->videoController->GetFrame(frameNumber, !withSubtitles);
 
-			void *userData = lua_newuserdata(L, sizeof(std::shared_ptr<VideoFrame>));
+			void *userData = lua_newuserdata(L, sizeof(std::shared_ptr<const VideoFrame>));
 
-			new(userData) std::shared_ptr<VideoFrame>(frame);
+			new(userData) std::shared_ptr<const VideoFrame>(frame);
 
 			luaL_getmetatable(L, "VideoFrame");
 			lua_setmetatable(L, -2);
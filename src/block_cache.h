@@ -94,6 +94,31 @@ class DataBlockCache {
 		age.erase(mb.position);
 	}
 
+	/// @brief Get the slot for a block, marking its macroblock as most recently used
+	/// @param i Index of the block
+	typename BlockFactoryT::BlockType& Touch(size_t i)
+	{
+		size_t mbi = i >> MacroblockExponent;
+		assert(mbi < data.size());
+
+		auto &mb = data[mbi];
+
+		// Move this macroblock to the front of the age list
+		if (mb.blocks.empty())
+		{
+			mb.blocks.resize(macroblock_size);
+			age.push_front(&mb);
+		}
+		else if (mb.position != begin(age))
+			age.splice(begin(age), age, mb.position);
+
+		mb.position = age.begin();
+
+		size_t block_index = i & macroblock_index_mask;
+		assert(block_index < mb.blocks.size());
+		return mb.blocks[block_index];
+	}
+
 public:
 	/// @brief Constructor
 	/// @param block_count Total number of blocks the cache will manage
@@ -162,31 +187,13 @@ public:
 	/// It is legal to pass 0 (null) for created, in this case nothing is returned in it.
 	BlockT& Get(size_t i, bool *created = nullptr)
 	{
-		size_t mbi = i >> MacroblockExponent;
-		assert(mbi < data.size());
-
-		auto &mb = data[mbi];
-
-		// Move this macroblock to the front of the age list
-		if (mb.blocks.empty())
-		{
-			mb.blocks.resize(macroblock_size);
-			age.push_front(&mb);
-		}
-		else if (mb.position != begin(age))
-			age.splice(begin(age), age, mb.position);
-
-		mb.position = age.begin();
-
-		size_t block_index = i & macroblock_index_mask;
-		assert(block_index < mb.blocks.size());
-
-		BlockT *b = mb.blocks[block_index].get();
+		auto &slot = Touch(i);
+		BlockT *b = slot.get();
 
 		if (!b)
 		{
-			mb.blocks[block_index] = factory.ProduceBlock(i);
-			b = mb.blocks[block_index].get();
+			slot = factory.ProduceBlock(i);
+			b = slot.get();
 			assert(b != nullptr);
 			size += factory.GetBlockSize();
 
@@ -197,4 +204,42 @@ public:
 
 		return *b;
 	}
+
+	/// @brief Obtain a data block from the cache only if it has already been produced
+	/// @param i Index of the block to retrieve
+	/// @return A pointer to the block in cache, or nullptr if there isn't one
+	///
+	/// For use with blocks which are produced asynchronously and then stored
+	/// with Set() rather than by the factory.
+	BlockT *TryGet(size_t i)
+	{
+		return Touch(i).get();
+	}
+
+	/// @brief Discard a single block, so that it is produced again when next requested
+	/// @param i Index of the block to discard
+	void Discard(size_t i)
+	{
+		size_t mbi = i >> MacroblockExponent;
+		if (mbi >= data.size() || data[mbi].blocks.empty())
+			return;
+
+		auto &slot = data[mbi].blocks[i & macroblock_index_mask];
+		if (slot)
+		{
+			slot.reset();
+			size -= factory.GetBlockSize();
+		}
+	}
+
+	/// @brief Store a block which was produced outside of the cache
+	/// @param i     Index of the block to store
+	/// @param block The block, replacing any block already at that index
+	void Set(size_t i, typename BlockFactoryT::BlockType block)
+	{
+		auto &slot = Touch(i);
+		if (!slot)
+			size += factory.GetBlockSize();
+		slot = std::move(block);
+	}
 };
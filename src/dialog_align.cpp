@@ -189,7 +189,7 @@ namespace {
 	}
 
 	template<typename T>
-	bool check_point(boost::gil::pixel<unsigned char, T> & pixel, double orig[3], unsigned char tolerance)
+	bool check_point(boost::gil::pixel<unsigned char, T> const& pixel, double orig[3], unsigned char tolerance)
 	{
 		double lab[3];
 		// in pixel: B,G,R
@@ -287,7 +287,7 @@ namespace {
 
 		int pos = current_n_frame;
 		auto frame = provider->GetFrame(pos, -1, true);
-		auto view = interleaved_view(frame->width, frame->height, reinterpret_cast<boost::gil::bgra8_pixel_t*>(frame->data.data()), frame->pitch);
+		auto view = interleaved_view(frame->width, frame->height, reinterpret_cast<const boost::gil::bgra8_pixel_t*>(frame->data.data()), frame->pitch);
 		if (frame->flipped)
 			y = frame->height - y;
 
@@ -331,7 +331,7 @@ namespace {
 	bool DialogAlignToVideo::check_exists(int pos, int x, int y, int* lrud, double* orig, unsigned char tolerance)
 	{
 		auto frame = provider->GetFrame(pos, -1, true);
-		auto view = interleaved_view(frame->width, frame->height, reinterpret_cast<boost::gil::bgra8_pixel_t*>(frame->data.data()), frame->pitch);
+		auto view = interleaved_view(frame->width, frame->height, reinterpret_cast<const boost::gil::bgra8_pixel_t*>(frame->data.data()), frame->pitch);
 		if (frame->flipped)
 			y = frame->height - y;
 		int actual[4];
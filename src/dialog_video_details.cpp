@@ -63,6 +63,11 @@ void ShowVideoDetailsDialog(agi::Context *c) {
 		framecount, agi::Time(fps.TimeAtFrame(framecount - 1)).GetAssFormatted(true)));
 	make_field(_("Decoder:"), to_wx(provider->GetDecoderName()));
 
+	auto cache = provider->GetCacheStats();
+	if (cache.hits || cache.misses)
+		make_field(_("Frame cache:"), fmt_tl("%d hits, %d misses, %d frames (%d MB)",
+			cache.hits, cache.misses, cache.frames, cache.bytes >> 20));
+
 	auto video_sizer = new wxStaticBoxSizer(wxVERTICAL, &d, _("Video"));
 	video_sizer->Add(fg);
 
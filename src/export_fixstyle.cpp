@@ -47,13 +47,25 @@ AssFixStylesFilter::AssFixStylesFilter()
 {
 }
 
-void AssFixStylesFilter::ProcessSubs(AssFile *subs) {
+namespace {
+std::function<void (AssDialogue&)> style_fixer(AssFile *subs) {
 	auto styles = subs->GetStyles();
 	for (auto& str : styles) boost::to_lower(str);
 	sort(begin(styles), end(styles));
 
-	for (auto& diag : subs->Events) {
+	return [=](AssDialogue& diag) {
 		if (!binary_search(begin(styles), end(styles), boost::to_lower_copy(diag.Style.get())))
 			diag.Style = "Default";
-	}
+	};
+}
+}
+
+void AssFixStylesFilter::ProcessSubs(AssFile *subs) {
+	auto fix = style_fixer(subs);
+	for (auto& diag : subs->Events)
+		fix(diag);
+}
+
+std::function<void (AssDialogue&)> AssFixStylesFilter::GetLineProcessor(AssFile *subs) {
+	return style_fixer(subs);
 }
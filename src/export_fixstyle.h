@@ -40,5 +40,6 @@ class AssFixStylesFilter final : public AssExportFilter {
 public:
 	static void ProcessSubs(AssFile *subs);
 	void ProcessSubs(AssFile *subs, wxWindow *) override { ProcessSubs(subs); }
+	std::function<void (AssDialogue&)> GetLineProcessor(AssFile *subs) override;
 	AssFixStylesFilter();
 };
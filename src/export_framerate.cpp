@@ -55,10 +55,25 @@ AssTransformFramerateFilter::AssTransformFramerateFilter()
 {
 }
 
+struct AssTransformFramerateFilter::LineState {
+	AssTransformFramerateFilter const *filter;
+	AssDialogue *line;
+	int newStart;
+	int newEnd;
+	int newK;
+	int oldK;
+};
+
 void AssTransformFramerateFilter::ProcessSubs(AssFile *subs, wxWindow *) {
 	TransformFrameRate(subs);
 }
 
+std::function<void (AssDialogue&)> AssTransformFramerateFilter::GetLineProcessor(AssFile *) {
+	if (!Input.IsLoaded() || !Output.IsLoaded())
+		return [](AssDialogue&) { };
+	return [=](AssDialogue& line) { TransformLine(line); };
+}
+
 wxWindow *AssTransformFramerateFilter::GetConfigDialogWindow(wxWindow *parent, agi::Context *c) {
 	LoadSettings(true, c);
 
@@ -156,14 +171,15 @@ void AssTransformFramerateFilter::TransformTimeTags(std::string const& name, Ass
 	VariableDataType type = curParam->GetType();
 	if (type != VariableDataType::INT && type != VariableDataType::FLOAT) return;
 
-	AssTransformFramerateFilter *instance = static_cast<AssTransformFramerateFilter*>(curData);
-	AssDialogue *curDiag = instance->line;
+	LineState *state = static_cast<LineState*>(curData);
+	AssTransformFramerateFilter const *instance = state->filter;
+	AssDialogue *curDiag = state->line;
 
 	int parVal = curParam->Get<int>();
 
 	switch (curParam->classification) {
 		case AssParameterClass::RELATIVE_TIME_START: {
-			int value = instance->ConvertTime(trunc_cs(curDiag->Start) + parVal) - instance->newStart;
+			int value = instance->ConvertTime(trunc_cs(curDiag->Start) + parVal) - state->newStart;
 
 			// An end time of 0 is actually the end time of the line, so ensure
 			// nonzero is never converted to 0
@@ -175,13 +191,13 @@ void AssTransformFramerateFilter::TransformTimeTags(std::string const& name, Ass
 			break;
 		}
 		case AssParameterClass::RELATIVE_TIME_END:
-			curParam->Set(instance->newEnd - instance->ConvertTime(trunc_cs(curDiag->End) - parVal));
+			curParam->Set(state->newEnd - instance->ConvertTime(trunc_cs(curDiag->End) - parVal));
 			break;
 		case AssParameterClass::KARAOKE: {
-			int start = curDiag->Start / 10 + instance->oldK + parVal;
-			int value = (instance->ConvertTime(start * 10) - instance->newStart) / 10 - instance->newK;
-			instance->oldK += parVal;
-			instance->newK += value;
+			int start = curDiag->Start / 10 + state->oldK + parVal;
+			int value = (instance->ConvertTime(start * 10) - state->newStart) / 10 - state->newK;
+			state->oldK += parVal;
+			state->newK += value;
 			curParam->Set(value);
 			break;
 		}
@@ -192,24 +208,25 @@ void AssTransformFramerateFilter::TransformTimeTags(std::string const& name, Ass
 
 void AssTransformFramerateFilter::TransformFrameRate(AssFile *subs) {
 	if (!Input.IsLoaded() || !Output.IsLoaded()) return;
-	for (auto& curDialogue : subs->Events) {
-		line = &curDialogue;
-		newK = 0;
-		oldK = 0;
-		newStart = trunc_cs(ConvertTime(curDialogue.Start));
-		newEnd = trunc_cs(ConvertTime(curDialogue.End) + 9);
-
-		// Process stuff
-		auto blocks = line->ParseTags();
-		for (auto block : blocks | agi::of_type<AssDialogueBlockOverride>())
-			block->ProcessParameters(TransformTimeTags, this);
-		curDialogue.Start = newStart;
-		curDialogue.End = newEnd;
-		curDialogue.UpdateText(blocks);
-	}
+	for (auto& curDialogue : subs->Events)
+		TransformLine(curDialogue);
+}
+
+void AssTransformFramerateFilter::TransformLine(AssDialogue &line) const {
+	LineState state{this, &line, 0, 0, 0, 0};
+	state.newStart = trunc_cs(ConvertTime(line.Start));
+	state.newEnd = trunc_cs(ConvertTime(line.End) + 9);
+
+	// Process stuff
+	auto blocks = line.ParseTags();
+	for (auto block : blocks | agi::of_type<AssDialogueBlockOverride>())
+		block->ProcessParameters(TransformTimeTags, &state);
+	line.Start = state.newStart;
+	line.End = state.newEnd;
+	line.UpdateText(blocks);
 }
 
-int AssTransformFramerateFilter::ConvertTime(int time) {
+int AssTransformFramerateFilter::ConvertTime(int time) const {
 	int frame = Output.FrameAtTime(time);
 	int frameStart = Output.TimeAtFrame(frame);
 	int frameEnd = Output.TimeAtFrame(frame + 1);
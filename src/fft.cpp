@@ -31,90 +31,200 @@
 /// @brief Fast Fourier-transform implementation
 /// @ingroup utility
 ///
-/// Most of this code was taken from http://www.codeproject.com/audio/waveInFFT.asp
-/// And rewriten by Rodrigo Braz Monteiro
+/// Only used when building without FFTW. Real input is transformed as a
+/// complex transform of half the size with cached twiddle and bit-reversal
+/// tables, so nothing needs to be recomputed per call.
 
 #include "fft.h"
 
 #ifndef WITH_FFTW3
 #include <libaegisub/exception.h>
+#include <libaegisub/make_unique.h>
 
 #include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define AGI_FFT_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+/// Precomputed tables for real transforms of one size
+///
+/// A real transform of n samples is done as a complex transform of n/2
+/// points, with the even samples as the real parts and the odd samples as
+/// the imaginary parts, followed by a pass splitting the result into the
+/// spectrum of the real input.
+struct FFTTables {
+	/// Bit-reversal permutation for the complex transform
+	std::vector<uint32_t> reverse;
+	/// Twiddle factors for the complex transform's stages with butterflies
+	/// spanning four or more points; the stage with span h starts at h - 4
+	std::vector<float> twiddle_r, twiddle_i;
+	/// Twiddle factors for the split pass
+	std::vector<float> split_r, split_i;
+
+	FFTTables(size_t n_samples) {
+		const double pi = 3.1415926535897932384626433832795;
+		const size_t m = n_samples / 2;
+
+		unsigned int bits = 0;
+		while (((size_t)1 << bits) < m) ++bits;
+		reverse.resize(m);
+		for (size_t i = 0; i < m; ++i) {
+			uint32_t rev = 0;
+			for (unsigned int b = 0; b < bits; ++b)
+				rev |= ((i >> b) & 1) << (bits - 1 - b);
+			reverse[i] = rev;
+		}
+
+		for (size_t h = 4; h < m; h <<= 1) {
+			for (size_t j = 0; j < h; ++j) {
+				twiddle_r.push_back((float)cos(-pi * j / h));
+				twiddle_i.push_back((float)sin(-pi * j / h));
+			}
+		}
+
+		for (size_t k = 0; k <= m / 2; ++k) {
+			split_r.push_back((float)cos(-2 * pi * k / n_samples));
+			split_i.push_back((float)sin(-2 * pi * k / n_samples));
+		}
+	}
+};
+
+/// Get the tables for a transform size, creating them if needed
+FFTTables const& GetTables(size_t n_samples) {
+	static std::mutex mutex;
+	static std::map<size_t, std::unique_ptr<FFTTables>> tables;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto& t = tables[n_samples];
+	if (!t)
+		t = agi::make_unique<FFTTables>(n_samples);
+	return *t;
+}
+
+/// Do the butterflies of one block of a stage with span h (h >= 4)
+void Butterflies(size_t h, float *re, float *im, const float *wr, const float *wi) {
+	float *re2 = re + h, *im2 = im + h;
+#ifdef AGI_FFT_SSE
+	for (size_t j = 0; j < h; j += 4) {
+		__m128 w_r = _mm_loadu_ps(wr + j);
+		__m128 w_i = _mm_loadu_ps(wi + j);
+		__m128 b_r = _mm_loadu_ps(re2 + j);
+		__m128 b_i = _mm_loadu_ps(im2 + j);
+		__m128 t_r = _mm_sub_ps(_mm_mul_ps(w_r, b_r), _mm_mul_ps(w_i, b_i));
+		__m128 t_i = _mm_add_ps(_mm_mul_ps(w_r, b_i), _mm_mul_ps(w_i, b_r));
+		__m128 a_r = _mm_loadu_ps(re + j);
+		__m128 a_i = _mm_loadu_ps(im + j);
+		_mm_storeu_ps(re2 + j, _mm_sub_ps(a_r, t_r));
+		_mm_storeu_ps(im2 + j, _mm_sub_ps(a_i, t_i));
+		_mm_storeu_ps(re + j, _mm_add_ps(a_r, t_r));
+		_mm_storeu_ps(im + j, _mm_add_ps(a_i, t_i));
+	}
+#else
+	for (size_t j = 0; j < h; ++j) {
+		float t_r = wr[j] * re2[j] - wi[j] * im2[j];
+		float t_i = wr[j] * im2[j] + wi[j] * re2[j];
+		re2[j] = re[j] - t_r;
+		im2[j] = im[j] - t_i;
+		re[j] += t_r;
+		im[j] += t_i;
+	}
+#endif
+}
+
+/// In-place complex transform of m points which have already been put in
+/// bit-reversed order
+void ComplexTransform(size_t m, float *re, float *im, FFTTables const& t) {
+	if (m == 2) {
+		float r = re[1], i = im[1];
+		re[1] = re[0] - r; im[1] = im[0] - i;
+		re[0] += r; im[0] += i;
+		return;
+	}
+
+	// The first two stages only have twiddle factors of 1 and -i, so do
+	// them together as radix-4 butterflies without any multiplications
+	for (size_t i = 0; i + 4 <= m; i += 4) {
+		float a0r = re[i] + re[i+1], a0i = im[i] + im[i+1];
+		float a1r = re[i] - re[i+1], a1i = im[i] - im[i+1];
+		float a2r = re[i+2] + re[i+3], a2i = im[i+2] + im[i+3];
+		float a3r = re[i+2] - re[i+3], a3i = im[i+2] - im[i+3];
+
+		re[i]   = a0r + a2r; im[i]   = a0i + a2i;
+		re[i+2] = a0r - a2r; im[i+2] = a0i - a2i;
+		re[i+1] = a1r + a3i; im[i+1] = a1i - a3r;
+		re[i+3] = a1r - a3i; im[i+3] = a1i + a3r;
+	}
+
+	for (size_t h = 4; h < m; h <<= 1) {
+		const float *wr = &t.twiddle_r[h - 4];
+		const float *wi = &t.twiddle_i[h - 4];
+		for (size_t i = 0; i < m; i += 2 * h)
+			Butterflies(h, re + i, im + i, wr, wi);
+	}
+}
+}
 
 void FFT::DoTransform (size_t n_samples,float *input,float *output_r,float *output_i,bool inverse) {
 	if (!IsPowerOfTwo(n_samples))
 		throw agi::InternalError("FFT requires power of two input.");
 
-	// Inverse transform
-	float angle_num = 2.0f * 3.1415926535897932384626433832795f;
-	if (inverse) angle_num = -angle_num;
+	FFTTables const& t = GetTables(n_samples);
+	const size_t m = n_samples / 2;
 
-	// Variables
-	unsigned int i, j, k, n;
-	float tr, ti;
+	// Pack pairs of samples into complex numbers, using the first half of
+	// the output buffers as the work area
+	for (size_t i = 0; i < m; ++i) {
+		output_r[t.reverse[i]] = input[2 * i];
+		output_i[t.reverse[i]] = input[2 * i + 1];
+	}
 
-	// Calculate needed bits
-	unsigned int NumBits;
-	NumBits = NumberOfBitsNeeded(n_samples);
+	if (m > 1)
+		ComplexTransform(m, output_r, output_i, t);
 
-	// Copy samples to output buffers
-	for (i=0;i<n_samples;i++) {
-		j = ReverseBits (i,NumBits);
-		output_r[j] = input[i];
-		output_i[j] = 0.0f;
-	}
+	// Split the transform of the packed samples into the spectrum of the
+	// real input. Each pair of bins k and m - k only depends on the same
+	// pair of the complex transform, so this can be done in place.
+	float z0r = output_r[0], z0i = output_i[0];
+	output_r[0] = z0r + z0i; output_i[0] = 0;
+	output_r[m] = z0r - z0i; output_i[m] = 0;
 
-	unsigned int BlockEnd = 1;
-	unsigned int BlockSize;
-	for (BlockSize = 2;BlockSize<=n_samples;BlockSize<<=1) {
-		// Calculate variables for this iteration
-		float delta_angle = angle_num / (float)BlockSize;
-		float sm2 = sin (-2 * delta_angle);
-		float sm1 = sin (-delta_angle);
-		float cm2 = cos (-2 * delta_angle);
-		float cm1 = cos (-delta_angle);
-		float w = 2 * cm1;
-		float ar0, ar1, ar2, ai0, ai1, ai2;
-
-		// Apply for every sample
-		for(i=0;i<n_samples;i+=BlockSize) {
-			ar1 = cm1;
-			ar2 = cm2;
-			ai1 = sm1;
-			ai2 = sm2;
-
-			for (j=i,n=0;n<BlockEnd;j++,n++) {
-				k = j + BlockEnd;
-
-				ar0 = w*ar1 - ar2;
-				ai0 = w*ai1 - ai2;
-				ar2 = ar1;
-				ai2 = ai1;
-				ar1 = ar0;
-				ai1 = ai0;
-
-				tr = ar0*output_r[k] - ai0*output_i[k];
-				ti = ar0*output_i[k] + ai0*output_r[k];
-
-				output_r[k] = output_r[j] - tr;
-				output_i[k] = output_i[j] - ti;
-
-				output_r[j] += tr;
-				output_i[j] += ti;
-			}
-		}
+	for (size_t k = 1; k <= m / 2; ++k) {
+		size_t k2 = m - k;
+		float er = (output_r[k] + output_r[k2]) * 0.5f;
+		float ei = (output_i[k] - output_i[k2]) * 0.5f;
+		float or_ = (output_i[k] + output_i[k2]) * 0.5f;
+		float oi = (output_r[k2] - output_r[k]) * 0.5f;
 
-		// Set next block end to current size
-		BlockEnd = BlockSize;
+		float tr = t.split_r[k] * or_ - t.split_i[k] * oi;
+		float ti = t.split_r[k] * oi + t.split_i[k] * or_;
+
+		output_r[k] = er + tr;
+		output_i[k] = ei + ti;
+		output_r[k2] = er - tr;
+		output_i[k2] = ti - ei;
 	}
 
-	// Divide everything by number of samples if it's an inverse transform
-	if (inverse) {
-		float denom = 1.0f/(float)n_samples;
-		for (i=0;i<n_samples;i++) {
-			output_r[i] *= denom;
-			output_i[i] *= denom;
-		}
+	// The upper half of the spectrum of real input mirrors the lower half.
+	// Transform has always used a positive exponent and InverseTransform a
+	// negative one (scaled by 1/n), so conjugate whichever half needs it.
+	const float scale = inverse ? 1.0f / (float)n_samples : 1.0f;
+	const float sign = inverse ? scale : -scale;
+	output_r[0] *= scale;
+	output_r[m] *= scale;
+	for (size_t k = 1; k < m; ++k) {
+		float r = output_r[k] * scale, i = output_i[k];
+		output_r[k] = r;
+		output_i[k] = i * sign;
+		output_r[n_samples - k] = r;
+		output_i[n_samples - k] = -i * sign;
 	}
 }
 
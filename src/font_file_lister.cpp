@@ -18,6 +18,7 @@
 
 #include "ass_dialogue.h"
 #include "ass_file.h"
+#include "ass_parsed_text.h"
 #include "ass_style.h"
 #include "compat.h"
 #include "format.h"
@@ -74,33 +75,33 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 
 	bool overriden = false;
 
-	for (auto& block : line->ParseTags()) {
-		switch (block->GetType()) {
+	AssParsedText(line->Text).ForEachBlock([&](AssParsedText::Block block) {
+		switch (block.GetType()) {
 		case AssBlockType::OVERRIDE:
-			for (auto const& tag : static_cast<AssDialogueBlockOverride&>(*block).Tags) {
-				if (tag.Name == "\\r") {
-					style = styles[tag.Params[0].Get(line->Style.get())];
+			block.ForEachTag([&](AssParsedText::Tag tag) {
+				if (tag.Is("\\r")) {
+					style = styles[tag.GetParams()[0].Get(line->Style.get())];
 					overriden = false;
 				}
-				else if (tag.Name == "\\b") {
-					style.bold = tag.Params[0].Get(initial.bold);
+				else if (tag.Is("\\b")) {
+					style.bold = tag.GetParams()[0].Get(initial.bold);
 					overriden = true;
 				}
-				else if (tag.Name == "\\i") {
-					style.italic = tag.Params[0].Get(initial.italic);
+				else if (tag.Is("\\i")) {
+					style.italic = tag.GetParams()[0].Get(initial.italic);
 					overriden = true;
 				}
-				else if (tag.Name == "\\fn") {
-					style.facename = tag.Params[0].Get(initial.facename);
+				else if (tag.Is("\\fn")) {
+					style.facename = tag.GetParams()[0].Get(initial.facename);
 					overriden = true;
 				}
-			}
+			});
 			break;
 		case AssBlockType::PLAIN: {
-			auto text = block->GetText();
+			auto text = block.GetText();
 
 			if (text.empty())
-				continue;
+				break;
 
 			auto& usage = used_styles[style];
 
@@ -142,7 +143,7 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 		case AssBlockType::COMMENT:
 			break;
 		}
-	}
+	});
 }
 
 void FontCollector::ProcessChunk(std::pair<StyleInfo, UsageData> const& style) {
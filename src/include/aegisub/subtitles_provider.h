@@ -38,6 +38,8 @@
 #include <string>
 #include <vector>
 
+class AssAttachment;
+class AssDialogue;
 class AssFile;
 struct VideoFrame;
 
@@ -45,11 +47,26 @@ class SubtitlesProvider {
 	std::vector<char> buffer;
 	virtual void LoadSubtitles(const char *data, size_t len)=0;
 
+	/// Should this font be included in the data passed to LoadSubtitles?
+	/// Providers which gain nothing from being given the same font again
+	/// can skip ones which they've already seen.
+	virtual bool WantFont(AssAttachment const&) { return true; }
+
+protected:
+	/// Ids of the dialogue lines in the data passed to LoadSubtitles, in order
+	std::vector<int> line_ids;
+
 public:
 	virtual ~SubtitlesProvider() = default;
 	void LoadSubtitles(AssFile *subs, int time = -1);
 	virtual void DrawSubtitles(VideoFrame &dst, double time)=0;
 	virtual void Reinitialize() { }
+
+	/// Replace the line with the same Id in the loaded subtitles, or add it if
+	/// it isn't there
+	/// @return false if the provider can't update lines in place, in which
+	///         case the subtitles need to be loaded again instead
+	virtual bool UpdateLine(AssDialogue const&) { return false; }
 };
 
 namespace agi { class BackgroundRunner; }
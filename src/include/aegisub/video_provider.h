@@ -37,10 +37,19 @@
 #include <libaegisub/exception.h>
 #include <libaegisub/vfr.h>
 
+#include <memory>
 #include <string>
 
 struct VideoFrame;
 
+/// Counters describing how well a frame cache is doing
+struct VideoCacheStats {
+	size_t hits = 0;   ///< Frames served from the cache
+	size_t misses = 0; ///< Frames which had to be decoded
+	size_t frames = 0; ///< Frames currently in the cache
+	size_t bytes = 0;  ///< Memory used by the cached frames
+};
+
 class VideoProvider {
 public:
 	virtual ~VideoProvider() = default;
@@ -48,6 +57,11 @@ public:
 	/// Override this method to actually get frames
 	virtual void GetFrame(int n, VideoFrame &frame)=0;
 
+	/// Get a frame which may be shared with other users rather than copied
+	/// @return The frame, which must not be modified, or nullptr if this
+	///         provider has no frames to share and GetFrame should be used
+	virtual std::shared_ptr<const VideoFrame> GetSharedFrame(int) { return nullptr; }
+
 	/// Set the YCbCr matrix to the specified one
 	///
 	/// Providers are free to disregard this, and should if the requested
@@ -78,6 +92,11 @@ public:
 	/// @return Returns true if caching is desired, false otherwise.
 	virtual bool WantsCaching() const { return false; }
 
+	/// Get the statistics of the frame cache wrapping the decoder, if any
+	///
+	/// May be called from any thread while frames are being decoded.
+	virtual VideoCacheStats GetCacheStats() const { return {}; }
+
 	/// Should the video properties in the script be set to this video's property if they already have values?
 	virtual bool ShouldSetVideoProperties() const { return true; }
 
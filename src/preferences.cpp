@@ -385,10 +385,13 @@ void Advanced_Audio(wxTreebook *book, Preferences *parent) {
 	p->OptionChoice(expert, _("Audio player"), apl_choice, "Audio/Player");
 
 	auto cache = p->PageSizer(_("Cache"));
-	const wxString ct_arr[3] = { _("None (NOT RECOMMENDED)"), _("RAM"), _("Hard Disk") };
-	wxArrayString ct_choice(3, ct_arr);
+	const wxString ct_arr[4] = { _("None (NOT RECOMMENDED)"), _("RAM"), _("Hard Disk"), _("RAM (compressed)") };
+	wxArrayString ct_choice(4, ct_arr);
 	p->OptionChoice(cache, _("Cache type"), ct_choice, "Audio/Cache/Type");
 	p->OptionBrowse(cache, _("Path"), "Audio/Cache/HD/Location");
+	p->OptionAdd(cache, _("Keep decoded audio between sessions"), "Audio/Cache/HD/Persistent/Enable");
+	p->OptionAdd(cache, _("Maximum size of kept audio (MB)"), "Audio/Cache/HD/Persistent/Size", 0, 1000000);
+	p->OptionAdd(cache, _("Save waveform summaries between sessions"), "Audio/Cache/Peaks/Enable");
 
 	auto spectrum = p->PageSizer(_("Spectrum"));
 
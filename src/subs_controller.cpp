@@ -35,9 +35,13 @@
 #include <libaegisub/dispatch.h>
 #include <libaegisub/format_path.h>
 #include <libaegisub/fs.h>
+#include <libaegisub/make_unique.h>
 #include <libaegisub/path.h>
 #include <libaegisub/util.h>
 
+#include <unordered_map>
+#include <unordered_set>
+
 #include <wx/msgdlg.h>
 
 namespace {
@@ -48,17 +52,74 @@ namespace {
 		else
 			timer->Stop();
 	}
+
+	/// One section of the file before and after a commit, if it was changed
+	template<typename T>
+	struct SectionDelta {
+		bool changed = false;
+		T before, after;
+
+		void Record(T& current, T updated) {
+			changed = true;
+			before = std::move(current);
+			current = std::move(updated);
+			after = current;
+		}
+
+		void Merge(SectionDelta&& next) {
+			if (!next.changed) return;
+			if (!changed)
+				before = std::move(next.before);
+			changed = true;
+			after = std::move(next.after);
+		}
+
+		void ApplyTo(T& current, bool forward) const {
+			if (changed)
+				current = forward ? after : before;
+		}
+	};
+
+	/// A dialogue line before and after a commit, with null for a line which
+	/// was added or removed
+	struct LineDelta {
+		int id;
+		std::unique_ptr<AssDialogueBase> before, after;
+	};
+
+	bool same_line(AssDialogueBase const& a, AssDialogueBase const& b) {
+		// Row and Fold are recalculated on every commit and so aren't compared
+		return a.Comment == b.Comment
+			&& a.Layer == b.Layer
+			&& a.Margin == b.Margin
+			&& a.Start == b.Start
+			&& a.End == b.End
+			&& a.Style == b.Style
+			&& a.Actor == b.Actor
+			&& a.Effect == b.Effect
+			&& a.ExtradataIds == b.ExtradataIds
+			&& a.Text == b.Text;
+	}
+
+	bool same_extradata(ExtradataEntry const& a, ExtradataEntry const& b) {
+		return a.id == b.id && a.key == b.key && a.value == b.value;
+	}
 }
 
+/// The changes made to the file by a commit, along with the selection state
+/// to restore when returning to it
 struct SubsController::UndoInfo {
 	wxString undo_description;
 	int commit_id;
 
-	std::vector<std::pair<std::string, std::string>> script_info;
-	std::vector<AssStyle> styles;
-	std::vector<AssDialogueBase> events;
-	std::vector<AssAttachment> attachments;
-	std::vector<ExtradataEntry> extradata;
+	SectionDelta<std::vector<std::pair<std::string, std::string>>> script_info;
+	SectionDelta<std::vector<AssStyle>> styles;
+	SectionDelta<std::vector<AssAttachment>> attachments;
+	SectionDelta<std::vector<ExtradataEntry>> extradata;
+	/// Ids of the dialogue lines in file order, if lines were added, removed
+	/// or moved
+	SectionDelta<std::vector<int>> order;
+	std::vector<LineDelta> lines;
 
 	mutable std::vector<int> selection;
 	int active_line_id = 0;
@@ -67,25 +128,187 @@ struct SubsController::UndoInfo {
 	UndoInfo(const agi::Context *c, wxString const& d, int commit_id)
 	: undo_description(d)
 	, commit_id(commit_id)
-	, attachments(c->ass->Attachments)
-	, extradata(c->ass->Extradata)
 	{
-		script_info.reserve(c->ass->Info.size());
-		for (auto const& info : c->ass->Info)
+		UpdateActiveLine(c);
+		UpdateSelection(c);
+		UpdateTextSelection(c);
+	}
+
+	/// Fold the changes from the following commit into this one
+	void Merge(UndoInfo&& next) {
+		script_info.Merge(std::move(next.script_info));
+		styles.Merge(std::move(next.styles));
+		attachments.Merge(std::move(next.attachments));
+		extradata.Merge(std::move(next.extradata));
+		order.Merge(std::move(next.order));
+
+		std::unordered_map<int, size_t> index;
+		for (size_t i = 0; i < lines.size(); ++i)
+			index[lines[i].id] = i;
+		for (auto& line : next.lines) {
+			auto it = index.find(line.id);
+			if (it == index.end())
+				lines.push_back(std::move(line));
+			else
+				lines[it->second].after = std::move(line.after);
+		}
+	}
+
+	void UpdateActiveLine(const agi::Context *c) {
+		auto line = c->selectionController->GetActiveLine();
+		if (line)
+			active_line_id = line->Id;
+	}
+
+	void UpdateSelection(const agi::Context *c) {
+		auto const& sel = c->selectionController->GetSelectedSet();
+		selection.clear();
+		selection.reserve(sel.size());
+		for (const auto diag : sel)
+			selection.push_back(diag->Id);
+	}
+
+	void UpdateTextSelection(const agi::Context *c) {
+		pos = c->textSelectionController->GetInsertionPoint();
+		sel_start = c->textSelectionController->GetSelectionStart();
+		sel_end = c->textSelectionController->GetSelectionEnd();
+	}
+};
+
+/// A copy of the file as of the top of the undo stack
+///
+/// Only the deltas are kept for each commit, so undo and redo step this
+/// backwards and forwards through the history and then rebuild the file from
+/// it.
+struct SubsController::UndoState {
+	std::vector<std::pair<std::string, std::string>> script_info;
+	std::vector<AssStyle> styles;
+	std::vector<AssAttachment> attachments;
+	std::vector<ExtradataEntry> extradata;
+	std::vector<int> order;
+	std::unordered_map<int, AssDialogueBase> events;
+
+	UndoState(AssFile const& file)
+	: styles(file.Styles.begin(), file.Styles.end())
+	, attachments(file.Attachments)
+	, extradata(file.Extradata)
+	{
+		script_info.reserve(file.Info.size());
+		for (auto const& info : file.Info)
 			script_info.emplace_back(info.Key(), info.Value());
 
-		styles.reserve(c->ass->Styles.size());
-		styles.assign(c->ass->Styles.begin(), c->ass->Styles.end());
+		order.reserve(file.Events.size());
+		events.reserve(file.Events.size());
+		for (auto const& line : file.Events) {
+			order.push_back(line.Id);
+			events.emplace(line.Id, line);
+		}
+	}
 
-		events.reserve(c->ass->Events.size());
-		events.assign(c->ass->Events.begin(), c->ass->Events.end());
+	/// Bring this up to date with the file, recording what changed in delta
+	/// @param type Commit type bits, used to skip the expensive sections
+	/// @param single_line The only line which was changed, if any
+	void Update(AssFile const& file, int type, const AssDialogue *single_line, UndoInfo& delta) {
+		const bool all = type == AssFile::COMMIT_NEW;
+
+		// The small sections are cheap enough to always compare, which keeps
+		// the history right even for commits which under-report their changes
+		std::vector<std::pair<std::string, std::string>> info;
+		info.reserve(file.Info.size());
+		for (auto const& line : file.Info)
+			info.emplace_back(line.Key(), line.Value());
+		if (info != script_info)
+			delta.script_info.Record(script_info, std::move(info));
+
+		if (all || (type & AssFile::COMMIT_STYLES) || styles.size() != file.Styles.size() ||
+			!std::equal(styles.begin(), styles.end(), file.Styles.begin(),
+				[](AssStyle const& a, AssStyle const& b) { return a.GetEntryData() == b.GetEntryData(); }))
+			delta.styles.Record(styles, std::vector<AssStyle>(file.Styles.begin(), file.Styles.end()));
+
+		if (extradata.size() != file.Extradata.size() ||
+			!std::equal(extradata.begin(), extradata.end(), file.Extradata.begin(), same_extradata))
+			delta.extradata.Record(extradata, file.Extradata);
+
+		// Attachments can be large, so only check them when they've been touched
+		if (all || (type & AssFile::COMMIT_ATTACHMENT) || attachments.size() != file.Attachments.size())
+			delta.attachments.Record(attachments, file.Attachments);
+
+		const int line_types = AssFile::COMMIT_ORDER | AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_DIAG_FULL | AssFile::COMMIT_EXTRADATA;
+		if (!all && !(type & line_types)) return;
+
+		if (!all && !(type & (AssFile::COMMIT_ORDER | AssFile::COMMIT_DIAG_ADDREM))) {
+			if (single_line && events.count(single_line->Id)) {
+				UpdateLine(*single_line, delta);
+				return;
+			}
 
-		UpdateActiveLine(c);
-		UpdateSelection(c);
-		UpdateTextSelection(c);
+			// Lines have only been changed in place, so they can be compared
+			// without looking them up by id. If the order turns out to not
+			// match after all, fall back to the full comparison.
+			size_t i = 0;
+			if (order.size() == file.Events.size()) {
+				for (auto const& line : file.Events) {
+					if (order[i] != line.Id) break;
+					UpdateLine(line, delta);
+					++i;
+				}
+			}
+			if (i == order.size() && i == file.Events.size()) return;
+		}
+
+		std::vector<int> new_order;
+		new_order.reserve(file.Events.size());
+		for (auto const& line : file.Events) {
+			new_order.push_back(line.Id);
+			UpdateLine(line, delta);
+		}
+		if (new_order == order) return;
+
+		// Anything not in the new order has been removed from the file
+		if (events.size() != new_order.size()) {
+			std::unordered_set<int> present(new_order.begin(), new_order.end());
+			for (auto it = events.begin(); it != events.end(); ) {
+				if (present.count(it->first)) {
+					++it;
+					continue;
+				}
+				delta.lines.push_back(LineDelta{it->first, agi::make_unique<AssDialogueBase>(std::move(it->second)), nullptr});
+				it = events.erase(it);
+			}
+		}
+		delta.order.Record(order, std::move(new_order));
+	}
+
+	void UpdateLine(AssDialogue const& line, UndoInfo& delta) {
+		auto it = events.find(line.Id);
+		if (it == events.end()) {
+			events.emplace(line.Id, line);
+			delta.lines.push_back(LineDelta{line.Id, nullptr, agi::make_unique<AssDialogueBase>(line)});
+		}
+		else if (!same_line(it->second, line)) {
+			delta.lines.push_back(LineDelta{line.Id, agi::make_unique<AssDialogueBase>(std::move(it->second)), agi::make_unique<AssDialogueBase>(line)});
+			it->second = line;
+		}
+	}
+
+	/// Move forwards over delta's commit, or backwards if forward is false
+	void Step(UndoInfo const& delta, bool forward) {
+		delta.script_info.ApplyTo(script_info, forward);
+		delta.styles.ApplyTo(styles, forward);
+		delta.attachments.ApplyTo(attachments, forward);
+		delta.extradata.ApplyTo(extradata, forward);
+		delta.order.ApplyTo(order, forward);
+		for (auto const& line : delta.lines) {
+			auto const& value = forward ? line.after : line.before;
+			if (value)
+				events[line.id] = *value;
+			else
+				events.erase(line.id);
+		}
 	}
 
-	void Apply(agi::Context *c) const {
+	/// Replace the file's contents with this, restoring the selection from entry
+	void Apply(agi::Context *c, UndoInfo const& entry) const {
 		// Keep old dialogue lines alive until after the commit is complete
 		// since a bunch of stuff holds references to them
 		AssFile old;
@@ -95,6 +318,7 @@ struct SubsController::UndoInfo {
 		c->ass->Styles.clear();
 		c->ass->Extradata.clear();
 
+		auto& selection = entry.selection;
 		sort(begin(selection), end(selection));
 
 		AssDialogue *active_line = nullptr;
@@ -105,10 +329,10 @@ struct SubsController::UndoInfo {
 		for (auto const& style : styles)
 			c->ass->Styles.push_back(*new AssStyle(style));
 		c->ass->Attachments = attachments;
-		for (auto const& event : events) {
-			auto copy = new AssDialogue(event);
+		for (int id : order) {
+			auto copy = new AssDialogue(events.at(id));
 			c->ass->Events.push_back(*copy);
-			if (copy->Id == active_line_id)
+			if (copy->Id == entry.active_line_id)
 				active_line = copy;
 			if (binary_search(begin(selection), end(selection), copy->Id))
 				new_sel.insert(copy);
@@ -118,28 +342,8 @@ struct SubsController::UndoInfo {
 		c->ass->Commit("", AssFile::COMMIT_NEW);
 		c->selectionController->SetSelectionAndActive(std::move(new_sel), active_line);
 
-		c->textSelectionController->SetInsertionPoint(pos);
-		c->textSelectionController->SetSelection(sel_start, sel_end);
-	}
-
-	void UpdateActiveLine(const agi::Context *c) {
-		auto line = c->selectionController->GetActiveLine();
-		if (line)
-			active_line_id = line->Id;
-	}
-
-	void UpdateSelection(const agi::Context *c) {
-		auto const& sel = c->selectionController->GetSelectedSet();
-		selection.clear();
-		selection.reserve(sel.size());
-		for (const auto diag : sel)
-			selection.push_back(diag->Id);
-	}
-
-	void UpdateTextSelection(const agi::Context *c) {
-		pos = c->textSelectionController->GetInsertionPoint();
-		sel_start = c->textSelectionController->GetSelectionStart();
-		sel_end = c->textSelectionController->GetSelectionEnd();
+		c->textSelectionController->SetInsertionPoint(entry.pos);
+		c->textSelectionController->SetSelection(entry.sel_start, entry.sel_end);
 	}
 };
 
@@ -311,35 +515,50 @@ void SubsController::OnCommit(AssFileCommit c) {
 	if (c.message.empty() && !undo_stack.empty()) return;
 
 	commit_id = next_commit_id++;
-	// Allow coalescing only if it's the last change and the file has not been
-	// saved since the last change
-	if (commit_id == *c.commit_id+1 && redo_stack.empty() && saved_commit_id+1 != commit_id) {
-		// If only one line changed just modify it instead of copying the file
-		if (c.single_line && c.single_line->Group() == AssEntryGroup::DIALOGUE) {
-			for (auto& diag : undo_stack.back().events) {
-				if (diag.Id == c.single_line->Id) {
-					diag = *c.single_line;
-					break;
-				}
-			}
-			*c.commit_id = commit_id;
-			return;
-		}
-
-		undo_stack.pop_back();
-	}
 
 	// Make sure the file has at least one style and one dialogue line
-	if (context->ass->Styles.empty())
+	int type = c.type;
+	if (context->ass->Styles.empty()) {
 		context->ass->Styles.push_back(*new AssStyle);
+		if (type != AssFile::COMMIT_NEW)
+			type |= AssFile::COMMIT_STYLES;
+	}
 	if (context->ass->Events.empty()) {
 		context->ass->Events.push_back(*new AssDialogue);
 		context->ass->Events.back().Row = 0;
+		if (type != AssFile::COMMIT_NEW)
+			type |= AssFile::COMMIT_DIAG_ADDREM;
+	}
+
+	if (undo_stack.empty()) {
+		undo_state = agi::make_unique<UndoState>(*context->ass);
+		undo_stack.emplace_back(context, c.message, commit_id);
+		*c.commit_id = commit_id;
+		return;
+	}
+
+	UndoInfo delta(context, c.message, commit_id);
+	undo_state->Update(*context->ass, type, c.single_line, delta);
+
+	// Allow coalescing only if it's the last change and the file has not been
+	// saved since the last change
+	if (commit_id == *c.commit_id+1 && redo_stack.empty() && saved_commit_id+1 != commit_id) {
+		auto& top = undo_stack.back();
+		top.Merge(std::move(delta));
+		if (!c.single_line) {
+			top.undo_description = c.message;
+			top.commit_id = commit_id;
+			top.UpdateActiveLine(context);
+			top.UpdateSelection(context);
+			top.UpdateTextSelection(context);
+		}
+		*c.commit_id = commit_id;
+		return;
 	}
 
 	redo_stack.clear();
 
-	undo_stack.emplace_back(context, c.message, commit_id);
+	undo_stack.push_back(std::move(delta));
 
 	int depth = std::max<int>(OPT_GET("Limits/Undo Levels")->GetInt(), 2);
 	while ((int)undo_stack.size() > depth)
@@ -368,23 +587,25 @@ void SubsController::OnTextSelectionChanged() {
 
 void SubsController::Undo() {
 	if (undo_stack.size() <= 1) return;
+	undo_state->Step(undo_stack.back(), false);
 	redo_stack.splice(redo_stack.end(), undo_stack, std::prev(undo_stack.end()));
 
 	commit_id = undo_stack.back().commit_id;
 
 	text_selection_connection.Block();
-	undo_stack.back().Apply(context);
+	undo_state->Apply(context, undo_stack.back());
 	text_selection_connection.Unblock();
 }
 
 void SubsController::Redo() {
 	if (redo_stack.empty()) return;
+	undo_state->Step(redo_stack.back(), true);
 	undo_stack.splice(undo_stack.end(), redo_stack, std::prev(redo_stack.end()));
 
 	commit_id = undo_stack.back().commit_id;
 
 	text_selection_connection.Block();
-	undo_stack.back().Apply(context);
+	undo_state->Apply(context, undo_stack.back());
 	text_selection_connection.Unblock();
 }
 
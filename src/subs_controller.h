@@ -39,8 +39,12 @@ class SubsController {
 	agi::signal::Connection text_selection_connection;
 
 	struct UndoInfo;
+	struct UndoState;
 	boost::container::list<UndoInfo> undo_stack;
 	boost::container::list<UndoInfo> redo_stack;
+	/// The file as of the top of the undo stack, which the stack entries are
+	/// deltas against
+	std::unique_ptr<UndoState> undo_state;
 
 	/// Revision counter for undo coalescing and modified state tracking
 	int commit_id = 0;
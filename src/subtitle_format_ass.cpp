@@ -29,13 +29,113 @@
 #include "version.h"
 
 #include <libaegisub/ass/uuencode.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/file_mapping.h>
 #include <libaegisub/fs.h>
+#include <libaegisub/make_unique.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <cstring>
 
 DEFINE_EXCEPTION(AssParseError, SubtitleFormatParseError);
 
+namespace {
+/// Approximate number of bytes of [Events] parsed by each task
+const size_t events_chunk_size = 256 * 1024;
+
+typedef std::pair<const char *, const char *> LineRange;
+
+bool is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+bool starts_with(LineRange line, const char *prefix) {
+	size_t len = strlen(prefix);
+	return size_t(line.second - line.first) >= len && memcmp(line.first, prefix, len) == 0;
+}
+
+/// Get the line starting at pos and advance pos to the start of the next
+/// one. The line is trimmed and has any BOM stripped, as with TextFileReader.
+LineRange next_line(const char *&pos, const char *end) {
+	auto line_end = static_cast<const char *>(memchr(pos, '\n', end - pos));
+	if (!line_end) line_end = end;
+
+	const char *begin = pos;
+	pos = line_end == end ? end : line_end + 1;
+	while (begin < line_end && is_space(*begin)) ++begin;
+	while (line_end > begin && is_space(line_end[-1])) --line_end;
+
+	LineRange line(begin, line_end);
+	if (starts_with(line, "\xEF\xBB\xBF"))
+		line.first += 3;
+	return line;
+}
+
+bool is_section_header(LineRange line) {
+	return line.first != line.second && *line.first == '[' && line.second[-1] == ']';
+}
+
+/// Parse the body of an [Events] section and append the lines to the file
+void parse_events(AssFile *target, const char *begin, const char *end) {
+	// Split into chunks at line boundaries
+	std::vector<LineRange> chunks;
+	while (begin < end) {
+		const char *split = begin + std::min<size_t>(events_chunk_size, end - begin);
+		if (split < end) {
+			auto newline = static_cast<const char *>(memchr(split, '\n', end - split));
+			split = newline ? newline + 1 : end;
+		}
+		chunks.emplace_back(begin, split);
+		begin = split;
+	}
+
+	// Any error is from the first bad line in the file, as reading serially would give
+	std::vector<std::vector<std::unique_ptr<AssDialogue>>> lines(chunks.size());
+	agi::dispatch::ParallelFor(chunks.size(), [&](size_t i) {
+		const char *pos = chunks[i].first, *chunk_end = chunks[i].second;
+		while (pos < chunk_end) {
+			auto line = next_line(pos, chunk_end);
+			if (starts_with(line, "Dialogue:") || starts_with(line, "Comment:"))
+				lines[i].push_back(agi::make_unique<AssDialogue>(std::string(line.first, line.second)));
+		}
+	});
+
+	for (auto& chunk : lines) {
+		for (auto& line : chunk)
+			target->Events.push_back(*line.release());
+	}
+}
+
+/// Read a UTF-8 file from a memory mapping, with the [Events] section parsed
+/// in parallel
+void read_utf8(AssFile *target, agi::fs::path const& filename, int version) {
+	agi::read_file_mapping file(filename);
+	const char *pos = file.read(), *end = pos + file.size();
+
+	AssParser parser(target, version);
+	while (pos < end) {
+		auto line = next_line(pos, end);
+		parser.AddLine(std::string(line.first, line.second));
+		if (!parser.InEvents()) continue;
+
+		// Everything up to the next section header is event lines
+		const char *section_end = pos;
+		for (const char *next = pos; next < end; ) {
+			if (is_section_header(next_line(next, end))) break;
+			section_end = next;
+		}
+		parse_events(target, pos, section_end);
+		pos = section_end;
+	}
+}
+}
+
 void AssSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename, agi::vfr::Framerate const& fps, std::string const& encoding) const {
 	int version = !agi::fs::HasExtension(filename, "ssa");
 
+	if (boost::iequals(encoding, "utf-8"))
+		return read_utf8(target, filename, version);
+
 	TextFileReader file(filename, encoding);
 	AssParser parser(target, version);
 	while (file.HasMoreLines())
@@ -83,10 +183,21 @@ struct Writer {
 				group = line.Group();
 			}
 
-			file.WriteLineToFile(line.GetEntryData());
+			WriteEntry(line);
 		}
 	}
 
+	template<typename T>
+	void WriteEntry(T const& line) {
+		file.WriteLineToFile(line.GetEntryData());
+	}
+
+	void WriteEntry(AssDialogue const& line) {
+		// Dialogue lines are the bulk of most files, so skip building a
+		// temporary string for each of them
+		file.WriteLine([&](std::string& out) { line.AppendEntryData(out); });
+	}
+
 	void Write(ProjectProperties const& properties) {
 		file.WriteLineToFile("");
 		file.WriteLineToFile("[Aegisub Project Garbage]");
@@ -159,6 +270,7 @@ void AssSubtitleFormat::WriteFile(const AssFile *src, agi::fs::path const& filen
 	writer.Write(src->Attachments);
 	writer.Write(src->Events);
 	writer.WriteExtradata(src->Extradata);
+	writer.file.Commit();
 }
 
 void AssSubtitleFormat::ExportFile(const AssFile *src, agi::fs::path const& filename, agi::vfr::Framerate const& fps, std::string const& encoding) const {
@@ -167,4 +279,5 @@ void AssSubtitleFormat::ExportFile(const AssFile *src, agi::fs::path const& file
 	writer.Write(src->Styles);
 	writer.Write(src->Attachments);
 	writer.Write(src->Events);
+	writer.file.Commit();
 }
@@ -70,6 +70,7 @@ std::unique_ptr<SubtitlesProvider> SubtitlesProviderFactory::GetProvider(agi::Ba
 
 void SubtitlesProvider::LoadSubtitles(AssFile *subs, int time) {
 	buffer.clear();
+	line_ids.clear();
 
 	auto push_header = [&](const char *str) {
 		buffer.insert(buffer.end(), str, str + strlen(str));
@@ -94,14 +95,24 @@ void SubtitlesProvider::LoadSubtitles(AssFile *subs, int time) {
 		// which isn't probably trivial.
 		push_header("[Fonts]\n");
 		for (auto const& attachment : subs->Attachments)
-			if (attachment.Group() == AssEntryGroup::FONT)
+			if (attachment.Group() == AssEntryGroup::FONT && WantFont(attachment))
 				push_line(attachment.GetEntryData());
 	}
 
+	auto push_event = [&](AssDialogue const& line) {
+		if (line.Comment) return;
+		push_line(line.GetEntryData());
+		line_ids.push_back(line.Id);
+	};
+
 	push_header("[Events]\n");
-	for (auto const& line : subs->Events) {
-		if (!line.Comment && (time < 0 || !(line.Start > time || line.End <= time)))
-			push_line(line.GetEntryData());
+	if (time < 0) {
+		for (auto const& line : subs->Events)
+			push_event(line);
+	}
+	else {
+		for (auto line : subs->LinesAt(time))
+			push_event(*line);
 	}
 
 	LoadSubtitles(&buffer[0], buffer.size());
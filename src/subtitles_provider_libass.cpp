@@ -34,6 +34,8 @@
 
 #include "subtitles_provider_libass.h"
 
+#include "ass_attachment.h"
+#include "ass_dialogue.h"
 #include "compat.h"
 #include "include/aegisub/subtitles_provider.h"
 #include "video_frame.h"
@@ -45,6 +47,7 @@
 #include <libaegisub/make_unique.h>
 #include <libaegisub/util.h>
 
+#include <algorithm>
 #include <atomic>
 #if BOOST_VERSION >= 106900
 #include <boost/gil.hpp>
@@ -53,6 +56,8 @@
 #endif
 #include <memory>
 #include <mutex>
+#include <set>
+#include <unordered_map>
 
 #include <wx/intl.h>
 #include <wx/thread.h>
@@ -93,6 +98,34 @@ class LibassSubtitlesProvider final : public SubtitlesProvider {
 	std::shared_ptr<cache_thread_shared> shared;
 	ASS_Track* ass_track = nullptr;
 
+	/// Are the dialogue lines the events in ass_track came from known?
+	bool events_known = false;
+	/// Dialogue line Id of each event in ass_track
+	std::vector<int> event_ids;
+	/// Index in ass_track->events of each dialogue line
+	std::unordered_map<int, int> event_index;
+	/// ReadOrder to give the next line added to ass_track. Removing events
+	/// leaves gaps in the ReadOrders, so libass's n_events can't be used.
+	int next_read_order = 0;
+
+	/// Data of each font attachment in the last file passed to libass
+	std::set<std::shared_ptr<const std::string>> loaded_fonts;
+	/// Data of each font attachment in the file currently being loaded
+	std::set<std::shared_ptr<const std::string>> pending_fonts;
+
+	bool WantFont(AssAttachment const& font) override {
+		// Font extraction isn't enabled, so libass decodes the [Fonts]
+		// section and then discards it. Skip fonts which were in the last
+		// file loaded so that reloading a script with large attachments
+		// doesn't redo that work every time. Copies of an attachment share
+		// their data, so this only skips fonts whose contents are unchanged.
+		auto data = font.GetSharedEntryData();
+		pending_fonts.insert(data);
+		return !loaded_fonts.count(data);
+	}
+
+	void RemoveEvent(int index);
+
 	ASS_Renderer *renderer() {
 		if (shared->ready)
 			return shared->renderer;
@@ -126,10 +159,36 @@ public:
 	void LoadSubtitles(const char *data, size_t len) override {
 		if (ass_track) ass_free_track(ass_track);
 		ass_track = ass_read_memory(library, const_cast<char *>(data), len, nullptr);
-		if (!ass_track) throw agi::InternalError("libass failed to load subtitles.");
+		event_ids.clear();
+		event_index.clear();
+
+		// Only the current file's fonts are kept so that fonts from closed
+		// scripts and removed attachments aren't held onto
+		loaded_fonts.swap(pending_fonts);
+		pending_fonts.clear();
+
+		if (!ass_track) {
+			loaded_fonts.clear();
+			events_known = false;
+			throw agi::InternalError("libass failed to load subtitles.");
+		}
+
+		// Lines which libass fails to parse are dropped, after which there's
+		// no telling which event came from which line
+		events_known = ass_track->n_events == (int)line_ids.size();
+		if (events_known) {
+			event_ids = line_ids;
+			for (size_t i = 0; i < event_ids.size(); ++i)
+				event_index[event_ids[i]] = (int)i;
+		}
+
+		next_read_order = 0;
+		for (int i = 0; i < ass_track->n_events; ++i)
+			next_read_order = std::max(next_read_order, ass_track->events[i].ReadOrder + 1);
 	}
 
 	void DrawSubtitles(VideoFrame &dst, double time) override;
+	bool UpdateLine(AssDialogue const& line) override;
 
 	void Reinitialize() override {
 		// No need to reinit if we're not even done with the initial init
@@ -163,6 +222,49 @@ LibassSubtitlesProvider::~LibassSubtitlesProvider() {
 	if (ass_track) ass_free_track(ass_track);
 }
 
+void LibassSubtitlesProvider::RemoveEvent(int index) {
+	ass_free_event(ass_track, index);
+	event_index.erase(event_ids[index]);
+
+	// Event order doesn't matter to libass as it sorts the events by layer
+	// and read order when rendering, so just move the last one into the gap
+	int last = ass_track->n_events - 1;
+	if (index != last) {
+		ass_track->events[index] = ass_track->events[last];
+		event_ids[index] = event_ids[last];
+		event_index[event_ids[index]] = index;
+	}
+	--ass_track->n_events;
+	event_ids.pop_back();
+}
+
+bool LibassSubtitlesProvider::UpdateLine(AssDialogue const& line) {
+	if (!ass_track || !events_known) return false;
+
+	int read_order = -1;
+	auto it = event_index.find(line.Id);
+	if (it != event_index.end()) {
+		read_order = ass_track->events[it->second].ReadOrder;
+		RemoveEvent(it->second);
+	}
+
+	if (line.Comment) return true;
+
+	// The track is left in the events section after loading, so this parses
+	// the line as a new event
+	auto data = line.GetEntryData();
+	ass_process_data(ass_track, &data[0], (int)data.size());
+	if (ass_track->n_events != (int)event_ids.size() + 1)
+		return true;
+
+	// Keep the line's original place in the stacking order, and give new
+	// lines one which no other event has
+	ass_track->events[ass_track->n_events - 1].ReadOrder = read_order >= 0 ? read_order : next_read_order++;
+	event_index[line.Id] = (int)event_ids.size();
+	event_ids.push_back(line.Id);
+	return true;
+}
+
 #define _r(c) ((c)>>24)
 #define _g(c) (((c)>>16)&0xFF)
 #define _b(c) (((c)>>8)&0xFF)
@@ -25,41 +25,109 @@
 
 #include <libaegisub/io.h>
 #include <libaegisub/charset_conv.h>
+#include <libaegisub/fs.h>
 #include <libaegisub/make_unique.h>
 
 #include <boost/algorithm/string/case_conv.hpp>
 
+#include <cerrno>
+
+namespace {
+#ifdef _WIN32
+const char newline[] = "\r\n";
+#else
+const char newline[] = "\n";
+#endif
+
+/// Size at which the buffered text is written to the file
+const size_t flush_size = 1 << 20;
+}
+
 TextFileWriter::TextFileWriter(agi::fs::path const& filename, std::string encoding)
 : file(new agi::io::Save(filename, true))
 {
 	if (encoding.empty())
 		encoding = OPT_GET("App/Save Charset")->GetString();
-	if (encoding != "utf-8" && encoding != "UTF-8") {
+	if (encoding != "utf-8" && encoding != "UTF-8")
 		conv = agi::make_unique<agi::charset::IconvWrapper>("utf-8", encoding.c_str(), true);
-		newline = conv->Convert(newline);
-	}
 
 	try {
 		// Write the BOM
 		WriteLineToFile("\xEF\xBB\xBF", false);
+		Flush();
 	}
 	catch (agi::charset::ConversionFailure&) {
 		// If the BOM could not be converted to the target encoding it isn't needed
+		buffer.clear();
 	}
+
+	buffer.reserve(flush_size + flush_size / 4);
 }
 
 TextFileWriter::~TextFileWriter() {
-	// Explicit empty destructor required with a unique_ptr to an incomplete class
+	if (!file) return;
+	try {
+		file->Discard();
+	}
+	catch (agi::fs::FileSystemError const&) {
+		// Leaves a stray temporary file, but the target file is intact
+	}
+}
+
+void TextFileWriter::Commit() {
+	Flush();
+	if (!file->Get().flush())
+		throw agi::io::IOFatal("Failed to write the file");
+	// Replaces the target file with the temporary one
+	file.reset();
 }
 
 void TextFileWriter::WriteLineToFile(std::string const& line, bool addLineBreak) {
+	buffer += line;
+	if (addLineBreak)
+		EndLine();
+}
+
+void TextFileWriter::EndLine() {
+	buffer += newline;
+	if (buffer.size() >= flush_size)
+		Flush();
+}
+
+void TextFileWriter::Flush() {
+	if (buffer.empty()) return;
+
 	if (conv) {
-		auto converted = conv->Convert(line);
-		file->Get().write(converted.data(), converted.size());
+		// Convert straight into a buffer which is big enough for the entire
+		// output, as iconv can be very slow when it runs out of output space
+		// partway through a large input
+		converted.resize(buffer.size() * 4 + 16);
+		for (;;) {
+			const char *src = buffer.data();
+			size_t srcLen = buffer.size();
+			char *dst = &converted[0];
+			size_t dstLen = converted.size();
+			size_t res = conv->Convert(&src, &srcLen, &dst, &dstLen);
+			if (res != (size_t)-1) {
+				if (srcLen)
+					throw agi::charset::BadInput("One or more characters could not be converted to the output encoding");
+				res = conv->Convert(nullptr, nullptr, &dst, &dstLen);
+			}
+			if (res != (size_t)-1) {
+				file->Get().write(converted.data(), converted.size() - dstLen);
+				break;
+			}
+			if (errno != E2BIG)
+				throw agi::charset::BadInput("One or more characters could not be converted to the output encoding");
+
+			// Stateful encodings can need more than four bytes per input
+			// byte. Not every iconv can carry on correctly after running out
+			// of space in those, so start over with a bigger buffer.
+			conv->Convert(nullptr, nullptr, nullptr, nullptr);
+			converted.resize(converted.size() * 2);
+		}
 	}
 	else
-		file->Get().write(line.data(), line.size());
-
-	if (addLineBreak)
-		file->Get().write(newline.data(), newline.size());
+		file->Get().write(buffer.data(), buffer.size());
+	buffer.clear();
 }
@@ -32,15 +32,37 @@ namespace agi {
 class TextFileWriter {
 	std::unique_ptr<agi::io::Save> file;
 	std::unique_ptr<agi::charset::IconvWrapper> conv;
-#ifdef _WIN32
-	std::string newline = "\r\n";
-#else
-	std::string newline = "\n";
-#endif
+
+	/// UTF-8 text which has not yet been converted and written to the file.
+	/// Only ever holds complete lines so that it can be converted in one go.
+	std::string buffer;
+	/// Scratch space for the converted text
+	std::string converted;
+
+	/// Write the buffer to the file if it's gotten large enough
+	void EndLine();
 
 public:
 	TextFileWriter(agi::fs::path const& filename, std::string encoding="");
+	/// Discards the file if Commit() hasn't been called, leaving any existing
+	/// file at the target path untouched
 	~TextFileWriter();
 
 	void WriteLineToFile(std::string const& line, bool addLineBreak=true);
+
+	/// Write a line by formatting it directly into the output buffer
+	/// @param format Function which appends the line (without a line break)
+	///               to the UTF-8 std::string passed to it
+	template<typename Formatter>
+	void WriteLine(Formatter&& format) {
+		format(buffer);
+		EndLine();
+	}
+
+	/// Convert and write all buffered text to the file
+	void Flush();
+
+	/// Write any remaining text and replace the target file with the newly
+	/// written one. Must be called once everything has been written.
+	void Commit();
 };
@@ -170,6 +170,11 @@ void CleanCache(agi::fs::path const& directory, std::string const& file_type, ui
 		using cache_item = std::pair<int64_t, agi::fs::path>;
 		std::vector<cache_item> cachefiles;
 		for (auto const& file : agi::fs::DirectoryIterator(directory, file_type)) {
+			// Skip files which agi::io::Save is still writing, which are named
+			// <stem>_tmp_XXXX<ext>, as they could otherwise be deleted mid-write
+			auto tmp = file.rfind("_tmp_");
+			if (tmp != std::string::npos && tmp + 9 + agi::fs::path(file).extension().string().size() == file.size())
+				continue;
 			agi::fs::path path = directory/file;
 			cachefiles.push_back({agi::fs::ModifiedTime(path), path});
 			total_size += agi::fs::Size(path);
@@ -52,6 +52,7 @@ VideoController::VideoController(agi::Context *c)
 , connections(agi::signal::make_vector({
 	context->ass->AddCommitListener(&VideoController::OnSubtitlesCommit, this),
 	context->project->AddVideoProviderListener(&VideoController::OnNewVideoProvider, this),
+	context->project->AddTimecodesListener(&VideoController::OnNewTimecodes, this),
 	context->selectionController->AddActiveLineListener(&VideoController::OnActiveLineChanged, this),
 }))
 {
@@ -64,6 +65,13 @@ void VideoController::OnNewVideoProvider(AsyncVideoProvider *new_provider) {
 	Stop();
 	provider = new_provider;
 	color_matrix = provider ? provider->GetColorSpace() : "";
+	if (provider)
+		provider->SetTimecodes(context->project->Timecodes());
+}
+
+void VideoController::OnNewTimecodes(agi::vfr::Framerate const& new_fps) {
+	if (provider)
+		provider->SetTimecodes(new_fps);
 }
 
 void VideoController::OnSubtitlesCommit(int type, const AssDialogue *changed) {
@@ -223,7 +231,7 @@ int VideoController::FrameAtTime(int time, agi::vfr::Time type) const {
 	return context->project->Timecodes().FrameAtTime(time, type);
 }
 
-std::shared_ptr<VideoFrame> VideoController::GetFrame(int frame, bool raw) const {
+std::shared_ptr<const VideoFrame> VideoController::GetFrame(int frame, bool raw) const {
 	double timestamp = TimeAtFrame(frame, agi::vfr::EXACT);
 	return provider->GetFrame(frame, timestamp, raw);
 }
@@ -107,6 +107,7 @@ class VideoController final : public wxEvtHandler {
 
 	void OnSubtitlesCommit(int type, const AssDialogue *changed);
 	void OnNewVideoProvider(AsyncVideoProvider *provider);
+	void OnNewTimecodes(agi::vfr::Framerate const& new_fps);
 	void OnActiveLineChanged(AssDialogue *line);
 
 	void RequestFrame();
@@ -160,5 +161,5 @@ public:
 
 	int TimeAtFrame(int frame, agi::vfr::Time type = agi::vfr::EXACT) const;
 	int FrameAtTime(int time, agi::vfr::Time type = agi::vfr::EXACT) const;
-	std::shared_ptr<VideoFrame> GetFrame(int frame, bool raw) const;
+	std::shared_ptr<const VideoFrame> GetFrame(int frame, bool raw) const;
 };
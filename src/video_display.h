@@ -117,7 +117,7 @@ class VideoDisplay final : public wxGLCanvas {
 	bool freeSize;
 
 	/// Frame which will replace the currently visible frame on the next render
-	std::shared_ptr<VideoFrame> pending_frame;
+	std::shared_ptr<const VideoFrame> pending_frame;
 
 	std::unique_ptr<RetinaHelper> retina_helper;
 	int scale_factor;
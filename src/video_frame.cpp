@@ -24,6 +24,10 @@
 #include <wx/image.h>
 
 namespace {
+	/// Unused frame buffers to keep around; enough for a few frames at the
+	/// largest resolutions in common use and many more at typical ones
+	const size_t max_retained_frame_memory = 128 << 20;
+
 	// We actually have bgr_, not bgra, so we need a custom converter which ignores the alpha channel
 	struct color_converter {
 		template <typename P1, typename P2>
@@ -37,6 +41,11 @@ namespace {
 	};
 }
 
+agi::buffer_pool const& VideoFramePool() {
+	static const agi::buffer_pool pool(max_retained_frame_memory);
+	return pool;
+}
+
 wxImage GetImage(VideoFrame const& frame) {
 	using namespace boost::gil;
 
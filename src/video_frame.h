@@ -16,12 +16,17 @@
 
 #pragma once
 
-#include <vector>
+#include <libaegisub/buffer_pool.h>
 
 class wxImage;
 
+/// Pool shared by the pixel data of all video frames, so that decoding,
+/// caching and drawing subtitles on frames reuse a small set of blocks
+/// rather than allocating a new multi-megabyte buffer for each frame
+agi::buffer_pool const& VideoFramePool();
+
 struct VideoFrame {
-	std::vector<unsigned char> data;
+	agi::pooled_buffer data{VideoFramePool()};
 	size_t width;
 	size_t height;
 	size_t pitch;
@@ -28,6 +28,7 @@
 
 extern "C" {
 #include <libavutil/frame.h>
+#include <libavutil/opt.h>
 #include <libavutil/pixfmt.h>
 #include <libswscale/swscale.h>
 }
@@ -43,9 +44,14 @@ namespace agi { class BackgroundRunner; }
 #include <libaegisub/make_unique.h>
 #include <libaegisub/background_runner.h>
 #include <libaegisub/log.h>
+#include <libaegisub/scoped_ptr.h>
 
 namespace {
 
+void free_frame(AVFrame *frame) {
+	av_frame_free(&frame);
+}
+
 /// @class BSVideoProvider
 /// @brief Implements video loading through BestSource.
 class BSVideoProvider final : public VideoProvider {
@@ -58,6 +64,21 @@ class BSVideoProvider final : public VideoProvider {
 	std::string colorspace;
 	bool has_audio = false;
 
+	/// Conversion context from the last frame, and the properties of the
+	/// frame it was created for
+	agi::scoped_holder<SwsContext *> sws_context{nullptr, sws_freeContext};
+	int sws_width = 0;
+	int sws_height = 0;
+	int sws_format = AV_PIX_FMT_NONE;
+	int sws_colorspace = AVCOL_SPC_UNSPECIFIED;
+	int sws_range = AVCOL_RANGE_UNSPECIFIED;
+	/// Frame used to pass the output buffer to sws_scale_frame
+	agi::scoped_holder<AVFrame *> dst_frame{nullptr, free_frame};
+
+	/// Get a context for converting the frame to BGR0, reusing the previous
+	/// one if the frame's format hasn't changed
+	SwsContext *GetSwsContext(const AVFrame *frame);
+
 public:
 	BSVideoProvider(agi::fs::path const& filename, std::string const& colormatrix, agi::BackgroundRunner *br);
 
@@ -162,41 +183,106 @@ catch (VideoException const& err) {
 	throw VideoOpenError("Failed to create BestVideoSource");
 }
 
-void BSVideoProvider::GetFrame(int n, VideoFrame &out) {
-	std::unique_ptr<BestVideoFrame> bsframe(bs.GetFrame(n));
-	if (bsframe == nullptr) {
-		throw VideoDecodeError("Couldn't read frame!");
+SwsContext *create_sws_context(int width, int height, AVPixelFormat format) {
+#if LIBSWSCALE_VERSION_INT >= AV_VERSION_INT(6, 4, 100)
+	// Newer versions of swscale can split each frame between several threads
+	// when converting with sws_scale_frame, but that can only be turned on
+	// through the AVOptions API
+	SwsContext *context = sws_alloc_context();
+	if (!context) return nullptr;
+
+	av_opt_set_int(context, "srcw", width, 0);
+	av_opt_set_int(context, "srch", height, 0);
+	av_opt_set_int(context, "src_format", format, 0);
+	av_opt_set_int(context, "dstw", width, 0);
+	av_opt_set_int(context, "dsth", height, 0);
+	av_opt_set_int(context, "dst_format", AV_PIX_FMT_BGR0, 0);
+	av_opt_set_int(context, "sws_flags", SWS_BICUBIC, 0);
+	av_opt_set_int(context, "threads", 0, 0); // one per core
+
+	if (sws_init_context(context, nullptr, nullptr) < 0) {
+		sws_freeContext(context);
+		return nullptr;
 	}
-	const AVFrame *frame = bsframe->GetAVFrame();
-
-	SwsContext *context = sws_getContext(
-			frame->width, frame->height, (AVPixelFormat) frame->format,  	// TODO figure out aegi's color space forcing.
-			frame->width, frame->height, AV_PIX_FMT_BGR0,
+	return context;
+#else
+	return sws_getContext(
+			width, height, format,
+			width, height, AV_PIX_FMT_BGR0,
 			SWS_BICUBIC, nullptr, nullptr, nullptr);
+#endif
+}
+
+SwsContext *BSVideoProvider::GetSwsContext(const AVFrame *frame) {
+	if (sws_context && frame->width == sws_width && frame->height == sws_height &&
+		frame->format == sws_format && frame->colorspace == sws_colorspace &&
+		frame->color_range == sws_range)
+		return sws_context;
 
-	if (context == nullptr) {
+	// TODO figure out aegi's color space forcing.
+	sws_context = create_sws_context(frame->width, frame->height, (AVPixelFormat) frame->format);
+	if (!sws_context)
 		throw VideoDecodeError("Couldn't convert frame!");
-	}
 
 	int range = frame->color_range == AVCOL_RANGE_JPEG;
 	const int *coefficients = sws_getCoefficients(frame->colorspace == AVCOL_SPC_UNSPECIFIED ? AVCOL_SPC_BT709 : frame->colorspace);
 
-    sws_setColorspaceDetails(context,
-        coefficients, range,
-        coefficients, range,
-        0, 1 << 16, 1 << 16);
+	sws_setColorspaceDetails(sws_context,
+		coefficients, range,
+		coefficients, range,
+		0, 1 << 16, 1 << 16);
+
+	sws_width = frame->width;
+	sws_height = frame->height;
+	sws_format = frame->format;
+	sws_colorspace = frame->colorspace;
+	sws_range = frame->color_range;
+	return sws_context;
+}
+
+void BSVideoProvider::GetFrame(int n, VideoFrame &out) {
+	std::unique_ptr<BestVideoFrame> bsframe(bs.GetFrame(n));
+	if (bsframe == nullptr) {
+		throw VideoDecodeError("Couldn't read frame!");
+	}
+	const AVFrame *frame = bsframe->GetAVFrame();
 
-	out.data.resize(frame->width * frame->height * 4);
-	uint8_t *data[1] = {&out.data[0]};
-	int stride[1] = {frame->width * 4};
-	sws_scale(context, frame->data, frame->linesize, 0, frame->height, data, stride);
+	SwsContext *context = GetSwsContext(frame);
+
+	// The output buffer comes from the frame pool, so this doesn't allocate
+	// once the pool has a block of the right size
+	const int stride = frame->width * 4;
+	out.data.resize(stride * frame->height);
+#if LIBSWSCALE_VERSION_INT >= AV_VERSION_INT(6, 4, 100)
+	// The legacy sws_scale always converts on a single thread, so wrap the
+	// output buffer in a frame for sws_scale_frame. The buffer reference
+	// doesn't own the data and is dropped as soon as the conversion is done.
+	if (!dst_frame)
+		dst_frame = av_frame_alloc();
+	if (!dst_frame)
+		throw VideoDecodeError("Couldn't convert frame!");
+	dst_frame->format = AV_PIX_FMT_BGR0;
+	dst_frame->width = frame->width;
+	dst_frame->height = frame->height;
+	dst_frame->data[0] = out.data.data();
+	dst_frame->linesize[0] = stride;
+	dst_frame->buf[0] = av_buffer_create(out.data.data(), out.data.size(), [](void *, uint8_t *) { }, nullptr, 0);
+	if (!dst_frame->buf[0])
+		throw VideoDecodeError("Couldn't convert frame!");
+	int ret = sws_scale_frame(context, dst_frame, frame);
+	av_frame_unref(dst_frame);
+	if (ret < 0)
+		throw VideoDecodeError("Couldn't convert frame!");
+#else
+	uint8_t *data[1] = {out.data.data()};
+	int strides[1] = {stride};
+	sws_scale(context, frame->data, frame->linesize, 0, frame->height, data, strides);
+#endif
 
 	out.width = frame->width;
 	out.height = frame->height;
-	out.pitch = stride[0];
+	out.pitch = stride;
 	out.flipped = false; 		// TODO figure out flipped
-
-	sws_freeContext(context);
 }
 
 }
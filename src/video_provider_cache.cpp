@@ -19,20 +19,20 @@
 #include "options.h"
 #include "video_frame.h"
 
+#include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
 
+#include <atomic>
 #include <list>
+#include <unordered_map>
 
 namespace {
 /// A video frame and its frame number
 struct CachedFrame {
-	VideoFrame frame;
+	std::shared_ptr<const VideoFrame> frame;
 	int frame_number;
-
-	CachedFrame(VideoFrame const& frame, int frame_number)
-	: frame(frame), frame_number(frame_number) { }
-
-	CachedFrame(CachedFrame const&) = delete;
+	/// Bytes of memory used by the frame
+	size_t size;
 };
 
 /// @class VideoProviderCache
@@ -43,20 +43,67 @@ class VideoProviderCache final : public VideoProvider {
 
 	/// @brief Maximum size of the cache in bytes
 	///
-	/// Note that this is a soft limit. The cache stops allocating new frames
-	/// once it has exceeded the limit, but it never tries to shrink
-	const size_t max_cache_size = OPT_GET("Provider/Video/Cache/Size")->GetInt() << 20; // convert MB to bytes
+	/// Updated from the options on the GUI thread, and applied the next time
+	/// a frame is requested
+	std::atomic<size_t> max_cache_size{static_cast<size_t>(OPT_GET("Provider/Video/Cache/Size")->GetInt()) << 20};
+	agi::signal::Connection max_cache_size_changed;
 
 	/// Cache of video frames with the most recently used ones at the front
 	std::list<CachedFrame> cache;
+	/// Index into cache by frame number
+	std::unordered_map<int, std::list<CachedFrame>::iterator> index;
+	/// Total size of the frames in cache
+	size_t cache_size = 0;
+
+	/// Diagnostic counters, which are read by GetCacheStats from other threads
+	std::atomic<size_t> hits{0};
+	std::atomic<size_t> misses{0};
+	std::atomic<size_t> cached_frames{0};
+	std::atomic<size_t> cached_bytes{0};
+
+	/// Publish the current cache contents to GetCacheStats
+	void UpdateStats() {
+		cached_frames = index.size();
+		cached_bytes = cache_size;
+	}
+
+	/// Drop the least recently used frames until the cache is at most max_size bytes
+	void Shrink(size_t max_size);
+
+	void Clear() {
+		cache.clear();
+		index.clear();
+		cache_size = 0;
+		UpdateStats();
+	}
 
 public:
-	VideoProviderCache(std::unique_ptr<VideoProvider> master) : master(std::move(master)) { }
+	VideoProviderCache(std::unique_ptr<VideoProvider> master)
+	: master(std::move(master))
+	, max_cache_size_changed(OPT_SUB("Provider/Video/Cache/Size", [=](agi::OptionValue const& opt) {
+		max_cache_size = static_cast<size_t>(opt.GetInt()) << 20;
+	}))
+	{
+	}
+
+	~VideoProviderCache() {
+		LOG_D("video/cache") << "hits: " << hits << " misses: " << misses << " cached: " << cache.size() << " frames, " << cache_size << " bytes";
+	}
+
+	VideoCacheStats GetCacheStats() const override {
+		VideoCacheStats stats;
+		stats.hits = hits;
+		stats.misses = misses;
+		stats.frames = cached_frames;
+		stats.bytes = cached_bytes;
+		return stats;
+	}
 
 	void GetFrame(int n, VideoFrame &frame) override;
+	std::shared_ptr<const VideoFrame> GetSharedFrame(int n) override;
 
 	void SetColorSpace(std::string const& m) override {
-		cache.clear();
+		Clear();
 		return master->SetColorSpace(m);
 	}
 
@@ -74,28 +121,50 @@ public:
 	bool HasAudio() const override                 { return master->HasAudio(); }
 };
 
-void VideoProviderCache::GetFrame(int n, VideoFrame &out) {
-	size_t total_size = 0;
+void VideoProviderCache::Shrink(size_t max_size) {
+	while (cache_size > max_size) {
+		cache_size -= cache.back().size;
+		index.erase(cache.back().frame_number);
+		cache.pop_back();
+	}
+}
 
-	for (auto cur = cache.begin(); cur != cache.end(); ++cur) {
-		if (cur->frame_number == n) {
-			cache.splice(cache.begin(), cache, cur); // Move to front
-			out = cache.front().frame;
-			return;
-		}
+std::shared_ptr<const VideoFrame> VideoProviderCache::GetSharedFrame(int n) {
+	const size_t max_size = max_cache_size;
+	Shrink(max_size);
 
-		total_size += cur->frame.data.size();
+	auto it = index.find(n);
+	if (it != index.end()) {
+		++hits;
+		cache.splice(cache.begin(), cache, it->second); // Move to front
+		UpdateStats();
+		return cache.front().frame;
+	}
+	++misses;
+
+	// Frames are handed out without being copied, so a frame which has been
+	// evicted may still be in use and can't be reused for the new one. Its
+	// pixel data goes back to the frame pool once the last user is done.
+	std::shared_ptr<const VideoFrame> frame = master->GetSharedFrame(n);
+	if (!frame) {
+		auto decoded = std::make_shared<VideoFrame>();
+		master->GetFrame(n, *decoded);
+		frame = std::move(decoded);
 	}
 
-	master->GetFrame(n, out);
-
-	if (total_size >= max_cache_size) {
-		cache.splice(cache.begin(), cache, --cache.end()); // Move last to front
-		cache.front().frame_number = n;
-		cache.front().frame = out;
+	const size_t size = sizeof(VideoFrame) + frame->data.capacity();
+	if (size <= max_size) {
+		Shrink(max_size - size);
+		cache.push_front(CachedFrame{frame, n, size});
+		index[n] = cache.begin();
+		cache_size += size;
 	}
-	else
-		cache.emplace_front(out, n);
+	UpdateStats();
+	return frame;
+}
+
+void VideoProviderCache::GetFrame(int n, VideoFrame &out) {
+	out = *GetSharedFrame(n);
 }
 }
 
@@ -41,6 +41,7 @@
 #include "video_frame.h"
 
 #include <libaegisub/fs.h>
+#include <libaegisub/image_orientation.h>
 #include <libaegisub/make_unique.h>
 
 namespace {
@@ -317,59 +318,23 @@ void FFmpegSourceVideoProvider::GetFrame(int n, VideoFrame &out) {
 	if (!frame)
 		throw VideoDecodeError(std::string("Failed to retrieve frame: ") +  ErrInfo.Buffer);
 
-	out.data.assign(frame->Data[0], frame->Data[0] + frame->Linesize[0] * Height);
-	out.flipped = false;
-	out.width = Width;
-	out.height = Height;
-	out.pitch = frame->Linesize[0];
-#if FFMS_VERSION >= ((2 << 24) | (31 << 16) | (0 << 8) | 0)
-	// Handle flip
-	if (VideoInfo->Flip > 0)
-		for (int x = 0; x < Height; ++x)
-			for (int y = 0; y < Width / 2; ++y)
-				for (int ch = 0; ch < 4; ++ch)
-					std::swap(out.data[frame->Linesize[0] * x + 4 * y + ch], out.data[frame->Linesize[0] * x + 4 * (Width - 1 - y) + ch]);
-
-	else if (VideoInfo->Flip < 0)
-		for (int x = 0; x < Height / 2; ++x)
-			for (int y = 0; y < Width; ++y)
-				for (int ch = 0; ch < 4; ++ch)
-					std::swap(out.data[frame->Linesize[0] * x + 4 * y + ch], out.data[frame->Linesize[0] * (Height - 1 - x) + 4 * y + ch]);
-#endif
+	// Flips and rotations are applied while copying the frame out of FFMS's
+	// buffer, so that each pixel is only written once
+	agi::image_orientation orientation;
 #if FFMS_VERSION >= ((2 << 24) | (24 << 16) | (0 << 8) | 0)
-	// Handle rotation
-	if (VideoInfo->Rotation % 360 == 180 || VideoInfo->Rotation % 360 == -180) {
-		std::vector<unsigned char> data(std::move(out.data));
-		out.data.resize(Width * Height * 4);
-		for (int x = 0; x < Height; ++x)
-			for (int y = 0; y < Width; ++y)
-				for (int ch = 0; ch < 4; ++ch)
-					out.data[4 * (Width * x + y) + ch] = data[frame->Linesize[0] * (Height - 1 - x) + 4 * (Width - 1 - y) + ch];
-		out.pitch = 4 * Width;
-	}
-	else if (VideoInfo->Rotation % 180 == 90 || VideoInfo->Rotation % 360 == -270) {
-		std::vector<unsigned char> data(std::move(out.data));
-		out.data.resize(Width * Height * 4);
-		for (int x = 0; x < Width; ++x)
-			for (int y = 0; y < Height; ++y)
-				for (int ch = 0; ch < 4; ++ch)
-					out.data[4 * (Height * x + y) + ch] = data[frame->Linesize[0] * y + 4 * (Width - 1 - x) + ch];
-		out.width = Height;
-		out.height = Width;
-		out.pitch = 4 * Height;
-	}
-	else if (VideoInfo->Rotation % 180 == 270 || VideoInfo->Rotation % 360 == -90) {
-		std::vector<unsigned char> data(std::move(out.data));
-		out.data.resize(Width * Height * 4);
-		for (int x = 0; x < Width; ++x)
-			for (int y = 0; y < Height; ++y)
-				for (int ch = 0; ch < 4; ++ch)
-					out.data[4 * (Height * x + y) + ch] = data[frame->Linesize[0] * (Height - 1 - y) + 4 * x + ch];
-		out.width = Height;
-		out.height = Width;
-		out.pitch = 4 * Height;
-	}
+	orientation = agi::image_orientation::rotation(VideoInfo->Rotation);
+#endif
+#if FFMS_VERSION >= ((2 << 24) | (31 << 16) | (0 << 8) | 0)
+	// The flip applies to the image before it's rotated
+	orientation = orientation.after_flip(VideoInfo->Flip > 0, VideoInfo->Flip < 0);
 #endif
+
+	out.flipped = false;
+	out.width = orientation.transpose ? Height : Width;
+	out.height = orientation.transpose ? Width : Height;
+	out.pitch = out.width * 4;
+	out.data.resize(out.pitch * out.height);
+	agi::copy_oriented(frame->Data[0], frame->Linesize[0], Width, Height, &out.data[0], out.pitch, orientation);
 }
 }
 
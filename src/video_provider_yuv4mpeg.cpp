@@ -118,6 +118,8 @@ class YUV4MPEGVideoProvider final : public VideoProvider {
 	int frame_sz;	/// size of each frame in bytes
 	int luma_sz;	/// size of the luma plane of each frame, in bytes
 	int chroma_sz;	/// size of one of the two chroma planes of each frame, in bytes
+	int chroma_w;	/// width of the chroma planes
+	agi::ycbcr_subsampling subsampling;	/// chroma layout for the converter
 
 	Y4M_PixelFormat pixfmt = Y4M_PIXFMT_NONE;		/// colorspace/pixel format
 	Y4M_InterlacingMode imode = Y4M_ILACE_NOTSET;	/// interlacing mode (for the entire stream)
@@ -128,7 +130,7 @@ class YUV4MPEGVideoProvider final : public VideoProvider {
 
 	agi::vfr::Framerate fps;
 
-	agi::ycbcr_converter conv{agi::ycbcr_matrix::bt601, agi::ycbcr_range::tv};
+	agi::ycbcr_to_bgra conv{agi::ycbcr_matrix::bt601, agi::ycbcr_range::tv};
 
 	/// a list of byte positions detailing where in the file
 	/// each frame header can be found
@@ -182,16 +184,40 @@ YUV4MPEGVideoProvider::YUV4MPEGVideoProvider(agi::fs::path const& filename)
 		imode = Y4M_ILACE_UNKNOWN;
 
 	luma_sz = w * h;
+	int chroma_h = h;
 	switch (pixfmt) {
 	case Y4M_PIXFMT_420JPEG:
 	case Y4M_PIXFMT_420MPEG2:
 	case Y4M_PIXFMT_420PALDV:
-		chroma_sz	= (w * h) >> 2; break;
+		subsampling = agi::ycbcr_subsampling::yuv420;
+		chroma_w = (w + 1) >> 1;
+		chroma_h = (h + 1) >> 1;
+		break;
+	case Y4M_PIXFMT_411:
+		subsampling = agi::ycbcr_subsampling::yuv411;
+		chroma_w = (w + 3) >> 2;
+		break;
+	case Y4M_PIXFMT_422:
+		subsampling = agi::ycbcr_subsampling::yuv422;
+		chroma_w = (w + 1) >> 1;
+		break;
+	case Y4M_PIXFMT_444:
+	case Y4M_PIXFMT_444ALPHA:
+		subsampling = agi::ycbcr_subsampling::yuv444;
+		chroma_w = w;
+		break;
+	case Y4M_PIXFMT_MONO:
+		subsampling = agi::ycbcr_subsampling::mono;
+		chroma_w = chroma_h = 0;
+		break;
 	default:
-		/// @todo add support for more pixel formats
 		throw VideoOpenError("Unsupported pixel format");
 	}
+	chroma_sz	= chroma_w * chroma_h;
 	frame_sz	= luma_sz + chroma_sz*2;
+	// The alpha plane is skipped over, as video frames are always opaque
+	if (pixfmt == Y4M_PIXFMT_444ALPHA)
+		frame_sz += luma_sz;
 
 	num_frames = IndexFile(pos);
 	if (num_frames <= 0 || seek_table.empty())
@@ -390,34 +416,13 @@ int YUV4MPEGVideoProvider::IndexFile(uint64_t pos) {
 void YUV4MPEGVideoProvider::GetFrame(int n, VideoFrame &frame) {
 	n = mid(0, n, num_frames - 1);
 
-	int uv_width = w / 2;
-
 	auto src_y = reinterpret_cast<const unsigned char *>(file.read(seek_table[n], luma_sz + chroma_sz * 2));
-	auto src_u = src_y + luma_sz;
-	auto src_v = src_u + chroma_sz;
-	frame.data.resize(w * h * 4);
-	unsigned char *dst = &frame.data[0];
-
-	for (int py = 0; py < h; ++py) {
-		for (int px = 0; px < w / 2; ++px) {
-			const uint8_t u = *src_u++;
-			const uint8_t v = *src_v++;
-			for (unsigned int i = 0; i < 2; ++i) {
-				const uint8_t y = *src_y++;
-				auto rgb = conv.ycbcr_to_rgb({{y, u, v}});
-				*dst++ = rgb[2];
-				*dst++ = rgb[1];
-				*dst++ = rgb[0];
-				*dst++ = 0;
-			}
-		}
+	agi::ycbcr_image image{w, h, subsampling,
+		{{src_y, src_y + luma_sz, src_y + luma_sz + chroma_sz}},
+		{{static_cast<size_t>(w), static_cast<size_t>(chroma_w), static_cast<size_t>(chroma_w)}}};
 
-		// Roll back u/v on even lines
-		if (!(py & 1)) {
-			src_u -= uv_width;
-			src_v -= uv_width;
-		}
-	}
+	frame.data.resize(w * h * 4);
+	conv.Convert(image, &frame.data[0], w * 4);
 
 	frame.flipped = false;
 	frame.width = w;
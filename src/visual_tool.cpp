@@ -22,6 +22,7 @@
 
 #include "ass_dialogue.h"
 #include "ass_file.h"
+#include "ass_parsed_text.h"
 #include "ass_style.h"
 #include "auto4_base.h"
 #include "compat.h"
@@ -340,33 +341,26 @@ void VisualTool<FeatureType>::RemoveSelection(FeatureType *feat) {
 
 //////// PARSERS
 
-typedef const std::vector<AssOverrideParameter> * param_vec;
+typedef AssParsedText::Params param_vec;
 
-// Find a tag's parameters in a line or return nullptr if it's not found
-static param_vec find_tag(std::vector<std::unique_ptr<AssDialogueBlock>>& blocks, std::string const& tag_name) {
-	for (auto ovr : blocks | agi::of_type<AssDialogueBlockOverride>()) {
-		for (auto const& tag : ovr->Tags) {
-			if (tag.Name == tag_name)
-				return &tag.Params;
-		}
-	}
-
-	return nullptr;
+// Find a tag's parameters in a line or return an empty param_vec if it's not found
+static param_vec find_tag(AssParsedText const& blocks, const char *tag_name) {
+	return blocks.FindTag(tag_name);
 }
 
 // Get a Vector2D from the given tag parameters, or Vector2D::Bad() if they are not valid
 static Vector2D vec_or_bad(param_vec tag, size_t x_idx, size_t y_idx) {
 	if (!tag ||
-		tag->size() <= x_idx || tag->size() <= y_idx ||
-		(*tag)[x_idx].omitted || (*tag)[y_idx].omitted)
+		tag.size() <= x_idx || tag.size() <= y_idx ||
+		tag[x_idx].omitted || tag[y_idx].omitted)
 	{
 		return Vector2D();
 	}
-	return Vector2D((*tag)[x_idx].Get<float>(), (*tag)[y_idx].Get<float>());
+	return Vector2D(tag[x_idx].Get<float>(), tag[y_idx].Get<float>());
 }
 
 Vector2D VisualToolBase::GetLinePosition(AssDialogue *diag) {
-	auto blocks = diag->ParseTags();
+	AssParsedText blocks(diag->Text);
 
 	if (Vector2D ret = vec_or_bad(find_tag(blocks, "\\pos"), 0, 1)) return ret;
 	if (Vector2D ret = vec_or_bad(find_tag(blocks, "\\move"), 0, 1)) return ret;
@@ -386,9 +380,9 @@ Vector2D VisualToolBase::GetLinePosition(AssDialogue *diag) {
 	param_vec align_tag;
 	int ovr_align = 0;
 	if ((align_tag = find_tag(blocks, "\\an")))
-		ovr_align = (*align_tag)[0].Get<int>(ovr_align);
+		ovr_align = align_tag[0].Get<int>(ovr_align);
 	else if ((align_tag = find_tag(blocks, "\\a")))
-		ovr_align = AssStyle::SsaToAss((*align_tag)[0].Get<int>(2));
+		ovr_align = AssStyle::SsaToAss(align_tag[0].Get<int>(2));
 
 	if (ovr_align > 0 && ovr_align <= 9)
 		align = ovr_align;
@@ -417,12 +411,12 @@ Vector2D VisualToolBase::GetLinePosition(AssDialogue *diag) {
 }
 
 Vector2D VisualToolBase::GetLineOrigin(AssDialogue *diag) {
-	auto blocks = diag->ParseTags();
+	AssParsedText blocks(diag->Text);
 	return vec_or_bad(find_tag(blocks, "\\org"), 0, 1);
 }
 
 bool VisualToolBase::GetLineMove(AssDialogue *diag, Vector2D &p1, Vector2D &p2, int &t1, int &t2) {
-	auto blocks = diag->ParseTags();
+	AssParsedText blocks(diag->Text);
 
 	param_vec tag = find_tag(blocks, "\\move");
 	if (!tag)
@@ -431,8 +425,8 @@ bool VisualToolBase::GetLineMove(AssDialogue *diag, Vector2D &p1, Vector2D &p2,
 	p1 = vec_or_bad(tag, 0, 1);
 	p2 = vec_or_bad(tag, 2, 3);
 	// VSFilter actually defaults to -1, but it uses <= 0 to check for default and 0 seems less bug-prone
-	t1 = (*tag)[4].Get<int>(0);
-	t2 = (*tag)[5].Get<int>(0);
+	t1 = tag[4].Get<int>(0);
+	t2 = tag[5].Get<int>(0);
 
 	return p1 && p2;
 }
@@ -443,27 +437,27 @@ void VisualToolBase::GetLineRotation(AssDialogue *diag, float &rx, float &ry, fl
 	if (AssStyle *style = c->ass->GetStyle(diag->Style))
 		rz = style->angle;
 
-	auto blocks = diag->ParseTags();
+	AssParsedText blocks(diag->Text);
 
 	if (param_vec tag = find_tag(blocks, "\\frx"))
-		rx = tag->front().Get(rx);
+		rx = tag.front().Get(rx);
 	if (param_vec tag = find_tag(blocks, "\\fry"))
-		ry = tag->front().Get(ry);
+		ry = tag.front().Get(ry);
 	if (param_vec tag = find_tag(blocks, "\\frz"))
-		rz = tag->front().Get(rz);
+		rz = tag.front().Get(rz);
 	else if ((tag = find_tag(blocks, "\\fr")))
-		rz = tag->front().Get(rz);
+		rz = tag.front().Get(rz);
 }
 
 void VisualToolBase::GetLineShear(AssDialogue *diag, float& fax, float& fay) {
 	fax = fay = 0.f;
 
-	auto blocks = diag->ParseTags();
+	AssParsedText blocks(diag->Text);
 
 	if (param_vec tag = find_tag(blocks, "\\fax"))
-		fax = tag->front().Get(fax);
+		fax = tag.front().Get(fax);
 	if (param_vec tag = find_tag(blocks, "\\fay"))
-		fay = tag->front().Get(fay);
+		fay = tag.front().Get(fay);
 }
 
 void VisualToolBase::GetLineScale(AssDialogue *diag, Vector2D &scale) {
@@ -474,12 +468,12 @@ void VisualToolBase::GetLineScale(AssDialogue *diag, Vector2D &scale) {
 		y = style->scaley;
 	}
 
-	auto blocks = diag->ParseTags();
+	AssParsedText blocks(diag->Text);
 
 	if (param_vec tag = find_tag(blocks, "\\fscx"))
-		x = tag->front().Get(x);
+		x = tag.front().Get(x);
 	if (param_vec tag = find_tag(blocks, "\\fscy"))
-		y = tag->front().Get(y);
+		y = tag.front().Get(y);
 
 	scale = Vector2D(x, y);
 }
@@ -492,16 +486,16 @@ void VisualToolBase::GetLineOutline(AssDialogue *diag, Vector2D &outline) {
 		y = style->outline_w;
 	}
 
-	auto blocks = diag->ParseTags();
+	AssParsedText blocks(diag->Text);
 
 	if (param_vec tag = find_tag(blocks, "\\bord")) {
-		x = tag->front().Get(x);
-		y = tag->front().Get(y);
+		x = tag.front().Get(x);
+		y = tag.front().Get(y);
 	}
 	if (param_vec tag = find_tag(blocks, "\\xbord"))
-		x = tag->front().Get(x);
+		x = tag.front().Get(x);
 	if (param_vec tag = find_tag(blocks, "\\ybord"))
-		y = tag->front().Get(y);
+		y = tag.front().Get(y);
 
 	outline = Vector2D(x, y);
 }
@@ -514,16 +508,16 @@ void VisualToolBase::GetLineShadow(AssDialogue *diag, Vector2D &shadow) {
 		y = style->shadow_w;
 	}
 
-	auto blocks = diag->ParseTags();
+	AssParsedText blocks(diag->Text);
 
 	if (param_vec tag = find_tag(blocks, "\\shad")) {
-		x = tag->front().Get(x);
-		y = tag->front().Get(y);
+		x = tag.front().Get(x);
+		y = tag.front().Get(y);
 	}
 	if (param_vec tag = find_tag(blocks, "\\xshad"))
-		x = tag->front().Get(x);
+		x = tag.front().Get(x);
 	if (param_vec tag = find_tag(blocks, "\\yshad"))
-		y = tag->front().Get(y);
+		y = tag.front().Get(y);
 
 	shadow = Vector2D(x, y);
 }
@@ -533,9 +527,9 @@ int VisualToolBase::GetLineAlignment(AssDialogue *diag) {
 
 	if (AssStyle *style = c->ass->GetStyle(diag->Style))
 		an = style->alignment;
-	auto blocks = diag->ParseTags();
+	AssParsedText blocks(diag->Text);
 	if (param_vec tag = find_tag(blocks, "\\an"))
-		an = tag->front().Get(an);
+		an = tag.front().Get(an);
 
 	return an;
 }
@@ -553,11 +547,11 @@ void VisualToolBase::GetLineBaseExtents(AssDialogue *diag, double &width, double
 		style.scaley = 100.;
 	}
 
-	auto blocks = diag->ParseTags();
+	AssParsedText blocks(diag->Text);
 	if (param_vec tag = find_tag(blocks, "\\fs"))
-		style.fontsize = tag->front().Get(style.fontsize);
+		style.fontsize = tag.front().Get(style.fontsize);
 	if (param_vec tag = find_tag(blocks, "\\fn"))
-		style.font = tag->front().Get(style.font);
+		style.font = tag.front().Get(style.font);
 
 	std::string text = diag->GetStrippedText();
 	std::vector<std::string> textlines;
@@ -579,14 +573,14 @@ void VisualToolBase::GetLineBaseExtents(AssDialogue *diag, double &width, double
 void VisualToolBase::GetLineClip(AssDialogue *diag, Vector2D &p1, Vector2D &p2, bool &inverse) {
 	inverse = false;
 
-	auto blocks = diag->ParseTags();
+	AssParsedText blocks(diag->Text);
 	param_vec tag = find_tag(blocks, "\\iclip");
 	if (tag)
 		inverse = true;
 	else
 		tag = find_tag(blocks, "\\clip");
 
-	if (tag && tag->size() == 4) {
+	if (tag && tag.size() == 4) {
 		p1 = vec_or_bad(tag, 0, 1);
 		p2 = vec_or_bad(tag, 2, 3);
 	}
@@ -597,7 +591,7 @@ void VisualToolBase::GetLineClip(AssDialogue *diag, Vector2D &p1, Vector2D &p2,
 }
 
 std::string VisualToolBase::GetLineVectorClip(AssDialogue *diag, int &scale, bool &inverse) {
-	auto blocks = diag->ParseTags();
+	AssParsedText blocks(diag->Text);
 
 	scale = 1;
 	inverse = false;
@@ -608,16 +602,16 @@ std::string VisualToolBase::GetLineVectorClip(AssDialogue *diag, int &scale, boo
 	else
 		tag = find_tag(blocks, "\\clip");
 
-	if (tag && tag->size() == 4) {
+	if (tag && tag.size() == 4) {
 		return agi::format("m %.2f %.2f l %.2f %.2f %.2f %.2f %.2f %.2f"
-			, (*tag)[0].Get<double>(), (*tag)[1].Get<double>()
-			, (*tag)[2].Get<double>(), (*tag)[1].Get<double>()
-			, (*tag)[2].Get<double>(), (*tag)[3].Get<double>()
-			, (*tag)[0].Get<double>(), (*tag)[3].Get<double>());
+			, tag[0].Get<double>(), tag[1].Get<double>()
+			, tag[2].Get<double>(), tag[1].Get<double>()
+			, tag[2].Get<double>(), tag[3].Get<double>()
+			, tag[0].Get<double>(), tag[3].Get<double>());
 	}
 	if (tag) {
-		scale = std::max((*tag)[0].Get(scale), 1);
-		return (*tag)[1].Get<std::string>("");
+		scale = std::max(tag[0].Get(scale), 1);
+		return tag[1].Get<std::string>("");
 	}
 
 	return "";
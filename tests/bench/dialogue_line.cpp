@@ -0,0 +1,166 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+// Compares splitting dialogue lines with ParseDialogueFields against the
+// tokenizer, lexical_cast and regex based parsing AssDialogue used before it.
+// Run with `meson test --benchmark`.
+
+#include <libaegisub/ass/dialogue_line.h>
+#include <libaegisub/split.h>
+#include <libaegisub/util.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/regex.hpp>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+struct Fields {
+	bool comment;
+	int layer;
+	std::string start, end, style, actor, effect, text;
+	std::array<int, 3> margin;
+	std::vector<uint32_t> extradata_ids;
+};
+
+class tokenizer {
+	agi::StringRange str;
+	agi::split_iterator<agi::StringRange::const_iterator> pos;
+
+public:
+	tokenizer(agi::StringRange const& str) : str(str) , pos(agi::Split(str, ',')) { }
+
+	agi::StringRange next_tok() {
+		if (pos.eof())
+			throw std::runtime_error("Failed parsing line: " + std::string(str.begin(), str.end()));
+		return *pos++;
+	}
+
+	std::string next_str() { return agi::str(next_tok()); }
+	std::string next_str_trim() { return agi::str(boost::trim_copy(next_tok())); }
+};
+
+void parse_old(std::string const& raw, Fields& out) {
+	agi::StringRange str;
+	if (boost::starts_with(raw, "Dialogue:")) {
+		out.comment = false;
+		str = agi::StringRange(raw.begin() + 10, raw.end());
+	}
+	else {
+		out.comment = true;
+		str = agi::StringRange(raw.begin() + 9, raw.end());
+	}
+
+	tokenizer tkn(str);
+	auto tmp = tkn.next_str_trim();
+	out.layer = boost::istarts_with(tmp, "marked=") ? 0 : boost::lexical_cast<int>(tmp);
+	out.start = tkn.next_str_trim();
+	out.end = tkn.next_str_trim();
+	out.style = tkn.next_str_trim();
+	out.actor = tkn.next_str_trim();
+	for (int& margin : out.margin)
+		margin = agi::util::mid(-9999, boost::lexical_cast<int>(tkn.next_str()), 99999);
+	out.effect = tkn.next_str_trim();
+
+	std::string text{tkn.next_tok().begin(), str.end()};
+	if (text.size() > 1 && text[0] == '{' && text[1] == '=') {
+		static const boost::regex extradata_test("^\\{(=\\d+)+\\}");
+		boost::match_results<std::string::iterator> rematch;
+		if (boost::regex_search(text.begin(), text.end(), rematch, extradata_test)) {
+			std::string extradata_str = rematch.str(0);
+			text = rematch.suffix().str();
+
+			static const boost::regex idmatcher("=(\\d+)");
+			auto start = extradata_str.begin();
+			auto end = extradata_str.end();
+			std::vector<uint32_t> ids;
+			while (boost::regex_search(start, end, rematch, idmatcher)) {
+				ids.push_back(boost::lexical_cast<uint32_t>(rematch.str(1)));
+				start = rematch.suffix().first;
+			}
+			out.extradata_ids = ids;
+		}
+	}
+	out.text = text;
+}
+
+void parse_new(std::string const& raw, Fields& out) {
+	agi::ass::DialogueFields fields;
+	if (!agi::ass::ParseDialogueFields(raw, fields))
+		return parse_old(raw, out);
+
+	out.comment = fields.comment;
+	out.layer = fields.layer;
+	out.start = agi::str(fields.start);
+	out.end = agi::str(fields.end);
+	out.style = agi::str(fields.style);
+	out.actor = agi::str(fields.actor);
+	out.margin = fields.margin;
+	out.effect = agi::str(fields.effect);
+	if (fields.has_extradata)
+		out.extradata_ids = fields.extradata_ids;
+	out.text = agi::str(fields.text);
+}
+
+std::vector<std::string> make_lines(size_t count) {
+	const char *texts[] = {
+		"Short line",
+		"{\\an8\\pos(640,40)}A typeset sign with a few {\\i1}override{\\i0} tags",
+		"{=12=345}{\\k20}Ka{\\k15}ra{\\k30}o{\\k25}ke",
+		"{\\fad(150,150)\\blur0.6\\bord2\\3c&H202020&}A longer line of dialogue\\Nsplit over two rows",
+	};
+
+	std::vector<std::string> lines;
+	lines.reserve(count);
+	char buf[64];
+	for (size_t i = 0; i < count; ++i) {
+		int cs = static_cast<int>(i * 37 % 360000);
+		snprintf(buf, sizeof buf, "%d:%02d:%02d.%02d", cs / 360000, cs / 6000 % 60, cs / 100 % 60, cs % 100);
+		std::string time = buf;
+		lines.push_back((i % 9 ? "Dialogue: " : "Comment: ") + std::to_string(i % 4) + "," + time + "," + time +
+			",Default,Speaker " + std::to_string(i % 5) + ",0,0,0,," + texts[i % 4]);
+	}
+	return lines;
+}
+
+template<typename Func>
+double lines_per_second(std::vector<std::string> const& lines, Func&& parse) {
+	Fields fields;
+	size_t checksum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < 5; ++pass) {
+		for (auto const& line : lines) {
+			parse(line, fields);
+			checksum += fields.text.size() + fields.layer;
+		}
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	if (!checksum) puts("");
+	return 5 * lines.size() / elapsed.count();
+}
+}
+
+int main() {
+	auto lines = make_lines(100000);
+
+	double before = lines_per_second(lines, parse_old);
+	double after = lines_per_second(lines, parse_new);
+	printf("tokenizer and regex:  %12.0f lines/s\n", before);
+	printf("ParseDialogueFields:  %12.0f lines/s\n", after);
+	printf("speedup:              %12.2fx\n", after / before);
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+// Compares looking up override tag prototypes with PrefixMatcher against
+// checking each prototype name in turn, as AssOverrideTag::SetText did.
+// Run with `meson test --benchmark`.
+
+#include <libaegisub/prefix_matcher.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace {
+// The names of the tag prototypes in ass_override.cpp, in the same order
+const char *tag_names[] = {
+	"\\alpha", "\\bord", "\\xbord", "\\ybord", "\\shad", "\\xshad", "\\yshad",
+	"\\fade", "\\move", "\\clip", "\\clip", "\\iclip", "\\iclip", "\\fscx",
+	"\\fscy", "\\pos", "\\org", "\\pbo", "\\fad", "\\fsp", "\\frx", "\\fry",
+	"\\frz", "\\fr", "\\fax", "\\fay", "\\1c", "\\2c", "\\3c", "\\4c", "\\1a",
+	"\\2a", "\\3a", "\\4a", "\\fe", "\\ko", "\\kf", "\\be", "\\blur", "\\fn",
+	"\\fs+", "\\fs-", "\\fs", "\\an", "\\c", "\\b", "\\i", "\\u", "\\s", "\\a",
+	"\\k", "\\K", "\\q", "\\p", "\\r", "\\t",
+};
+
+// Override blocks typical of typesetting and karaoke, weighted towards the
+// tags which are usually most common
+const char *blocks[] = {
+	"\\an7\\pos(512.33,208.5)\\fscx112\\fscy112\\frz-3.2\\fax0.05\\bord0\\shad0\\1c&H2A2F35&\\blur0.6",
+	"\\an5\\move(640,360,700,360,0,500)\\fad(120,120)\\fnArial\\fs48\\b1\\3c&HFFFFFF&\\4a&HFF&",
+	"\\clip(m 0 0 l 1280 0 1280 720 0 720)\\t(0,300,\\frx20\\fry-10)\\org(640,360)",
+	"\\k12", "\\kf25\\1c&H0000FF&", "\\K30", "\\ko15",
+	"\\i1", "\\u0\\s0", "\\p1", "\\r", "\\rDefault\\be1", "\\xbord2\\ybord1\\xshad1\\yshad2",
+	"\\1a&H80&\\2a&H80&\\3a&H00&\\alpha&H40&", "\\iclip(10,20,300,400)\\q2",
+	"\\fsp1.5\\fs+2\\fs-1\\fe128\\pbo-10", "\\fade(255,0,255,0,100,200,300)",
+	"\\notarealtag\\xyz10",
+};
+
+std::vector<std::string> make_tags(size_t count) {
+	std::vector<std::string> tags;
+	std::mt19937 rng(1);
+	while (tags.size() < count) {
+		std::string block = blocks[rng() % (sizeof(blocks) / sizeof(blocks[0]))];
+		size_t start = 0;
+		int depth = 0;
+		for (size_t i = 1; i <= block.size(); ++i) {
+			if (i == block.size() || (depth == 0 && block[i] == '\\')) {
+				tags.push_back(block.substr(start, i - start));
+				start = i;
+			}
+			else if (block[i] == '(') ++depth;
+			else if (block[i] == ')') --depth;
+		}
+	}
+	return tags;
+}
+
+template<typename Func>
+double tags_per_second(std::vector<std::string> const& tags, Func&& find, long& checksum) {
+	auto start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < 20; ++pass) {
+		for (auto const& tag : tags)
+			checksum += find(tag);
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return 20 * tags.size() / elapsed.count();
+}
+}
+
+int main() {
+	std::vector<std::string> names(std::begin(tag_names), std::end(tag_names));
+	agi::PrefixMatcher matcher(names);
+	auto tags = make_tags(100000);
+
+	for (auto const& tag : tags) {
+		int expected = -1;
+		for (size_t i = 0; i < names.size() && expected < 0; ++i) {
+			if (boost::starts_with(tag, names[i]))
+				expected = static_cast<int>(i);
+		}
+		if (matcher.Find(tag) != expected) {
+			printf("mismatch for %s\n", tag.c_str());
+			return 1;
+		}
+	}
+
+	long linear_sum = 0, trie_sum = 0;
+	double before = tags_per_second(tags, [&](std::string const& tag) {
+		for (size_t i = 0; i < names.size(); ++i) {
+			if (boost::starts_with(tag, names[i]))
+				return static_cast<int>(i);
+		}
+		return -1;
+	}, linear_sum);
+	double after = tags_per_second(tags, [&](std::string const& tag) { return matcher.Find(tag); }, trie_sum);
+
+	printf("linear starts_with: %12.0f tags/s\n", before);
+	printf("PrefixMatcher:      %12.0f tags/s\n", after);
+	printf("speedup:            %12.2fx\n", after / before);
+	return linear_sum == trie_sum ? 0 : 1;
+}
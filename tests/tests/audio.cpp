@@ -16,7 +16,9 @@
 
 #include <main.h>
 
+#include <libaegisub/audio/peaks.h>
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/audio/read_ahead.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/make_unique.h>
 #include <libaegisub/path.h>
@@ -24,6 +26,12 @@
 
 #include <boost/filesystem/fstream.hpp>
 
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <thread>
+
 namespace bfs = boost::filesystem;
 
 TEST(lagi_audio, dummy_blank) {
@@ -217,6 +225,35 @@ TEST(lagi_audio, ram_cache) {
 		ASSERT_EQ(static_cast<uint16_t>((1 << 22) - 256 + i), buff[i]);
 }
 
+TEST(lagi_audio, ram_cache_uneven_frames) {
+	// Six byte frames don't divide the cache block size, so two full blocks
+	// of samples need slightly more than two blocks' worth of bytes
+	struct ThreeChannelProvider : TestAudioProvider<int16_t> {
+		ThreeChannelProvider() {
+			channels = 3;
+			num_samples = 2 * ((1 << 22) / 6) + 1;
+			decoded_samples = num_samples;
+		}
+
+		void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+			auto out = static_cast<int16_t *>(buf);
+			for (int64_t end = start + count; start < end; ++start) {
+				for (int c = 0; c < 3; ++c)
+					*out++ = (int16_t)start;
+			}
+		}
+	};
+
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<ThreeChannelProvider>());
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	int64_t last = provider->GetNumSamples() - 1;
+	int16_t buff[6];
+	provider->GetAudio(buff, last - 1, 2);
+	for (size_t i = 0; i < 6; ++i)
+		ASSERT_EQ(static_cast<int16_t>(last - 1 + i / 3), buff[i]);
+}
+
 TEST(lagi_audio, hd_cache) {
 	auto provider = agi::CreateHDAudioProvider(agi::make_unique<TestAudioProvider<>>(), agi::Path().Decode("?temp"));
 	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
@@ -228,6 +265,261 @@ TEST(lagi_audio, hd_cache) {
 		ASSERT_EQ(static_cast<uint16_t>((1 << 22) - 256 + i), buff[i]);
 }
 
+TEST(lagi_audio, hd_cache_persistent) {
+	auto dir = agi::Path().Decode("?temp");
+	auto persistent = dir / "persistent_audio_cache.pcm";
+	if (agi::fs::FileExists(persistent)) agi::fs::Remove(persistent);
+
+	{
+		auto provider = agi::CreateHDAudioProvider(agi::make_unique<TestAudioProvider<>>(1), dir, agi::fs::path(), persistent);
+		// Saving happens after decoding finishes and is abandoned if the
+		// provider is closed first
+		while (!agi::fs::FileExists(persistent)) agi::util::sleep_for(1);
+	}
+	EXPECT_EQ(32u + 48000 * 2, agi::fs::Size(persistent));
+
+	// The saved audio is used as is rather than decoding the source again
+	auto source = agi::make_unique<TestAudioProvider<>>(1);
+	source->bias = 100;
+	auto provider = agi::CreateHDAudioProvider(std::move(source), dir, agi::fs::path(), persistent);
+	EXPECT_EQ(provider->GetNumSamples(), provider->GetDecodedSamples());
+
+	uint16_t buff[16];
+	provider->GetAudio(buff, 1000, 16);
+	for (size_t i = 0; i < 16; ++i)
+		ASSERT_EQ(1000 + i, buff[i]);
+	provider.reset();
+
+	// A different format or length isn't mistaken for the saved audio
+	provider = agi::CreateHDAudioProvider(agi::make_unique<TestAudioProvider<>>(2), dir, agi::fs::path(), persistent);
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+	provider->GetAudio(buff, 50000, 16);
+	for (size_t i = 0; i < 16; ++i)
+		ASSERT_EQ(50000 + i, buff[i]);
+	while (agi::fs::Size(persistent) != 32u + 2 * 48000 * 2) agi::util::sleep_for(1);
+	provider.reset();
+
+	agi::fs::Remove(persistent);
+}
+
+TEST(lagi_audio, ram_cache_spans) {
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<>>());
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	// Spans stop at the end of each cache block
+	const void *data = nullptr;
+	ASSERT_EQ(256, provider->GetSpan((1 << 21) - 256, 512, &data));
+	auto samples = static_cast<const uint16_t *>(data);
+	for (size_t i = 0; i < 256; ++i)
+		ASSERT_EQ(static_cast<uint16_t>((1 << 21) - 256 + i), samples[i]);
+
+	ASSERT_EQ(256, provider->GetSpan(1 << 21, 256, &data));
+	EXPECT_EQ(static_cast<uint16_t>(1 << 21), *static_cast<const uint16_t *>(data));
+
+	EXPECT_EQ(0, provider->GetSpan(-1, 10, &data));
+	EXPECT_EQ(10, provider->GetSpan(provider->GetNumSamples() - 10, 20, &data));
+	EXPECT_EQ(0, provider->GetSpan(provider->GetNumSamples(), 10, &data));
+}
+
+TEST(lagi_audio, hd_cache_spans) {
+	auto provider = agi::CreateHDAudioProvider(agi::make_unique<TestAudioProvider<>>(), agi::Path().Decode("?temp"));
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	if (sizeof(size_t) < 8) return;
+
+	const void *data = nullptr;
+	ASSERT_EQ(512, provider->GetSpan((1 << 22) - 256, 512, &data));
+	auto samples = static_cast<const uint16_t *>(data);
+	for (size_t i = 0; i < 512; ++i)
+		ASSERT_EQ(static_cast<uint16_t>((1 << 22) - 256 + i), samples[i]);
+}
+
+TEST(lagi_audio, volume_from_spans) {
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<>>());
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	// Crosses a cache block and runs off both ends of the audio
+	int16_t buff[512];
+	provider->GetAudioWithVolume(buff, (1 << 21) - 256, 512, 0.5);
+	for (size_t i = 0; i < 512; ++i)
+		ASSERT_EQ(static_cast<int16_t>((int16_t)((1 << 21) - 256 + i) * 0.5), buff[i]);
+
+	provider->GetAudioWithVolume(buff, -256, 512, 2.0);
+	for (size_t i = 0; i < 256; ++i)
+		ASSERT_EQ(0, buff[i]);
+	for (size_t i = 256; i < 512; ++i)
+		ASSERT_EQ(static_cast<int16_t>((i - 256) * 2), buff[i]);
+
+	provider->GetAudioWithVolume(buff, provider->GetNumSamples() - 256, 512, 2.0);
+	for (size_t i = 256; i < 512; ++i)
+		ASSERT_EQ(0, buff[i]);
+}
+
+TEST(lagi_audio, peaks_match_samples) {
+	TestAudioProvider<int16_t> provider(2);
+	provider.bias = -20000;
+
+	std::vector<int16_t> samples(provider.GetNumSamples());
+	provider.GetInt16MonoAudio(samples.data(), 0, samples.size());
+
+	agi::AudioPeakPyramid peaks(provider.GetNumSamples());
+	peaks.Append(samples.data(), 1000);
+	peaks.Append(samples.data() + 1000, samples.size() - 1000);
+	ASSERT_TRUE(peaks.IsComplete());
+
+	for (int64_t start : {-100, 0, 1, 255, 256, 4095, 65536, 70000, 95000}) {
+		for (int64_t count : {1, 255, 256, 1000, 4096, 65536, 70000}) {
+			SCOPED_TRACE(start);
+			SCOPED_TRACE(count);
+			agi::AudioPeak expected;
+			for (int64_t i = std::max<int64_t>(start, 0); i < std::min<int64_t>(start + count, samples.size()); ++i)
+				expected.Add(samples[i]);
+
+			auto actual = peaks.Query(provider, start, count);
+			EXPECT_EQ(expected.min, actual.min);
+			EXPECT_EQ(expected.max, actual.max);
+			EXPECT_EQ(expected.pos_sum, actual.pos_sum);
+			EXPECT_EQ(expected.neg_sum, actual.neg_sum);
+		}
+	}
+}
+
+TEST(lagi_audio, peaks_partially_built) {
+	TestAudioProvider<int16_t> provider(1);
+
+	std::vector<int16_t> samples(1000);
+	provider.GetInt16MonoAudio(samples.data(), 0, samples.size());
+
+	agi::AudioPeakPyramid peaks(provider.GetNumSamples());
+	peaks.Append(samples.data(), samples.size());
+	EXPECT_FALSE(peaks.IsComplete());
+
+	// Everything past what has been appended is read from the provider
+	auto actual = peaks.Query(provider, 0, 5000);
+	EXPECT_EQ(4999, actual.max);
+	EXPECT_EQ(4999 * 5000 / 2, actual.pos_sum);
+}
+
+TEST(lagi_audio, peaks_save_and_load) {
+	auto path = agi::Path().Decode("?temp/peaks");
+	agi::fs::Remove(path);
+
+	TestAudioProvider<int16_t> provider(1);
+	std::vector<int16_t> samples(provider.GetNumSamples());
+	provider.GetInt16MonoAudio(samples.data(), 0, samples.size());
+
+	agi::AudioPeakPyramid peaks(provider.GetNumSamples());
+	peaks.Append(samples.data(), samples.size());
+	peaks.Save(path);
+
+	agi::AudioPeakPyramid wrong_length(provider.GetNumSamples() - 1);
+	EXPECT_FALSE(wrong_length.Load(path));
+
+	agi::AudioPeakPyramid loaded(provider.GetNumSamples());
+	ASSERT_TRUE(loaded.Load(path));
+	EXPECT_TRUE(loaded.IsComplete());
+	EXPECT_EQ(peaks.Query(provider, 300, 40000).pos_sum, loaded.Query(provider, 300, 40000).pos_sum);
+
+	agi::fs::Remove(path);
+}
+
+TEST(lagi_audio, ram_cache_peaks) {
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<int16_t>>(1));
+	ASSERT_NE(nullptr, provider->GetPeaks());
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+	while (!provider->GetPeaks()->IsComplete()) agi::util::sleep_for(0);
+
+	auto peak = provider->GetPeaks()->Query(*provider, 0, provider->GetNumSamples());
+	EXPECT_EQ(SHRT_MAX, peak.max);
+	EXPECT_EQ(SHRT_MIN, peak.min);
+}
+
+/// Source which can be decoded out of order, and which records the order in
+/// which it was read and can be made to hold reads until released
+struct ConcurrentAudioProvider : TestAudioProvider<int16_t> {
+	std::atomic<bool> blocked{false};
+	mutable std::mutex lock;
+	mutable std::vector<int64_t> reads;
+
+	ConcurrentAudioProvider(int64_t duration) : TestAudioProvider<int16_t>(duration) { }
+
+	bool SupportsConcurrentReads() const override { return true; }
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		while (blocked) agi::util::sleep_for(1);
+		{
+			std::lock_guard<std::mutex> l(lock);
+			reads.push_back(start);
+		}
+		TestAudioProvider<int16_t>::FillBuffer(buf, start, count);
+	}
+};
+
+TEST(lagi_audio, concurrent_cache_decoding) {
+	for (int hd = 0; hd < 2; ++hd) {
+		auto source = agi::make_unique<ConcurrentAudioProvider>(30);
+		auto provider = hd
+			? agi::CreateHDAudioProvider(std::move(source), agi::Path().Decode("?temp"))
+			: agi::CreateRAMAudioProvider(std::move(source));
+		while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+		while (!provider->GetPeaks()->IsComplete()) agi::util::sleep_for(0);
+		EXPECT_TRUE(provider->IsRangeDecoded(0, provider->GetNumSamples()));
+
+		std::vector<int16_t> buff(provider->GetNumSamples());
+		provider->GetAudio(buff.data(), 0, buff.size());
+		for (size_t i = 0; i < buff.size(); ++i)
+			ASSERT_EQ(static_cast<int16_t>(i), buff[i]);
+
+		// The peaks were built in order even if the chunks weren't decoded in order
+		auto peak = provider->GetPeaks()->Query(*provider, 0, provider->GetNumSamples());
+		EXPECT_EQ(SHRT_MAX, peak.max);
+		EXPECT_EQ(SHRT_MIN, peak.min);
+		int64_t pos_sum = 0, neg_sum = 0;
+		for (auto sample : buff)
+			(sample > 0 ? pos_sum : neg_sum) += sample;
+		EXPECT_EQ(pos_sum, peak.pos_sum);
+		EXPECT_EQ(neg_sum, peak.neg_sum);
+	}
+}
+
+TEST(lagi_audio, concurrent_cache_prioritized) {
+	for (int hd = 0; hd < 2; ++hd) {
+		auto source = agi::make_unique<ConcurrentAudioProvider>(600);
+		source->blocked = true;
+		auto raw_source = source.get();
+		auto provider = hd
+			? agi::CreateHDAudioProvider(std::move(source), agi::Path().Decode("?temp"))
+			: agi::CreateRAMAudioProvider(std::move(source));
+
+		// Nothing is available until it's been decoded
+		const int64_t wanted = 500 * 48000;
+		EXPECT_FALSE(provider->IsRangeDecoded(wanted, 16));
+		int16_t buff[16];
+		provider->GetAudio(buff, wanted, 16);
+		for (auto sample : buff)
+			ASSERT_EQ(0, sample);
+
+		provider->PrioritizeDecoding(wanted);
+		raw_source->blocked = false;
+		while (!provider->IsRangeDecoded(wanted, 16)) agi::util::sleep_for(0);
+
+		provider->GetAudio(buff, wanted, 16);
+		for (size_t i = 0; i < 16; ++i)
+			ASSERT_EQ(static_cast<int16_t>(wanted + i), buff[i]);
+
+		// Only chunks which the workers had claimed before the priority was
+		// set, or claimed alongside the wanted one, were read before it
+		const int64_t chunk_size = hd ? 65536 : 1 << 21;
+		std::lock_guard<std::mutex> lock(raw_source->lock);
+		auto& reads = raw_source->reads;
+		auto wanted_read = find_if(begin(reads), end(reads), [&](int64_t start) {
+			return start <= wanted && wanted < start + chunk_size;
+		});
+		ASSERT_NE(end(reads), wanted_read);
+		EXPECT_LT(distance(begin(reads), wanted_read), 8);
+	}
+}
+
 TEST(lagi_audio, convert_8bit) {
 	auto provider = agi::CreateConvertAudioProvider(agi::make_unique<TestAudioProvider<uint8_t>>());
 
@@ -358,6 +650,256 @@ TEST(lagi_audio, double_conversion) {
 		ASSERT_EQ(i + SHRT_MIN, samples[i]);
 }
 
+/// Provider returning a fixed buffer of interleaved samples
+template<typename Sample>
+struct ArrayAudioProvider : agi::AudioProvider {
+	std::vector<Sample> samples;
+
+	ArrayAudioProvider(std::vector<Sample> samples, int channels, bool is_float = false)
+	: samples(std::move(samples))
+	{
+		this->channels = channels;
+		num_samples = this->samples.size() / channels;
+		decoded_samples = num_samples;
+		sample_rate = 48000;
+		bytes_per_sample = sizeof(Sample);
+		float_samples = is_float;
+	}
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		memcpy(buf, &samples[start * channels], count * channels * sizeof(Sample));
+	}
+};
+
+TEST(lagi_audio, downmix_rounds_towards_zero) {
+	// Long enough to go through both the vectorized loop and the tail
+	for (int channels : {2, 3, 6}) {
+		SCOPED_TRACE(channels);
+		std::vector<int16_t> samples;
+		for (int i = 0; i < 1001; ++i) {
+			for (int c = 0; c < channels; ++c)
+				samples.push_back(static_cast<int16_t>(c == 0 ? i * 61 - 30000 : (i * 37 + c * 11) % 7 - 3));
+		}
+		ArrayAudioProvider<int16_t> provider(samples, channels);
+
+		std::vector<int16_t> mono(1001);
+		provider.GetInt16MonoAudio(mono.data(), 0, mono.size());
+		for (int i = 0; i < 1001; ++i) {
+			int sum = 0;
+			for (int c = 0; c < channels; ++c)
+				sum += samples[i * channels + c];
+			ASSERT_EQ(sum / channels, mono[i]) << i;
+		}
+	}
+}
+
+TEST(lagi_audio, float_conversion_clamps) {
+	std::vector<float> samples;
+	for (int i = 0; i < 100; ++i)
+		samples.push_back((i - 50) / 25.f);
+	ArrayAudioProvider<float> provider(samples, 1, true);
+
+	int16_t out[100];
+	provider.GetInt16MonoAudio(out, 0, 100);
+	for (int i = 0; i < 100; ++i) {
+		float expanded = samples[i] * 32768;
+		int16_t expected = expanded < -32768 ? -32768 : expanded > 32767 ? 32767 : static_cast<int16_t>(expanded);
+		ASSERT_EQ(expected, out[i]) << i;
+	}
+}
+
+TEST(lagi_audio, int32_stereo_conversion) {
+	std::vector<int32_t> samples;
+	for (int i = 0; i < 999; ++i) {
+		samples.push_back(static_cast<int32_t>(i * 4000000LL - 2000000000));
+		samples.push_back(-i * 65536 - 1);
+	}
+	ArrayAudioProvider<int32_t> provider(samples, 2);
+
+	std::vector<int16_t> out(999);
+	provider.GetInt16MonoAudio(out.data(), 0, out.size());
+	for (int i = 0; i < 999; ++i)
+		ASSERT_EQ(((samples[i * 2] >> 16) + (samples[i * 2 + 1] >> 16)) / 2, out[i]) << i;
+}
+
+TEST(lagi_audio, uint8_stereo_conversion) {
+	std::vector<uint8_t> samples;
+	for (int i = 0; i < 777; ++i) {
+		samples.push_back(static_cast<uint8_t>(i));
+		samples.push_back(static_cast<uint8_t>(255 - i));
+	}
+	ArrayAudioProvider<uint8_t> provider(samples, 2);
+
+	std::vector<int16_t> out(777);
+	provider.GetInt16MonoAudio(out.data(), 0, out.size());
+	for (int i = 0; i < 777; ++i)
+		ASSERT_EQ(((samples[i * 2] - 128) * 256 + (samples[i * 2 + 1] - 128) * 256) / 2, out[i]) << i;
+}
+
+TEST(lagi_audio, compressed_ram_cache) {
+	auto provider = agi::CreateCompressedRAMAudioProvider(agi::make_unique<TestAudioProvider<>>());
+	EXPECT_EQ(1, provider->GetChannels());
+	EXPECT_EQ(90 * 48000, provider->GetNumSamples());
+	EXPECT_EQ(2, provider->GetBytesPerSample());
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	// Read across every block boundary, more times than there are hot blocks
+	uint16_t buff[512];
+	for (int64_t boundary = 1 << 19; boundary < provider->GetNumSamples(); boundary += 1 << 19) {
+		provider->GetAudio(buff, boundary - 256, 512);
+		for (size_t i = 0; i < 512; ++i)
+			ASSERT_EQ(static_cast<uint16_t>(boundary - 256 + i), buff[i]);
+	}
+
+	provider->GetAudio(buff, provider->GetNumSamples() - 256, 512);
+	for (size_t i = 0; i < 256; ++i)
+		ASSERT_EQ(static_cast<uint16_t>(provider->GetNumSamples() - 256 + i), buff[i]);
+	for (size_t i = 256; i < 512; ++i)
+		ASSERT_EQ(0, buff[i]);
+}
+
+TEST(lagi_audio, compressed_ram_cache_is_lossless) {
+	std::mt19937 rng(1);
+	std::normal_distribution<float> noise(0, 0.01f);
+
+	std::vector<float> float_samples;
+	for (int i = 0; i < 300000; ++i) {
+		float_samples.push_back(0.5f * std::sin(i * 0.01f) + noise(rng));
+		float_samples.push_back(-0.5f * std::sin(i * 0.02f) + noise(rng));
+	}
+	for (float special : {0.f, -0.f, 1.f, -1.f, 1e-40f, -1e-40f, std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::max()})
+		float_samples.push_back(special);
+
+	std::vector<int32_t> int_samples;
+	for (int i = 0; i < 200000; ++i) {
+		for (int c = 0; c < 3; ++c)
+			int_samples.push_back(static_cast<int32_t>(rng()));
+	}
+
+	auto check = [](std::unique_ptr<agi::AudioProvider> source) {
+		auto num_samples = source->GetNumSamples();
+		auto frame_size = source->GetBytesPerSample() * source->GetChannels();
+		std::vector<char> expected(num_samples * frame_size);
+		source->GetAudio(expected.data(), 0, num_samples);
+
+		auto provider = agi::CreateCompressedRAMAudioProvider(std::move(source));
+		while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+		std::vector<char> actual(expected.size());
+		provider->GetAudio(actual.data(), 0, num_samples);
+		EXPECT_TRUE(expected == actual);
+	};
+
+	check(agi::make_unique<ArrayAudioProvider<float>>(float_samples, 2, true));
+	// Random data doesn't compress, so this goes through the uncompressed fallback
+	check(agi::make_unique<ArrayAudioProvider<int32_t>>(int_samples, 3));
+}
+
+TEST(lagi_audio, read_ahead) {
+	TestAudioProvider<int16_t> provider(10);
+	agi::AudioReadAhead reader(provider, false, 100);
+	EXPECT_EQ(2u, reader.GetFrameSize());
+	reader.SetEnd(provider.GetNumSamples());
+	reader.Seek(1000);
+
+	// Several times the size of the ring, so that it wraps around
+	std::vector<int16_t> buff(20000);
+	int64_t read = 0;
+	while (read < 20000) {
+		reader.Wait(1000, std::chrono::milliseconds(100));
+		read += reader.Read(&buff[read], 20000 - read);
+	}
+	EXPECT_EQ(21000, reader.GetPosition());
+	for (size_t i = 0; i < buff.size(); ++i)
+		ASSERT_EQ(static_cast<int16_t>(1000 + i), buff[i]);
+}
+
+TEST(lagi_audio, read_ahead_seek_and_end) {
+	TestAudioProvider<int16_t> provider(10);
+	agi::AudioReadAhead reader(provider, false, 100);
+	reader.SetEnd(provider.GetNumSamples());
+	reader.Seek(0);
+	while (reader.Wait(4800, std::chrono::milliseconds(100)) < 4800) { }
+
+	// Nothing from before the seek is returned, even though the ring was full
+	reader.SetEnd(30100);
+	reader.Seek(30000);
+	const void *data;
+	ASSERT_EQ(100, reader.Wait(4800, std::chrono::seconds(10)));
+	ASSERT_EQ(100, reader.Peek(&data));
+	auto samples = static_cast<const int16_t *>(data);
+	for (int i = 0; i < 100; ++i)
+		ASSERT_EQ(30000 + i, samples[i]);
+
+	// Consuming can't go past what's been decoded
+	reader.Consume(200);
+	EXPECT_EQ(30100, reader.GetPosition());
+	EXPECT_EQ(0, reader.Peek(&data));
+}
+
+TEST(lagi_audio, read_ahead_wakes_decoder) {
+	TestAudioProvider<int16_t> provider(10);
+	agi::AudioReadAhead reader(provider, false, 100);
+	reader.SetEnd(100);
+	reader.Seek(0);
+	ASSERT_EQ(100, reader.Wait(100, std::chrono::seconds(10)));
+
+	// The decoder is asleep at the end position, so moving it has to wake it
+	reader.SetEnd(provider.GetNumSamples());
+
+	// Only reading and never waiting, so space freed by reading has to wake
+	// the decoder once the ring is full
+	std::vector<int16_t> buff(20000);
+	int64_t read = 0;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (read < 20000 && std::chrono::steady_clock::now() < deadline) {
+		auto n = reader.Read(&buff[read], 20000 - read);
+		if (n == 0) std::this_thread::yield();
+		read += n;
+	}
+	ASSERT_EQ(20000, read);
+	for (size_t i = 0; i < buff.size(); ++i)
+		ASSERT_EQ(static_cast<int16_t>(i), buff[i]);
+}
+
+TEST(lagi_audio, read_ahead_skip) {
+	TestAudioProvider<int16_t> provider(10);
+	agi::AudioReadAhead reader(provider, false, 100);
+	reader.SetEnd(provider.GetNumSamples());
+	reader.Seek(0);
+	ASSERT_LE(100, reader.Wait(100, std::chrono::seconds(10)));
+
+	// Skipping within the decoded audio just drops it
+	reader.Skip(50);
+	EXPECT_EQ(50, reader.GetPosition());
+	int16_t buff[100];
+	ASSERT_EQ(10, reader.Read(buff, 10));
+	for (int i = 0; i < 10; ++i)
+		ASSERT_EQ(50 + i, buff[i]);
+
+	// Skipping past it makes the decoder continue from the new position
+	reader.Skip(100000);
+	EXPECT_EQ(100060, reader.GetPosition());
+	ASSERT_LE(100, reader.Wait(100, std::chrono::seconds(10)));
+	ASSERT_EQ(100, reader.Read(buff, 100));
+	for (int i = 0; i < 100; ++i)
+		ASSERT_EQ(static_cast<int16_t>(100060 + i), buff[i]);
+}
+
+TEST(lagi_audio, read_ahead_mono16_volume) {
+	TestAudioProvider<int16_t> provider(1);
+	agi::AudioReadAhead reader(provider, true, 100);
+	reader.SetVolume(2.0);
+	reader.SetEnd(200);
+	reader.Seek(100);
+	ASSERT_EQ(100, reader.Wait(100, std::chrono::seconds(10)));
+
+	int16_t buff[100];
+	ASSERT_EQ(100, reader.Read(buff, 100));
+	for (int i = 0; i < 100; ++i)
+		ASSERT_EQ(2 * (100 + i), buff[i]);
+}
+
 TEST(lagi_audio, pcm_simple) {
 	auto path = agi::Path().Decode("?temp/pcm_simple");
 	{
@@ -373,6 +915,7 @@ TEST(lagi_audio, pcm_simple) {
 		EXPECT_EQ(2, provider->GetBytesPerSample());
 		EXPECT_EQ(false, provider->AreSamplesFloat());
 		EXPECT_EQ(false, provider->NeedsCache());
+		EXPECT_EQ(sizeof(size_t) >= 8, provider->SupportsConcurrentReads());
 
 		for (int i = 0; i < 100; ++i) {
 			uint16_t sample;
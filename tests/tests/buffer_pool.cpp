@@ -0,0 +1,187 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/buffer_pool.h>
+
+#include <main.h>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using agi::buffer_pool;
+using agi::pooled_buffer;
+
+TEST(lagi_buffer_pool, size_class) {
+	EXPECT_EQ(64u, buffer_pool::size_class(0));
+	EXPECT_EQ(64u, buffer_pool::size_class(1));
+	EXPECT_EQ(64u, buffer_pool::size_class(64));
+	EXPECT_EQ(128u, buffer_pool::size_class(65));
+	EXPECT_EQ(4096u, buffer_pool::size_class(4096));
+
+	// Large requests waste at most an eighth of the block
+	for (size_t size : {4097u, 10000u, 1920u * 1080u * 4u, 3840u * 2160u * 4u}) {
+		size_t block = buffer_pool::size_class(size);
+		EXPECT_GE(block, size);
+		EXPECT_LE(block - size, block / 8);
+		EXPECT_EQ(0u, block % buffer_pool::alignment);
+	}
+
+	// Similar sizes share a class
+	EXPECT_EQ(buffer_pool::size_class(1920 * 1080 * 4), buffer_pool::size_class(1920 * 1088 * 4));
+}
+
+TEST(lagi_buffer_pool, alignment) {
+	buffer_pool pool(0);
+	for (size_t size : {1u, 100u, 5000u, 1000000u}) {
+		pooled_buffer buf(pool);
+		buf.resize(size);
+		EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(buf.data()) % buffer_pool::alignment);
+	}
+}
+
+TEST(lagi_buffer_pool, reuse) {
+	buffer_pool pool(1 << 20);
+	const uint8_t *first;
+	{
+		pooled_buffer buf(pool);
+		buf.resize(100000);
+		first = buf.data();
+		EXPECT_EQ(0u, pool.retained());
+	}
+	EXPECT_EQ(buffer_pool::size_class(100000), pool.retained());
+
+	pooled_buffer buf(pool);
+	buf.resize(99000);
+	EXPECT_EQ(first, buf.data());
+	EXPECT_EQ(0u, pool.retained());
+
+	// Shrinking and growing within the block doesn't reallocate
+	buf.resize(10);
+	buf.resize(100000);
+	EXPECT_EQ(first, buf.data());
+}
+
+TEST(lagi_buffer_pool, retention_limit) {
+	buffer_pool pool(150000);
+	{
+		pooled_buffer a(pool), b(pool);
+		a.resize(100000);
+		b.resize(100000);
+	}
+	// Only one of the two blocks fits
+	EXPECT_EQ(buffer_pool::size_class(100000), pool.retained());
+
+	{
+		pooled_buffer c(pool);
+		c.resize(60000);
+		pooled_buffer d(pool);
+		d.resize(100000);
+		c.clear();
+	}
+	// The released block of the other size is discarded in favor of the
+	// most recently used size
+	EXPECT_EQ(buffer_pool::size_class(100000), pool.retained());
+
+	pool.trim();
+	EXPECT_EQ(0u, pool.retained());
+
+	buffer_pool none(0);
+	{
+		pooled_buffer e(none);
+		e.resize(100);
+	}
+	EXPECT_EQ(0u, none.retained());
+}
+
+TEST(lagi_buffer_pool, contents) {
+	buffer_pool pool(1 << 20);
+	pooled_buffer buf(pool);
+	EXPECT_TRUE(buf.empty());
+
+	const uint8_t text[] = "hello world";
+	buf.assign(text, text + sizeof text);
+	ASSERT_EQ(sizeof text, buf.size());
+	EXPECT_STREQ("hello world", reinterpret_cast<const char *>(buf.data()));
+
+	// Growing into a new block keeps the existing contents
+	buf.resize(100000);
+	EXPECT_STREQ("hello world", reinterpret_cast<const char *>(buf.data()));
+	EXPECT_EQ('w', buf[6]);
+
+	pooled_buffer copy(buf);
+	EXPECT_NE(buf.data(), copy.data());
+	EXPECT_EQ(buf.size(), copy.size());
+	EXPECT_EQ(0, memcmp(buf.data(), copy.data(), buf.size()));
+
+	buf[0] = 'j';
+	copy = buf;
+	EXPECT_EQ('j', copy[0]);
+
+	pooled_buffer moved(std::move(copy));
+	EXPECT_EQ('j', moved[0]);
+	EXPECT_EQ(100000u, moved.size());
+	EXPECT_TRUE(copy.empty());
+	EXPECT_EQ(nullptr, copy.data());
+
+	// Moved-from buffers are still usable
+	copy.resize(10);
+	EXPECT_EQ(10u, copy.size());
+}
+
+TEST(lagi_buffer_pool, outlives_pool) {
+	std::unique_ptr<pooled_buffer> buf;
+	{
+		buffer_pool pool(1 << 20);
+		buf.reset(new pooled_buffer(pool));
+		buf->resize(1000);
+	}
+	(*buf)[999] = 1;
+	buf->resize(100000);
+	buf.reset();
+}
+
+TEST(lagi_buffer_pool, move_between_pools) {
+	buffer_pool a(1 << 20), b(1 << 20);
+	{
+		pooled_buffer from_a(a);
+		from_a.resize(1000);
+		pooled_buffer from_b(b);
+		from_b = std::move(from_a);
+	}
+	// The block goes back to the pool it came from
+	EXPECT_EQ(buffer_pool::size_class(1000), a.retained());
+	EXPECT_EQ(0u, b.retained());
+}
+
+TEST(lagi_buffer_pool, threads) {
+	buffer_pool pool(1 << 20);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 4; ++i) {
+		threads.emplace_back([&, i] {
+			for (int j = 0; j < 1000; ++j) {
+				pooled_buffer buf(pool);
+				buf.resize(1000 + (j % 3) * 5000);
+				memset(buf.data(), i, buf.size());
+				for (size_t k = 0; k < buf.size(); k += 97)
+					ASSERT_EQ(i, buf[k]);
+			}
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+	EXPECT_LE(pool.retained(), 1u << 20);
+}
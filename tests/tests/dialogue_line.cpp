@@ -0,0 +1,109 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/ass/dialogue_line.h>
+
+#include <main.h>
+
+using agi::ass::DialogueFields;
+using agi::ass::ParseDialogueFields;
+
+namespace {
+DialogueFields parse(std::string const& line) {
+	DialogueFields fields;
+	EXPECT_TRUE(ParseDialogueFields(line, fields)) << line;
+	return fields;
+}
+
+bool rejects(std::string const& line) {
+	DialogueFields fields;
+	return !ParseDialogueFields(line, fields);
+}
+}
+
+TEST(lagi_dialogue_line, dialogue) {
+	std::string line = "Dialogue: 2,0:00:01.00, 0:00:02.50 ,Default , Actor,0010,-5,20, Effect ,Text, with commas ";
+	auto fields = parse(line);
+	EXPECT_FALSE(fields.comment);
+	EXPECT_EQ(2, fields.layer);
+	EXPECT_EQ("0:00:01.00", agi::str(fields.start));
+	EXPECT_EQ("0:00:02.50", agi::str(fields.end));
+	EXPECT_EQ("Default", agi::str(fields.style));
+	EXPECT_EQ("Actor", agi::str(fields.actor));
+	EXPECT_EQ(10, fields.margin[0]);
+	EXPECT_EQ(-5, fields.margin[1]);
+	EXPECT_EQ(20, fields.margin[2]);
+	EXPECT_EQ("Effect", agi::str(fields.effect));
+	EXPECT_EQ("Text, with commas ", agi::str(fields.text));
+	EXPECT_FALSE(fields.has_extradata);
+}
+
+TEST(lagi_dialogue_line, comment) {
+	std::string line = "Comment: 0,0:00:00.00,0:00:05.00,Default,,0,0,0,,";
+	auto fields = parse(line);
+	EXPECT_TRUE(fields.comment);
+	EXPECT_EQ("", agi::str(fields.actor));
+	EXPECT_EQ("", agi::str(fields.text));
+}
+
+TEST(lagi_dialogue_line, ssa_marked) {
+	std::string line = "Dialogue: Marked=1,0:00:00.00,0:00:05.00,Default,,0,0,0,,text";
+	EXPECT_EQ(0, parse(line).layer);
+}
+
+TEST(lagi_dialogue_line, margins_clamped) {
+	std::string line = "Dialogue: 0,0:00:00.00,0:00:05.00,Default,,-100000,100000,+7,,text";
+	auto fields = parse(line);
+	EXPECT_EQ(-9999, fields.margin[0]);
+	EXPECT_EQ(99999, fields.margin[1]);
+	EXPECT_EQ(7, fields.margin[2]);
+}
+
+TEST(lagi_dialogue_line, extradata) {
+	std::string line = "Dialogue: 0,0:00:00.00,0:00:05.00,Default,,0,0,0,,{=1=23}{\\b1}text";
+	auto fields = parse(line);
+	EXPECT_TRUE(fields.has_extradata);
+	EXPECT_EQ((std::vector<uint32_t>{1, 23}), fields.extradata_ids);
+	EXPECT_EQ("{\\b1}text", agi::str(fields.text));
+
+	for (std::string text : {"{=}text", "{=1=}text", "{=1", "{=a}", "{\\b1}"}) {
+		line = "Dialogue: 0,0:00:00.00,0:00:05.00,Default,,0,0,0,," + text;
+		fields = parse(line);
+		EXPECT_FALSE(fields.has_extradata) << text;
+		EXPECT_EQ(text, agi::str(fields.text));
+	}
+}
+
+TEST(lagi_dialogue_line, malformed) {
+	EXPECT_TRUE(rejects(""));
+	EXPECT_TRUE(rejects("Dialogue:"));
+	EXPECT_TRUE(rejects("Comment:"));
+	EXPECT_TRUE(rejects("Style: 0,0:00:00.00,0:00:05.00,Default,,0,0,0,,text"));
+	EXPECT_TRUE(rejects("Dialogue: 0,0:00:00.00,0:00:05.00,Default,,0,0,0,"));
+	EXPECT_TRUE(rejects("Dialogue: x,0:00:00.00,0:00:05.00,Default,,0,0,0,,text"));
+	EXPECT_TRUE(rejects("Dialogue: 0,0:00:00.00,0:00:05.00,Default,,0, 0,0,,text"));
+	EXPECT_TRUE(rejects("Dialogue: 0,0:00:00.00,0:00:05.00,Default,,0,,0,,text"));
+	EXPECT_TRUE(rejects("Dialogue: 99999999999,0:00:00.00,0:00:05.00,Default,,0,0,0,,text"));
+	EXPECT_TRUE(rejects("Dialogue: 0,0:00:00.00,0:00:05.00,Default,,0,0,0,,{=99999999999}text"));
+}
+
+TEST(lagi_dialogue_line, int_limits) {
+	auto fields = parse("Dialogue: -2147483648,0:00:00.00,0:00:05.00,Default,,0,0,0,,text");
+	EXPECT_EQ(-2147483647 - 1, fields.layer);
+	fields = parse("Dialogue: 2147483647,0:00:00.00,0:00:05.00,Default,,0,0,0,,text");
+	EXPECT_EQ(2147483647, fields.layer);
+	EXPECT_TRUE(rejects("Dialogue: 2147483648,0:00:00.00,0:00:05.00,Default,,0,0,0,,text"));
+}
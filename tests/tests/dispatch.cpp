@@ -0,0 +1,56 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/dispatch.h>
+
+#include <main.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+TEST(lagi_dispatch, parallel_for_runs_each_index_once) {
+	std::vector<std::atomic<int>> calls(1000);
+	for (auto& count : calls) count = 0;
+	agi::dispatch::ParallelFor(calls.size(), [&](size_t i) { ++calls[i]; });
+	for (auto const& count : calls)
+		ASSERT_EQ(1, count);
+}
+
+TEST(lagi_dispatch, parallel_for_empty) {
+	bool called = false;
+	agi::dispatch::ParallelFor(0, [&](size_t) { called = true; });
+	EXPECT_FALSE(called);
+}
+
+TEST(lagi_dispatch, parallel_for_rethrows_lowest_error) {
+	std::atomic<size_t> calls{0};
+	try {
+		agi::dispatch::ParallelFor(1000, [&](size_t i) {
+			++calls;
+			if (i == 500 || i == 700)
+				throw std::runtime_error(std::to_string(i));
+		});
+		FAIL() << "Exception was not rethrown";
+	}
+	catch (std::runtime_error const& e) {
+		EXPECT_STREQ("500", e.what());
+	}
+	// Everything up to the failure still runs, as an earlier index could
+	// also have failed. How many of the later ones are skipped depends on
+	// how far the other threads had got when it failed.
+	EXPECT_GE(calls, 501u);
+}
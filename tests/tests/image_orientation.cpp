@@ -0,0 +1,157 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#include <libaegisub/image_orientation.h>
+
+#include <main.h>
+
+#include <cstring>
+#include <vector>
+
+using agi::image_orientation;
+
+namespace {
+/// An image where each pixel's value identifies its position
+struct test_image {
+	size_t width, height, pitch;
+	std::vector<uint8_t> data;
+
+	test_image(size_t width, size_t height, size_t padding = 0)
+	: width(width), height(height), pitch(width * 4 + padding), data(pitch * height, 0xEE)
+	{
+		for (size_t y = 0; y < height; ++y) {
+			for (size_t x = 0; x < width; ++x) {
+				uint32_t px = static_cast<uint32_t>(y << 16 | x);
+				memcpy(&data[y * pitch + x * 4], &px, 4);
+			}
+		}
+	}
+};
+
+uint32_t pixel(std::vector<uint8_t> const& data, size_t pitch, size_t x, size_t y) {
+	uint32_t px;
+	memcpy(&px, &data[y * pitch + x * 4], 4);
+	return px;
+}
+
+uint32_t source(size_t x, size_t y) {
+	return static_cast<uint32_t>(y << 16 | x);
+}
+
+/// Orient the image and check every output pixel against the definition
+void check(size_t width, size_t height, image_orientation o, size_t padding = 0) {
+	test_image src(width, height, padding);
+	size_t dst_width = o.transpose ? height : width;
+	size_t dst_height = o.transpose ? width : height;
+	size_t dst_pitch = dst_width * 4 + 12;
+	std::vector<uint8_t> dst(dst_pitch * dst_height, 0xEE);
+
+	agi::copy_oriented(src.data.data(), src.pitch, width, height, dst.data(), dst_pitch, o);
+
+	for (size_t y = 0; y < dst_height; ++y) {
+		for (size_t x = 0; x < dst_width; ++x) {
+			size_t mx = o.mirror_x ? dst_width - x - 1 : x;
+			size_t my = o.mirror_y ? dst_height - y - 1 : y;
+			uint32_t expected = o.transpose ? source(my, mx) : source(mx, my);
+			ASSERT_EQ(expected, pixel(dst, dst_pitch, x, y)) << x << "," << y;
+		}
+		// Padding past the end of the row is left alone
+		for (size_t i = dst_width * 4; i < dst_pitch; ++i)
+			ASSERT_EQ(0xEE, dst[y * dst_pitch + i]);
+	}
+}
+
+std::vector<image_orientation> all_orientations() {
+	std::vector<image_orientation> ret;
+	for (int i = 0; i < 8; ++i) {
+		image_orientation o;
+		o.transpose = !!(i & 1);
+		o.mirror_x = !!(i & 2);
+		o.mirror_y = !!(i & 4);
+		ret.push_back(o);
+	}
+	return ret;
+}
+}
+
+TEST(lagi_image_orientation, all_orientations) {
+	for (auto o : all_orientations()) {
+		check(64, 48, o);
+		check(48, 64, o, 8);
+	}
+}
+
+TEST(lagi_image_orientation, odd_sizes) {
+	// Sizes which don't fit evenly into tiles or vector blocks
+	for (auto o : all_orientations()) {
+		check(1, 1, o);
+		check(3, 7, o);
+		check(37, 70, o, 4);
+		check(101, 33, o);
+	}
+}
+
+TEST(lagi_image_orientation, identity_copy) {
+	test_image src(10, 5);
+	std::vector<uint8_t> dst(src.data.size());
+	agi::copy_oriented(src.data.data(), src.pitch, 10, 5, dst.data(), src.pitch, image_orientation());
+	EXPECT_EQ(src.data, dst);
+}
+
+TEST(lagi_image_orientation, rotation) {
+	// A 2x1 image [a b] rotated counterclockwise by 90 degrees is [b; a]
+	test_image src(2, 1);
+	uint8_t dst[8];
+
+	agi::copy_oriented(src.data.data(), src.pitch, 2, 1, dst, 4, image_orientation::rotation(90));
+	EXPECT_EQ(source(1, 0), pixel({dst, dst + 8}, 4, 0, 0));
+	EXPECT_EQ(source(0, 0), pixel({dst, dst + 8}, 4, 0, 1));
+
+	agi::copy_oriented(src.data.data(), src.pitch, 2, 1, dst, 4, image_orientation::rotation(-90));
+	EXPECT_EQ(source(0, 0), pixel({dst, dst + 8}, 4, 0, 0));
+	EXPECT_EQ(source(1, 0), pixel({dst, dst + 8}, 4, 0, 1));
+
+	agi::copy_oriented(src.data.data(), src.pitch, 2, 1, dst, 8, image_orientation::rotation(180));
+	EXPECT_EQ(source(1, 0), pixel({dst, dst + 8}, 8, 0, 0));
+	EXPECT_EQ(source(0, 0), pixel({dst, dst + 8}, 8, 1, 0));
+
+	EXPECT_TRUE(image_orientation::rotation(0).is_identity());
+	EXPECT_TRUE(image_orientation::rotation(360).is_identity());
+	EXPECT_TRUE(image_orientation::rotation(-360).is_identity());
+}
+
+TEST(lagi_image_orientation, after_flip) {
+	// Flipping and then rotating has to match doing the two steps separately
+	test_image src(5, 3);
+	for (int degrees : {0, 90, 180, 270}) {
+		for (int flip = 0; flip < 4; ++flip) {
+			bool h = !!(flip & 1), v = !!(flip & 2);
+			image_orientation flip_only;
+			flip_only.mirror_x = h;
+			flip_only.mirror_y = v;
+			std::vector<uint8_t> flipped(src.data.size());
+			agi::copy_oriented(src.data.data(), src.pitch, 5, 3, flipped.data(), src.pitch, flip_only);
+
+			auto rotate = image_orientation::rotation(degrees);
+			size_t dst_pitch = (rotate.transpose ? 3 : 5) * 4;
+			std::vector<uint8_t> two_steps(15 * 4), one_step(15 * 4);
+			agi::copy_oriented(flipped.data(), src.pitch, 5, 3, two_steps.data(), dst_pitch, rotate);
+			agi::copy_oriented(src.data.data(), src.pitch, 5, 3, one_step.data(), dst_pitch, rotate.after_flip(h, v));
+			EXPECT_EQ(two_steps, one_step) << degrees << " " << flip;
+		}
+	}
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/interval_index.h>
+
+#include <main.h>
+
+#include <random>
+
+using agi::IntervalIndex;
+
+namespace {
+std::vector<int> overlapping(IntervalIndex<int> const& index, int start, int end) {
+	std::vector<int> ret;
+	index.Overlapping(start, end, [&](int value) { ret.push_back(value); });
+	return ret;
+}
+}
+
+TEST(lagi_interval_index, empty) {
+	IntervalIndex<int> index;
+	index.Build();
+	EXPECT_TRUE(overlapping(index, 0, 100).empty());
+}
+
+TEST(lagi_interval_index, half_open) {
+	IntervalIndex<int> index;
+	index.Add(10, 20, 1);
+	index.Build();
+
+	EXPECT_TRUE(overlapping(index, 0, 10).empty());
+	EXPECT_TRUE(overlapping(index, 20, 30).empty());
+	EXPECT_EQ(std::vector<int>{1}, overlapping(index, 9, 11));
+	EXPECT_EQ(std::vector<int>{1}, overlapping(index, 19, 20));
+	EXPECT_EQ(std::vector<int>{1}, overlapping(index, 0, 100));
+	EXPECT_TRUE(overlapping(index, 15, 15).empty());
+}
+
+TEST(lagi_interval_index, sorted_by_start) {
+	IntervalIndex<int> index;
+	index.Add(30, 40, 3);
+	index.Add(0, 100, 0);
+	index.Add(20, 35, 2);
+	index.Add(10, 15, 1);
+	index.Build();
+
+	EXPECT_EQ((std::vector<int>{0, 2, 3}), overlapping(index, 32, 33));
+	EXPECT_EQ((std::vector<int>{0, 1, 2, 3}), overlapping(index, 0, 100));
+	EXPECT_EQ((std::vector<int>{0}), overlapping(index, 50, 60));
+}
+
+TEST(lagi_interval_index, matches_linear_scan) {
+	std::mt19937 rng(1234);
+	for (int n : {1, 2, 3, 7, 8, 9, 63, 64, 65, 1000}) {
+		std::vector<std::pair<int, int>> intervals;
+		IntervalIndex<int> index;
+		for (int i = 0; i < n; ++i) {
+			int start = rng() % 10000;
+			int end = start + rng() % (i % 10 == 0 ? 5000 : 100);
+			intervals.emplace_back(start, end);
+			index.Add(start, end, i);
+		}
+		index.Build();
+		ASSERT_EQ(size_t(n), index.size());
+
+		for (int q = 0; q < 200; ++q) {
+			int qstart = rng() % 11000 - 500;
+			int qend = qstart + rng() % 300 + 1;
+
+			std::vector<int> expected;
+			for (int i = 0; i < n; ++i) {
+				if (intervals[i].first < qend && qstart < intervals[i].second)
+					expected.push_back(i);
+			}
+
+			auto actual = overlapping(index, qstart, qend);
+			std::sort(begin(actual), end(actual));
+			ASSERT_EQ(expected, actual) << "n=" << n << " query=[" << qstart << ", " << qend << ")";
+		}
+	}
+}
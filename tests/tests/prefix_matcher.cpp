@@ -0,0 +1,81 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/prefix_matcher.h>
+
+#include <main.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <random>
+
+using agi::PrefixMatcher;
+
+namespace {
+int linear_find(std::vector<std::string> const& strings, std::string const& text) {
+	for (size_t i = 0; i < strings.size(); ++i) {
+		if (boost::starts_with(text, strings[i]))
+			return static_cast<int>(i);
+	}
+	return -1;
+}
+}
+
+TEST(lagi_prefix_matcher, empty) {
+	PrefixMatcher matcher;
+	EXPECT_EQ(-1, matcher.Find(""));
+	EXPECT_EQ(-1, matcher.Find("abc"));
+}
+
+TEST(lagi_prefix_matcher, longest_first) {
+	PrefixMatcher matcher({"\\fscx", "\\fsp", "\\fs", "\\b"});
+	EXPECT_EQ(0, matcher.Find("\\fscx120"));
+	EXPECT_EQ(1, matcher.Find("\\fsp2"));
+	EXPECT_EQ(2, matcher.Find("\\fs20"));
+	EXPECT_EQ(2, matcher.Find("\\fsc"));
+	EXPECT_EQ(3, matcher.Find("\\b1"));
+	EXPECT_EQ(-1, matcher.Find("\\f"));
+	EXPECT_EQ(-1, matcher.Find("fs"));
+	EXPECT_EQ(-1, matcher.Find(""));
+}
+
+TEST(lagi_prefix_matcher, earliest_wins) {
+	PrefixMatcher matcher({"\\k", "\\kf", "\\clip", "\\clip"});
+	EXPECT_EQ(0, matcher.Find("\\kf10"));
+	EXPECT_EQ(2, matcher.Find("\\clip(1,2,3,4)"));
+}
+
+TEST(lagi_prefix_matcher, matches_linear_scan) {
+	std::mt19937 rng(5678);
+	const char alphabet[] = "\\abcf1";
+	auto random_string = [&](size_t max_len) {
+		std::string str;
+		for (size_t len = rng() % (max_len + 1); str.size() < len; )
+			str += alphabet[rng() % (sizeof(alphabet) - 1)];
+		return str;
+	};
+
+	for (int set = 0; set < 50; ++set) {
+		std::vector<std::string> strings;
+		for (int i = 0, count = rng() % 20; i < count; ++i)
+			strings.push_back(random_string(4));
+		PrefixMatcher matcher(strings);
+
+		for (int i = 0; i < 500; ++i) {
+			auto text = random_string(8);
+			ASSERT_EQ(linear_find(strings, text), matcher.Find(text)) << text;
+		}
+	}
+}
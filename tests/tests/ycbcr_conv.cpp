@@ -0,0 +1,150 @@
+// Copyright (c) 2026, Aegisub contributors
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+
+#include <libaegisub/ycbcr_conv.h>
+
+#include <main.h>
+
+#include <random>
+#include <vector>
+
+using namespace agi;
+
+namespace {
+struct test_image {
+	ycbcr_image image;
+	std::vector<uint8_t> planes[3];
+
+	test_image(int width, int height, ycbcr_subsampling subsampling) {
+		int chroma_width = width, chroma_height = height;
+		if (subsampling == ycbcr_subsampling::yuv420 || subsampling == ycbcr_subsampling::yuv422)
+			chroma_width = (width + 1) / 2;
+		if (subsampling == ycbcr_subsampling::yuv411)
+			chroma_width = (width + 3) / 4;
+		if (subsampling == ycbcr_subsampling::yuv420)
+			chroma_height = (height + 1) / 2;
+
+		std::mt19937 rng(width * height);
+		std::uniform_int_distribution<int> dist(0, 255);
+		planes[0].resize(width * height);
+		if (subsampling != ycbcr_subsampling::mono) {
+			planes[1].resize(chroma_width * chroma_height);
+			planes[2].resize(chroma_width * chroma_height);
+		}
+		for (auto& plane : planes) {
+			for (auto& px : plane)
+				px = static_cast<uint8_t>(dist(rng));
+		}
+
+		image.width = width;
+		image.height = height;
+		image.subsampling = subsampling;
+		image.planes = {{planes[0].data(), planes[1].data(), planes[2].data()}};
+		image.strides = {{static_cast<size_t>(width), static_cast<size_t>(chroma_width), static_cast<size_t>(chroma_width)}};
+	}
+};
+
+void check_against_reference(ycbcr_matrix mat, ycbcr_range range, ycbcr_subsampling subsampling, int width, int height) {
+	test_image src(width, height, subsampling);
+	std::vector<uint8_t> dst(width * height * 4, 0xAA);
+	ycbcr_to_bgra(mat, range).Convert(src.image, dst.data(), width * 4);
+
+	ycbcr_converter reference(mat, range);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			int chroma_x = x, chroma_y = y;
+			if (subsampling == ycbcr_subsampling::yuv420) { chroma_x /= 2; chroma_y /= 2; }
+			if (subsampling == ycbcr_subsampling::yuv422) chroma_x /= 2;
+			if (subsampling == ycbcr_subsampling::yuv411) chroma_x /= 4;
+
+			std::array<uint8_t, 3> input{{src.planes[0][y * width + x], 128, 128}};
+			if (subsampling != ycbcr_subsampling::mono) {
+				input[1] = src.planes[1][chroma_y * src.image.strides[1] + chroma_x];
+				input[2] = src.planes[2][chroma_y * src.image.strides[2] + chroma_x];
+			}
+
+			auto expected = reference.ycbcr_to_rgb(input);
+			const uint8_t *px = &dst[(y * width + x) * 4];
+			ASSERT_NEAR(expected[2], px[0], 1) << x << "," << y;
+			ASSERT_NEAR(expected[1], px[1], 1) << x << "," << y;
+			ASSERT_NEAR(expected[0], px[2], 1) << x << "," << y;
+			ASSERT_EQ(0, px[3]);
+		}
+	}
+}
+}
+
+TEST(lagi_ycbcr_to_bgra, matrices) {
+	for (auto mat : {ycbcr_matrix::bt601, ycbcr_matrix::bt709, ycbcr_matrix::fcc, ycbcr_matrix::smpte_240m}) {
+		for (auto range : {ycbcr_range::tv, ycbcr_range::pc})
+			check_against_reference(mat, range, ycbcr_subsampling::yuv444, 64, 64);
+	}
+}
+
+TEST(lagi_ycbcr_to_bgra, subsampling) {
+	for (auto subsampling : {ycbcr_subsampling::yuv420, ycbcr_subsampling::yuv422, ycbcr_subsampling::yuv411, ycbcr_subsampling::yuv444, ycbcr_subsampling::mono})
+		check_against_reference(ycbcr_matrix::bt601, ycbcr_range::tv, subsampling, 40, 20);
+}
+
+TEST(lagi_ycbcr_to_bgra, odd_sizes) {
+	// Widths which aren't a multiple of the vector width, and heights which
+	// don't split evenly into chunks of rows
+	check_against_reference(ycbcr_matrix::bt709, ycbcr_range::tv, ycbcr_subsampling::yuv420, 13, 7);
+	check_against_reference(ycbcr_matrix::bt709, ycbcr_range::tv, ycbcr_subsampling::yuv420, 67, 101);
+	check_against_reference(ycbcr_matrix::bt709, ycbcr_range::pc, ycbcr_subsampling::yuv411, 9, 3);
+	check_against_reference(ycbcr_matrix::bt709, ycbcr_range::pc, ycbcr_subsampling::yuv422, 1, 1);
+}
+
+TEST(lagi_ycbcr_to_bgra, saturates) {
+	// Extreme inputs which are out of gamut have to clamp rather than wrap
+	for (int y : {0, 255}) {
+		for (int u : {0, 255}) {
+			for (int v : {0, 255}) {
+				uint8_t planes[3] = {static_cast<uint8_t>(y), static_cast<uint8_t>(u), static_cast<uint8_t>(v)};
+				ycbcr_image image{1, 1, ycbcr_subsampling::yuv444, {{&planes[0], &planes[1], &planes[2]}}, {{1, 1, 1}}};
+				uint8_t dst[4];
+				ycbcr_to_bgra(ycbcr_matrix::bt601, ycbcr_range::tv).Convert(image, dst, 4);
+
+				auto expected = ycbcr_converter(ycbcr_matrix::bt601, ycbcr_range::tv).ycbcr_to_rgb({{planes[0], planes[1], planes[2]}});
+				EXPECT_NEAR(expected[2], dst[0], 1);
+				EXPECT_NEAR(expected[1], dst[1], 1);
+				EXPECT_NEAR(expected[0], dst[2], 1);
+			}
+		}
+	}
+}
+
+TEST(lagi_ycbcr_to_bgra, rows) {
+	test_image src(48, 64, ycbcr_subsampling::yuv420);
+	ycbcr_to_bgra conv(ycbcr_matrix::bt601, ycbcr_range::tv);
+
+	std::vector<uint8_t> whole(48 * 64 * 4);
+	conv.Convert(src.image, whole.data(), 48 * 4);
+
+	// Converting a range of rows writes exactly those rows
+	std::vector<uint8_t> part(48 * 64 * 4, 0xAA);
+	conv.ConvertRows(src.image, part.data(), 48 * 4, 10, 21);
+	for (int row = 0; row < 64; ++row) {
+		for (int i = 0; i < 48 * 4; ++i) {
+			size_t pos = row * 48 * 4 + i;
+			if (row >= 10 && row < 21)
+				ASSERT_EQ(whole[pos], part[pos]);
+			else
+				ASSERT_EQ(0xAA, part[pos]);
+		}
+	}
+}